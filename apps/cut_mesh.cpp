@@ -5,6 +5,7 @@
 #include "entity.h"
 #include "uniform_mesh.h"
 #include "cut_mesh_algorithm.h"
+#include "mesh_export.h"
 #include <cmath>
 #include <iostream>
 #include <numeric>
@@ -21,57 +22,12 @@ using Vector = Mesh::Vector;
 
 using CutMeshAlg = CutMeshAlgorithm<UniformMesh<2>>;
 using Interface = typename CutMeshAlg::Interface;
+using Export = MeshExport<Mesh>;
 
-extern "C"
-{
-
-void get_node(std::shared_ptr<Mesh> meshptr, double * point_out)
-{
-  auto & nindex = *(meshptr->get_node_indices());
-  std::function<bool(Node &)> fun = [&nindex, &point_out](Node & n)->bool 
-  { 
-    uint32_t idx = nindex[n.index()];
-    point_out[idx*2] = n.coordinate().x;
-    point_out[idx*2+1] = n.coordinate().y;
-    return true;
-  };
-  meshptr->for_each_entity(fun);
-}
-
-void get_inner_cell(std::shared_ptr<Mesh> meshptr, int * inner_cell)
-{
-  auto & is_in_the_interface = *(meshptr->get_cell_data<uint8_t>("is_in_the_interface"));
-  auto & cindex = *(meshptr->get_cell_indices());
-  std::function<bool(Cell &)> fun = [&cindex, &inner_cell, is_in_the_interface](Cell & c)->bool 
-  { 
-    uint32_t cidx = cindex[c.index()];
-    inner_cell[cidx] = is_in_the_interface[c.index()];
-    return true;
-  };
-  meshptr->for_each_entity(fun);
-}
+#include "cut_mesh_capi.h"
 
-void get_halfedge(std::shared_ptr<Mesh> meshptr, int * halfedge_out)
+extern "C"
 {
-  meshptr->update();
-  auto & hindices = *(meshptr->get_halfedge_indices());
-  auto & nindices = *(meshptr->get_node_indices());
-  auto & eindices = *(meshptr->get_edge_indices());
-  auto & cindices = *(meshptr->get_cell_indices());
-  std::function<bool(HalfEdge & h)> fun = 
-    [&halfedge_out, &hindices, &nindices, &eindices, &cindices](HalfEdge & h)->bool 
-  { 
-    uint32_t idx = hindices[h.index()];
-    halfedge_out[idx*6] = nindices[h.node()->index()];
-    halfedge_out[idx*6+1] = cindices[h.cell()->index()];
-    halfedge_out[idx*6+2] = hindices[h.next()->index()];
-    halfedge_out[idx*6+3] = hindices[h.previous()->index()];
-    halfedge_out[idx*6+4] = hindices[h.opposite()->index()];
-    halfedge_out[idx*6+5] = eindices[h.edge()->index()];
-    return true;
-  };
-  meshptr->for_each_entity(fun);
-}
 
 void generate_interface(double * point, 
                         bool * is_fixed_point, 
@@ -93,66 +49,26 @@ void generate_interface(double * point,
     segments.push_back(segment[i]);
 }
 
-struct MeshParameter
-{
-  double a, b, c, d;
-  int nx, ny;
-};
-
-struct InterfaceParameter
-{
-  double * point; 
-  bool * is_fixed_point;
-  int * segment;
-  int NP;
-  int NS;
-};
-
-struct OutParameter
-{
-  double * point_out1;
-  int * halfedge_out1;
-  int * inner_cell1;
-
-  double * point_out2;
-  int * halfedge_out2;
-
-  int * idx0; /** 密网格单元在 0 号界面生成的网格单元中的编号 */
-  int * idx1; /** 密网格单元在 1 号界面生成的网格单元中的编号 */
-
-  int * N; /** NN1, NHE1, NC1, NN2, NHE2, NC2 */
-};
-
-void get_cut_mesh(double a, double b, double c, double d, int nx, int ny, 
-              double * point,
-              bool * is_fixed_point,
-              int * segment,
-              int NP,
-              int NS,
-              double * point_out,
-              int * halfedge_out, 
-              int * N)
+std::shared_ptr<Mesh> cut_mesh1(MeshParameter mp, InterfaceParameter i0, CutStats * stats)
 {
-  double hx = (c-a)/nx, hy = (d-b)/ny;
+  double hx = (mp.c-mp.a)/mp.nx, hy = (mp.d-mp.b)/mp.ny;
 
-  std::shared_ptr<Mesh> meshptr = std::make_shared<Mesh>(a, b, hx, hy, nx, ny);
+  std::shared_ptr<Mesh> meshptr = std::make_shared<Mesh>(mp.a, mp.b, hx, hy, mp.nx, mp.ny);
   CutMeshAlg cut(meshptr);
 
   Interface iface;
-  generate_interface(point, is_fixed_point, segment, NP, NS, iface);
+  generate_interface(i0.point, i0.is_fixed_point, i0.segment, i0.NP, i0.NS, iface);
 
-  cut.cut_by_loop_interface(iface);
+  record_stats(cut.cut_by_loop_interface(iface), stats);
   meshptr->update();
-  get_node(meshptr, point_out);
-  get_halfedge(meshptr, halfedge_out);
-  N[0] = meshptr->number_of_nodes()*2;
-  N[1] = meshptr->number_of_halfedges()*6;
+  return meshptr;
 }
 
-void get_cut_mesh2(MeshParameter mp, 
-                   InterfaceParameter i0, 
-                   InterfaceParameter i1,
-                   OutParameter out)
+void cut_mesh2(MeshParameter mp, 
+               InterfaceParameter i0, 
+               InterfaceParameter i1,
+               std::shared_ptr<Mesh> * meshptr,
+               CutStats * stats)
 {
   double a = mp.a, b = mp.b, c = mp.c, d = mp.d;
   int nx = mp.nx, ny = mp.ny;
@@ -170,16 +86,6 @@ void get_cut_mesh2(MeshParameter mp,
   int NP1 = i1.NP; 
   int NS1 = i1.NS;
 
-  double * point_out1    = out.point_out1;    /** 坐标 */
-  int    * halfedge_out1 = out.halfedge_out1; /** 半边 */
-  int    * inner_cell1   = out.inner_cell1;   /** 内部单元 */
-
-  double * point_out2    = out.point_out2;    /** 坐标 */
-  int    * halfedge_out2 = out.halfedge_out2; /** 半边 */
-
-  int    * idx0          = out.idx0;          /** 密网格单元在网格 0 中单元的编号 */
-  int    * idx1          = out.idx1;          /** 密网格单元在网格 1 中单元的编号 */
-
   /**
    * meshptr2: cut 两次的网格
    * meshprt0 : 被第 0 个界面 cut 的网格
@@ -232,13 +138,13 @@ void get_cut_mesh2(MeshParameter mp,
   generate_interface(point0, is_fixed_point0, segment0, NP0, NS0, iface0);
   generate_interface(point1, is_fixed_point1, segment1, NP1, NS1, iface1);
 
-  cut0.cut_by_loop_interface(iface0);
+  record_stats(cut0.cut_by_loop_interface(iface0), stats);
   std::shared_ptr<Mesh> meshptr0 = std::make_shared<Mesh>(*meshptr2); 
 
   Interface iface2 = iface1;
-  cut0.cut_by_loop_interface(iface1); 
+  record_stats(cut0.cut_by_loop_interface(iface1), stats); 
 
-  cut1.cut_by_loop_interface(iface2);
+  record_stats(cut1.cut_by_loop_interface(iface2), stats);
 
 
   //auto & mesh0 = *meshptr0;
@@ -263,34 +169,25 @@ void get_cut_mesh2(MeshParameter mp,
   meshptr1->update();
   meshptr2->update();
 
-  /** 单元编号 */
-  auto & cindex0 = *(meshptr0->get_cell_indices());
-  auto & cindex1 = *(meshptr1->get_cell_indices());
-  auto & cindex2 = *(meshptr2->get_cell_indices());
-  std::function<bool(Cell &)> fun = [&](Cell & c)->bool 
-  { 
+  meshptr[0] = meshptr0;
+  meshptr[1] = meshptr1;
+  meshptr[2] = meshptr2;
+}
+
+void get_cell_index2(std::shared_ptr<Mesh> * meshptr, int * idx0, int * idx1)
+{
+  auto & cindex0 = *(meshptr[0]->get_cell_indices());
+  auto & cindex1 = *(meshptr[1]->get_cell_indices());
+  auto & cindex2 = *(meshptr[2]->get_cell_indices());
+  for(auto & c : *meshptr[2]->get_cell())
+  {
     uint32_t cidx = cindex2[c.index()];
     Point p = c.inner_point();
-    idx0[cidx] = cindex0[meshptr0->find_point(p, false)->index()];
-    idx1[cidx] = cindex1[meshptr1->find_point(p, false)->index()];
-    return true;
-  };
-  meshptr2->for_each_entity(fun);
-
-  out.N[0] = meshptr1->number_of_nodes()*2;
-  out.N[1] = meshptr1->number_of_halfedges()*6;
-  out.N[2] = meshptr1->number_of_cells();
-
-  out.N[3] = meshptr2->number_of_nodes()*2;
-  out.N[4] = meshptr2->number_of_halfedges()*6;
-  out.N[5] = meshptr2->number_of_cells();
-
-  get_node(meshptr1, point_out1);
-  get_halfedge(meshptr1, halfedge_out1);
-  get_inner_cell(meshptr1, inner_cell1);
-
-  get_node(meshptr2, point_out2);
-  get_halfedge(meshptr2, halfedge_out2);
+    Cell * c0 = meshptr[0]->find_point(p, false);
+    Cell * c1 = meshptr[1]->find_point(p, false);
+    idx0[cidx] = cindex0[c0->index()];
+    idx1[cidx] = cindex1[c1->index()];
+  }
 }
 
 }
@@ -0,0 +1,264 @@
+#ifndef CUT_MESH_CAPI
+#define CUT_MESH_CAPI
+
+/**
+ * 两个切割程序 cut_mesh.cpp 和 cut_mesh_new.cpp 共用的 C 接口: 参数, 句柄,
+ * 导出函数和切割的统计, test.py 按这里的定义调用。
+ *
+ * 包含之前要定义网格类型 Mesh 和导出类型 Export = MeshExport<Mesh>,
+ * 之后要定义这里声明的 cut_mesh1, cut_mesh2 和 get_cell_index2。
+ * 函数不是 inline 的, 这样才会从动态库导出, 所以每个程序只能有一个源文件包含它。
+ */
+
+#include <memory>
+#include <mutex>
+
+#include "mesh_export.h"
+#include "cut_trace.h"
+
+extern "C"
+{
+
+void get_node(std::shared_ptr<Mesh> meshptr, double * point_out)
+{
+  Export::fill_node(*meshptr, point_out);
+}
+
+void get_inner_cell(std::shared_ptr<Mesh> meshptr, int * inner_cell)
+{
+  auto is_in_the_interface_handle = meshptr->get_cell_data_handle<uint8_t>("is_in_the_interface");
+  auto & is_in_the_interface = meshptr->cell_data(is_in_the_interface_handle);
+  auto & cindex = *(meshptr->get_cell_indices());
+  for(auto & c : *meshptr->get_cell())
+    inner_cell[cindex[c.index()]] = is_in_the_interface[c.index()];
+}
+
+void get_halfedge(std::shared_ptr<Mesh> meshptr, int * halfedge_out)
+{
+  meshptr->update();
+  Export::fill_halfedge(*meshptr, halfedge_out);
+}
+
+struct MeshParameter
+{
+  double a, b, c, d;
+  int nx, ny;
+};
+
+struct InterfaceParameter
+{
+  double * point;
+  bool * is_fixed_point;
+  int * segment;
+  int NP;
+  int NS;
+};
+
+struct OutParameter
+{
+  double * point_out1;
+  int * halfedge_out1;
+  int * inner_cell1;
+
+  double * point_out2;
+  int * halfedge_out2;
+
+  int * idx0; /** 密网格单元在 0 号界面生成的网格单元中的编号 */
+  int * idx1; /** 密网格单元在 1 号界面生成的网格单元中的编号 */
+
+  int * N; /** NN1, NHE1, NC1, NN2, NHE2, NC2 */
+};
+
+/**
+ * @brief C 接口的不透明句柄, 保存切割得到的网格的导出数组
+ */
+struct CutMeshResult
+{
+  /** cut_mesh_create : mesh[0] 是切割后的网格
+   *  cut_mesh2_create : mesh[0] 是 meshptr1, 带有 inner_cell,
+   *                     mesh[1] 是 meshptr2, 带有 idx0, idx1 */
+  Export mesh[2];
+  int number_of_meshes = 0;
+  CutStats stats; /** 得到这些网格的所有切割的统计 */
+};
+
+/** 进程中所有切割的累计统计 */
+struct CumulativeStats
+{
+  std::mutex mutex;
+  CutStats stats;
+};
+
+CumulativeStats & cumulative_stats()
+{
+  static CumulativeStats s;
+  return s;
+}
+
+/** 把一次切割的统计累计到 res 和进程的统计中 */
+void record_stats(const CutStats & s, CutStats * res)
+{
+  if(res)
+    *res += s;
+  auto & cs = cumulative_stats();
+  std::lock_guard<std::mutex> lock(cs.mutex);
+  cs.stats += s;
+}
+
+/** 生成被一个界面切割的网格, 每次切割的统计由 record_stats 记录 */
+std::shared_ptr<Mesh> cut_mesh1(MeshParameter mp, InterfaceParameter i0, CutStats * stats = nullptr);
+
+/**
+ * @brief 用两个界面切割网格
+ * @param meshptr : 返回三个网格, 编号都已更新,
+ *                  0 被第 0 个界面切割, 1 被第 1 个界面切割, 2 被两个界面切割
+ * @param stats : 不为空时累计切割的统计, 见 record_stats
+ */
+void cut_mesh2(MeshParameter mp,
+               InterfaceParameter i0,
+               InterfaceParameter i1,
+               std::shared_ptr<Mesh> * meshptr,
+               CutStats * stats = nullptr);
+
+/**
+ * @brief cut_mesh2 得到的网格 2 的每个单元在网格 0 和网格 1 中所在单元的编号
+ */
+void get_cell_index2(std::shared_ptr<Mesh> * meshptr, int * idx0, int * idx1);
+
+void get_cut_mesh(double a, double b, double c, double d, int nx, int ny,
+              double * point,
+              bool * is_fixed_point,
+              int * segment,
+              int NP,
+              int NS,
+              double * point_out,
+              int * halfedge_out,
+              int * N)
+{
+  std::shared_ptr<Mesh> meshptr = cut_mesh1({a, b, c, d, nx, ny},
+      {point, is_fixed_point, segment, NP, NS});
+  get_node(meshptr, point_out);
+  get_halfedge(meshptr, halfedge_out);
+  N[0] = meshptr->number_of_nodes()*2;
+  N[1] = meshptr->number_of_halfedges()*6;
+}
+
+/**
+ * @brief 用两个界面切割网格, 直接写入调用者的数组, 不经过 MeshExport
+ */
+void get_cut_mesh2(MeshParameter mp,
+                   InterfaceParameter i0,
+                   InterfaceParameter i1,
+                   OutParameter out)
+{
+  std::shared_ptr<Mesh> meshptr[3];
+  cut_mesh2(mp, i0, i1, meshptr);
+  Mesh & mesh1 = *meshptr[1];
+  Mesh & mesh2 = *meshptr[2];
+
+  out.N[0] = mesh1.number_of_nodes()*2;
+  out.N[1] = mesh1.number_of_halfedges()*6;
+  out.N[2] = mesh1.number_of_cells();
+
+  out.N[3] = mesh2.number_of_nodes()*2;
+  out.N[4] = mesh2.number_of_halfedges()*6;
+  out.N[5] = mesh2.number_of_cells();
+
+  Export::fill_node(mesh1, out.point_out1);
+  Export::fill_halfedge(mesh1, out.halfedge_out1);
+  get_inner_cell(meshptr[1], out.inner_cell1);
+  Export::fill_node(mesh2, out.point_out2);
+  Export::fill_halfedge(mesh2, out.halfedge_out2);
+  get_cell_index2(meshptr, out.idx0, out.idx1);
+}
+
+/**
+ * @brief 不复制的 C 接口: 先创建句柄, 再查询大小和数组描述, 最后释放句柄
+ * @note 返回的 ArrayView 指向句柄中的内存, 在 cut_mesh_destroy 之前有效
+ */
+void * cut_mesh_create(MeshParameter mp, InterfaceParameter i0)
+{
+  CutMeshResult * res = new CutMeshResult;
+  res->number_of_meshes = 1;
+  res->mesh[0].build(*cut_mesh1(mp, i0, &res->stats));
+  return res;
+}
+
+void * cut_mesh2_create(MeshParameter mp, InterfaceParameter i0, InterfaceParameter i1)
+{
+  CutMeshResult * res = new CutMeshResult;
+  std::shared_ptr<Mesh> meshptr[3];
+  cut_mesh2(mp, i0, i1, meshptr, &res->stats);
+
+  res->number_of_meshes = 2;
+  res->mesh[0].build(*meshptr[1]);
+  res->mesh[1].build(*meshptr[2]);
+
+  /** 内部单元 */
+  auto & inner_cell = res->mesh[0].add_array("inner_cell", meshptr[1]->number_of_cells());
+  get_inner_cell(meshptr[1], inner_cell.data());
+
+  /** 单元编号 */
+  auto & idx0 = res->mesh[1].add_array("idx0", meshptr[2]->number_of_cells());
+  auto & idx1 = res->mesh[1].add_array("idx1", meshptr[2]->number_of_cells());
+  get_cell_index2(meshptr, idx0.data(), idx1.data());
+  return res;
+}
+
+/**
+ * @brief 第 k 个网格的大小
+ * @param N : NN, NHE, NC, 第 k 个网格不存在时都是 0
+ */
+void cut_mesh_size(void * handle, int k, int * N)
+{
+  CutMeshResult * res = static_cast<CutMeshResult *>(handle);
+  bool valid = k >= 0 && k < res->number_of_meshes;
+  N[0] = valid ? res->mesh[k].number_of_nodes() : 0;
+  N[1] = valid ? res->mesh[k].number_of_halfedges() : 0;
+  N[2] = valid ? res->mesh[k].number_of_cells() : 0;
+}
+
+/** @brief 第 k 个网格中名为 name 的数组, 见 MeshExport::view */
+ArrayView cut_mesh_view(void * handle, int k, const char * name)
+{
+  CutMeshResult * res = static_cast<CutMeshResult *>(handle);
+  if(k < 0 || k >= res->number_of_meshes)
+    return {nullptr, 0, 0, 0, HEM_INT32};
+  return res->mesh[k].view(name);
+}
+
+void cut_mesh_destroy(void * handle)
+{
+  delete static_cast<CutMeshResult *>(handle);
+}
+
+/** test.py 中的 CutStats 按这个布局定义 */
+static_assert(sizeof(CutStats) == 8*(uint32_t(CutPhase::Count) + uint32_t(CutCounter::Count) + 5));
+
+/**
+ * @brief 得到句柄中网格的切割的统计
+ * @note CutStats 只含有 64 位整数的数组, 布局见 cut_trace.h
+ */
+void cut_mesh_stats(void * handle, CutStats * out)
+{
+  *out = static_cast<CutMeshResult *>(handle)->stats;
+}
+
+/** @brief 这个进程中所有切割的累计统计, 可以在多个线程中调用 */
+void get_cut_stats(CutStats * out)
+{
+  auto & cs = cumulative_stats();
+  std::lock_guard<std::mutex> lock(cs.mutex);
+  *out = cs.stats;
+}
+
+void reset_cut_stats()
+{
+  auto & cs = cumulative_stats();
+  std::lock_guard<std::mutex> lock(cs.mutex);
+  cs.stats = CutStats();
+}
+
+}
+
+#endif /* CUT_MESH_CAPI */
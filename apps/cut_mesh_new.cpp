@@ -5,6 +5,7 @@
 
 #include "uniform_mesh_cut.h"
 #include "cut_mesh_algorithm0.h"
+#include "mesh_export.h"
 #include <cmath>
 #include <memory>
 #include <numeric>
@@ -23,6 +24,9 @@ using CutMeshAlg = CutMeshAlgorithm<Mesh>;
 using Interface = typename CutMeshAlg::Interface;
 using Intersection = typename CutMeshAlg::Intersection;
 using InterfacePoint = typename CutMeshAlg::InterfacePoint;
+using Export = MeshExport<Mesh>;
+
+#include "cut_mesh_capi.h"
 
 extern "C"
 {
@@ -65,54 +69,6 @@ void check_mesh(Mesh & m)
 
 
 
-void get_node(std::shared_ptr<Mesh> meshptr, double * point_out)
-{
-  auto & nindex = *(meshptr->get_node_indices());
-  std::function<bool(Node &)> fun = [&nindex, &point_out](Node & n)->bool 
-  { 
-    uint32_t idx = nindex[n.index()];
-    point_out[idx*2] = n.coordinate().x;
-    point_out[idx*2+1] = n.coordinate().y;
-    return true;
-  };
-  meshptr->for_each_entity(fun);
-}
-
-void get_inner_cell(std::shared_ptr<Mesh> meshptr, int * inner_cell)
-{
-  auto & is_in_the_interface = *(meshptr->get_cell_data<uint8_t>("is_in_the_interface"));
-  auto & cindex = *(meshptr->get_cell_indices());
-  std::function<bool(Cell &)> fun = [&cindex, &inner_cell, is_in_the_interface](Cell & c)->bool 
-  { 
-    uint32_t cidx = cindex[c.index()];
-    inner_cell[cidx] = is_in_the_interface[c.index()];
-    return true;
-  };
-  meshptr->for_each_entity(fun);
-}
-
-void get_halfedge(std::shared_ptr<Mesh> meshptr, int * halfedge_out)
-{
-  meshptr->update();
-  auto & hindices = *(meshptr->get_halfedge_indices());
-  auto & nindices = *(meshptr->get_node_indices());
-  auto & eindices = *(meshptr->get_edge_indices());
-  auto & cindices = *(meshptr->get_cell_indices());
-  std::function<bool(HalfEdge & h)> fun = 
-    [&halfedge_out, &hindices, &nindices, &eindices, &cindices](HalfEdge & h)->bool 
-  { 
-    uint32_t idx = hindices[h.index()];
-    halfedge_out[idx*6] = nindices[h.node()->index()];
-    halfedge_out[idx*6+1] = cindices[h.cell()->index()];
-    halfedge_out[idx*6+2] = hindices[h.next()->index()];
-    halfedge_out[idx*6+3] = hindices[h.previous()->index()];
-    halfedge_out[idx*6+4] = hindices[h.opposite()->index()];
-    halfedge_out[idx*6+5] = eindices[h.edge()->index()];
-    return true;
-  };
-  meshptr->for_each_entity(fun);
-}
-
 void generate_interface(double * point, 
                         bool * is_fixed_point, 
                         int * segment, 
@@ -131,69 +87,30 @@ void generate_interface(double * point,
   is_loop_interface = segment[0] == segment[NS-1];
 }
 
-struct MeshParameter
+std::shared_ptr<Mesh> cut_mesh1(MeshParameter mp, InterfaceParameter i0, CutStats * stats)
 {
-  double a, b, c, d;
-  int nx, ny;
-};
+  double hx = (mp.c-mp.a)/mp.nx, hy = (mp.d-mp.b)/mp.ny;
 
-struct InterfaceParameter
-{
-  double * point; 
-  bool * is_fixed_point;
-  int * segment;
-  int NP;
-  int NS;
-};
-
-struct OutParameter
-{
-  double * point_out1;
-  int * halfedge_out1;
-  int * inner_cell1;
-
-  double * point_out2;
-  int * halfedge_out2;
-
-  int * idx0; /** 密网格单元在 0 号界面生成的网格单元中的编号 */
-  int * idx1; /** 密网格单元在 1 号界面生成的网格单元中的编号 */
-
-  int * N; /** NN1, NHE1, NC1, NN2, NHE2, NC2 */
-};
-
-void get_cut_mesh(double a, double b, double c, double d, int nx, int ny, 
-              double * point,
-              bool * is_fixed_point,
-              int * segment,
-              int NP,
-              int NS,
-              double * point_out,
-              int * halfedge_out, 
-              int * N)
-{
-  double hx = (c-a)/nx, hy = (d-b)/ny;
-
-  std::shared_ptr<Mesh> meshptr = std::make_shared<Mesh>(a, b, hx, hy, nx, ny);
+  std::shared_ptr<Mesh> meshptr = std::make_shared<Mesh>(mp.a, mp.b, hx, hy, mp.nx, mp.ny);
   CutMeshAlg cut(meshptr);
 
   std::vector<Point> points;
   std::vector<bool> is_fixed_points;
   bool is_loop_interface;
-  generate_interface(point, is_fixed_point, segment, NP, NS, points, is_fixed_points, is_loop_interface);
+  generate_interface(i0.point, i0.is_fixed_point, i0.segment, i0.NP, i0.NS, 
+      points, is_fixed_points, is_loop_interface);
   Interface iface(points, is_fixed_points, meshptr, is_loop_interface);
 
-  cut.cut_by_loop_interface(iface);
+  record_stats(cut.cut_by_loop_interface(iface), stats);
   meshptr->update();
-  get_node(meshptr, point_out);
-  get_halfedge(meshptr, halfedge_out);
-  N[0] = meshptr->number_of_nodes()*2;
-  N[1] = meshptr->number_of_halfedges()*6;
+  return meshptr;
 }
 
-void get_cut_mesh2(MeshParameter mp, 
-                   InterfaceParameter i0, 
-                   InterfaceParameter i1,
-                   OutParameter out)
+void cut_mesh2(MeshParameter mp, 
+               InterfaceParameter i0, 
+               InterfaceParameter i1,
+               std::shared_ptr<Mesh> * meshptr,
+               CutStats * stats)
 {
   double a = mp.a, b = mp.b, c = mp.c, d = mp.d;
   int nx = mp.nx, ny = mp.ny;
@@ -211,16 +128,6 @@ void get_cut_mesh2(MeshParameter mp,
   int NP1 = i1.NP; 
   int NS1 = i1.NS;
 
-  double * point_out1    = out.point_out1;    /** 坐标 */
-  int    * halfedge_out1 = out.halfedge_out1; /** 半边 */
-  int    * inner_cell1   = out.inner_cell1;   /** 内部单元 */
-
-  double * point_out2    = out.point_out2;    /** 坐标 */
-  int    * halfedge_out2 = out.halfedge_out2; /** 半边 */
-
-  int    * idx0          = out.idx0;          /** 密网格单元在网格 0 中单元的编号 */
-  int    * idx1          = out.idx1;          /** 密网格单元在网格 1 中单元的编号 */
-
   /**
    * meshprt0 : 被第 0 个界面 cut 的网格
    * meshprt1 : 被第 1 个界面 cut 的网格
@@ -244,14 +151,14 @@ void get_cut_mesh2(MeshParameter mp,
   Interface iface0(points0, is_fixed_points0, meshptr0, is_loop_interface0);
   Interface iface1(points1, is_fixed_points1, meshptr1, is_loop_interface1);
 
-  cut0.cut_by_loop_interface(iface0);
-  cut1.cut_by_loop_interface(iface1);
+  record_stats(cut0.cut_by_loop_interface(iface0), stats);
+  record_stats(cut1.cut_by_loop_interface(iface1), stats);
 
   std::shared_ptr<Mesh> meshptr2 = std::make_shared<Mesh>(*meshptr0); 
   CutMeshAlg cut2(meshptr2);
 
   Interface iface2(points1, is_fixed_points1, meshptr2, is_loop_interface1);
-  cut2.cut_by_loop_interface(iface2); 
+  record_stats(cut2.cut_by_loop_interface(iface2), stats);
 
   //auto & mesh0 = *meshptr0;
   //Figure fig0("out0", mesh0.get_box());
@@ -278,39 +185,31 @@ void get_cut_mesh2(MeshParameter mp,
   //check_mesh(*meshptr0);
   //check_mesh(*meshptr1);
   //check_mesh(*meshptr2);
-  
-  /** 单元编号 */
-  auto & cindex0 = *(meshptr0->get_cell_indices());
-  auto & cindex1 = *(meshptr1->get_cell_indices());
-  auto & cindex2 = *(meshptr2->get_cell_indices());
-  std::function<bool(Cell &)> fun = [&](Cell & c)->bool 
-  { 
-    uint32_t cidx = cindex2[c.index()];
-    Point p = c.inner_point();
-    //idx0[cidx] = cindex0[meshptr0->find_point(p)->index()];
-    //idx1[cidx] = cindex1[meshptr1->find_point(p)->index()];
-    Cell * c0 = meshptr0->find_point(p);
-    Cell * c1 = meshptr1->find_point(p);
-    idx0[cidx] = cindex0[c0->index()];
-    idx1[cidx] = cindex1[c1->index()];
-    return true;
-  };
-  meshptr2->for_each_entity(fun);
-
-  out.N[0] = meshptr1->number_of_nodes()*2;
-  out.N[1] = meshptr1->number_of_halfedges()*6;
-  out.N[2] = meshptr1->number_of_cells();
-
-  out.N[3] = meshptr2->number_of_nodes()*2;
-  out.N[4] = meshptr2->number_of_halfedges()*6;
-  out.N[5] = meshptr2->number_of_cells();
-
-  get_node(meshptr1, point_out1);
-  get_halfedge(meshptr1, halfedge_out1);
-  get_inner_cell(meshptr1, inner_cell1);
-
-  get_node(meshptr2, point_out2);
-  get_halfedge(meshptr2, halfedge_out2);
+
+  meshptr[0] = meshptr0;
+  meshptr[1] = meshptr1;
+  meshptr[2] = meshptr2;
+}
+
+void get_cell_index2(std::shared_ptr<Mesh> * meshptr, int * idx0, int * idx1)
+{
+  auto & cindex0 = *(meshptr[0]->get_cell_indices());
+  auto & cindex1 = *(meshptr[1]->get_cell_indices());
+  auto & cindex2 = *(meshptr[2]->get_cell_indices());
+  uint32_t NC2 = meshptr[2]->number_of_cells();
+  std::vector<Point> points(NC2);
+  for(auto & c : *meshptr[2]->get_cell())
+    points[cindex2[c.index()]] = c.inner_point();
+
+  /** 批量查找, 见 UniformMeshCut::locate */
+  std::vector<Cell *> c0(NC2), c1(NC2);
+  meshptr[0]->locate(points.data(), NC2, c0.data());
+  meshptr[1]->locate(points.data(), NC2, c1.data());
+  for(uint32_t i = 0; i < NC2; i++)
+  {
+    idx0[i] = cindex0[c0[i]->index()];
+    idx1[i] = cindex1[c1[i]->index()];
+  }
 }
 
 int test111()
@@ -0,0 +1,357 @@
+#ifndef _HEM_BENCH_
+#define _HEM_BENCH_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <ctime>
+#include <thread>
+#include <omp.h>
+
+namespace HEM
+{
+namespace bench
+{
+
+/**
+ * @brief 一次运行的状态, 与 Google Benchmark 的 State 用法相同:
+ *   for(auto _ : state) { 被计时的代码 }
+ * @note 1. 循环之外和 pause_timing/resume_timing 之间的代码不计时,
+ *          用来准备每次迭代都会被修改的网格
+ *       2. set_items_processed 之后报告每秒处理的个数, counters 中的值原样报告
+ */
+class State
+{
+public:
+  State(uint64_t iterations, const std::vector<int64_t> & args) :
+    iterations_(iterations), args_(args) {}
+
+  int64_t range(uint32_t i = 0) const { return args_[i]; }
+
+  uint64_t iterations() const { return iterations_; }
+
+  void pause_timing() { elapsed_ += clock::now() - start_; }
+
+  void resume_timing() { start_ = clock::now(); }
+
+  void set_items_processed(uint64_t n) { items_ = n; }
+
+  /** @brief 被计时的时间 (纳秒) */
+  double elapsed() const { return std::chrono::duration<double, std::nano>(elapsed_).count(); }
+
+  uint64_t items_processed() const { return items_; }
+
+  std::map<std::string, double> counters;
+
+  /** 迭代器, 第一次比较时开始计时, 最后一次比较时停止计时 */
+  struct Iterator
+  {
+    State * state;
+    uint64_t n;
+
+    bool operator != (const Iterator &)
+    {
+      if(n == state->iterations_)
+      {
+        state->pause_timing();
+        return false;
+      }
+      return true;
+    }
+
+    void operator ++ () { n++; }
+
+    /** 析构函数不是平凡的, 循环变量没有被使用时不会产生警告 */
+    struct Value { ~Value() {} };
+
+    Value operator * () const { return Value(); }
+  };
+
+  Iterator begin()
+  {
+    resume_timing();
+    return Iterator{this, 0};
+  }
+
+  Iterator end() { return Iterator{this, iterations_}; }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  uint64_t iterations_;
+  std::vector<int64_t> args_;
+  clock::time_point start_;
+  clock::duration elapsed_{0};
+  uint64_t items_ = 0;
+};
+
+/**
+ * @brief 一个注册的基准测试, 每组参数是一次运行, 名字为 name/arg0/arg1
+ */
+class Benchmark
+{
+public:
+  Benchmark(const std::string & name, std::function<void(State &)> fun) :
+    name_(name), fun_(fun) {}
+
+  Benchmark * arg(int64_t a) { return args({a}); }
+
+  Benchmark * args(const std::vector<int64_t> & a)
+  {
+    args_.push_back(a);
+    return this;
+  }
+
+  /** @brief 固定迭代次数, 用于每次迭代都很慢的宏观测试 */
+  Benchmark * iterations(uint64_t n)
+  {
+    iterations_ = n;
+    return this;
+  }
+
+  const std::string & name() const { return name_; }
+
+private:
+  friend class Runner;
+
+  std::string name_;
+  std::function<void(State &)> fun_;
+  std::vector<std::vector<int64_t>> args_;
+  uint64_t iterations_ = 0;
+};
+
+inline std::vector<Benchmark *> & registry()
+{
+  static std::vector<Benchmark *> benchmarks;
+  return benchmarks;
+}
+
+inline Benchmark * register_benchmark(const std::string & name, std::function<void(State &)> fun)
+{
+  registry().push_back(new Benchmark(name, fun));
+  return registry().back();
+}
+
+/** @brief 防止编译器去掉结果没有被使用的计算 */
+template<typename T>
+inline void do_not_optimize(const T & value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief 运行所有注册的基准测试, 结果输出到终端, 指定 --out 时同时写成 JSON
+ * @note 命令行参数:
+ *   --filter=<s>      只运行名字中含有 s 的测试
+ *   --min_time=<t>    每次运行至少计时 t 秒, 默认 0.2
+ *   --repetitions=<n> 每次运行重复 n 次, 报告时间的中位数, 默认 3
+ *   --out=<file>      JSON 结果文件, 格式与 Google Benchmark 的 JSON 输出相同
+ */
+class Runner
+{
+public:
+  struct Result
+  {
+    std::string name;
+    uint64_t iterations;
+    double real_time; /**< 每次迭代的时间 (纳秒), 重复中的中位数 */
+    double min_time;  /**< 重复中最短的每次迭代的时间 */
+    double items_per_second;
+    std::map<std::string, double> counters;
+  };
+
+public:
+  Runner(int argc, char ** argv)
+  {
+    for(int i = 1; i < argc; i++)
+    {
+      std::string a = argv[i];
+      auto value = [&a](const std::string & key, std::string & v)
+      {
+        if(a.compare(0, key.size(), key) != 0)
+          return false;
+        v = a.substr(key.size());
+        return true;
+      };
+      std::string v;
+      if(value("--filter=", v))
+        filter_ = v;
+      else if(value("--min_time=", v))
+        min_time_ = std::stod(v);
+      else if(value("--repetitions=", v))
+        repetitions_ = std::max(1, std::stoi(v));
+      else if(value("--out=", v))
+        out_ = v;
+      else
+        std::cerr << "unknown argument : " << a << std::endl;
+    }
+  }
+
+  int run()
+  {
+    std::cout << std::left << std::setw(48) << "Benchmark" << std::right
+              << std::setw(16) << "Time (ns)" << std::setw(14) << "Iterations"
+              << std::setw(16) << "Items/s" << std::endl;
+    for(Benchmark * b : registry())
+    {
+      auto args = b->args_;
+      if(args.empty())
+        args.push_back({});
+      for(auto & a : args)
+      {
+        std::string name = b->name_;
+        for(int64_t x : a)
+          name += "/" + std::to_string(x);
+        if(name.find(filter_) == std::string::npos)
+          continue;
+        results_.push_back(run_one(*b, name, a));
+        print(results_.back());
+      }
+    }
+    if(!out_.empty())
+      write_json();
+    return 0;
+  }
+
+private:
+  Result run_one(Benchmark & b, const std::string & name, const std::vector<int64_t> & args)
+  {
+    /** 迭代次数翻倍, 直到计时超过 min_time_ */
+    uint64_t n = b.iterations_;
+    if(n == 0)
+    {
+      for(n = 1; ; n *= 2)
+      {
+        State s(n, args);
+        b.fun_(s);
+        if(s.elapsed() >= min_time_*1e9 || n >= (uint64_t(1) << 30))
+          break;
+        if(s.elapsed() > min_time_*1e8)
+        {
+          n = std::max(n+1, uint64_t(n*min_time_*1.2e9/s.elapsed()));
+          break;
+        }
+      }
+    }
+
+    std::vector<double> times;
+    State last(n, args);
+    for(int r = 0; r < repetitions_; r++)
+    {
+      State s(n, args);
+      b.fun_(s);
+      times.push_back(s.elapsed()/n);
+      if(r == repetitions_-1)
+        last = s;
+    }
+    std::vector<double> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+
+    Result res;
+    res.name = name;
+    res.iterations = n;
+    res.real_time = sorted[sorted.size()/2];
+    res.min_time = sorted[0];
+    res.items_per_second = last.items_processed() > 0 ?
+      last.items_processed()/(res.real_time*n*1e-9) : 0.0;
+    res.counters = last.counters;
+    return res;
+  }
+
+  void print(const Result & r)
+  {
+    std::cout << std::left << std::setw(48) << r.name << std::right
+              << std::setw(16) << std::fixed << std::setprecision(0) << r.real_time
+              << std::setw(14) << r.iterations << std::setw(16);
+    if(r.items_per_second > 0)
+      std::cout << std::scientific << std::setprecision(3) << r.items_per_second;
+    else
+      std::cout << "-";
+    for(auto & [k, v] : r.counters)
+      std::cout << "  " << k << "=" << std::defaultfloat << v;
+    std::cout << std::defaultfloat << std::endl;
+  }
+
+  static std::string escape(const std::string & s)
+  {
+    std::string r;
+    for(char c : s)
+    {
+      if(c == '"' || c == '\\')
+        r += '\\';
+      r += c;
+    }
+    return r;
+  }
+
+  void write_json()
+  {
+    std::ofstream f(out_);
+    char date[64];
+    std::time_t t = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&t));
+#ifdef NDEBUG
+    const char * build = "release";
+#else
+    const char * build = "debug";
+#endif
+
+    f << std::setprecision(17);
+    f << "{\n  \"context\": {\n"
+      << "    \"date\": \"" << date << "\",\n"
+      << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+      << "    \"omp_max_threads\": " << omp_get_max_threads() << ",\n"
+      << "    \"compiler\": \"" << escape(__VERSION__) << "\",\n"
+      << "    \"library_build_type\": \"" << build << "\",\n"
+      << "    \"repetitions\": " << repetitions_ << ",\n"
+      << "    \"min_time\": " << min_time_ << "\n"
+      << "  },\n  \"benchmarks\": [\n";
+    for(size_t i = 0; i < results_.size(); i++)
+    {
+      const Result & r = results_[i];
+      f << "    {\n"
+        << "      \"name\": \"" << escape(r.name) << "\",\n"
+        << "      \"run_type\": \"iteration\",\n"
+        << "      \"iterations\": " << r.iterations << ",\n"
+        << "      \"real_time\": " << r.real_time << ",\n"
+        << "      \"min_time\": " << r.min_time << ",\n"
+        << "      \"time_unit\": \"ns\"";
+      if(r.items_per_second > 0)
+        f << ",\n      \"items_per_second\": " << r.items_per_second;
+      for(auto & [k, v] : r.counters)
+        f << ",\n      \"" << escape(k) << "\": " << v;
+      f << "\n    }" << (i+1 < results_.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+  }
+
+private:
+  std::string filter_;
+  double min_time_ = 0.2;
+  int repetitions_ = 3;
+  std::string out_;
+  std::vector<Result> results_;
+};
+
+}
+}
+
+#define HEM_BENCH_CONCAT_(a, b) a##b
+#define HEM_BENCH_CONCAT(a, b) HEM_BENCH_CONCAT_(a, b)
+
+/** @brief 注册函数 fun 为基准测试, 可以接着调用 ->arg, ->args, ->iterations */
+#define HEM_BENCHMARK(fun) \
+  static ::HEM::bench::Benchmark * HEM_BENCH_CONCAT(hem_bench_, __LINE__) = \
+    ::HEM::bench::register_benchmark(#fun, fun)
+
+#define HEM_BENCHMARK_MAIN() \
+  int main(int argc, char ** argv) { return ::HEM::bench::Runner(argc, argv).run(); }
+
+#endif /* _HEM_BENCH_ */
@@ -0,0 +1,161 @@
+#include <cmath>
+#include <memory>
+
+#include "bench.h"
+#include "uniform_mesh.h"
+#include "cut_mesh_algorithm.h"
+#include "mesh_export.h"
+
+using namespace HEM;
+using namespace HEM::bench;
+
+using Mesh = CutMesh<UniformMesh<2>>;
+using CutMeshAlg = CutMeshAlgorithm<UniformMesh<2>>;
+using Interface = CutMeshAlg::Interface;
+using Point = Mesh::Point;
+
+/**
+ * @brief 切割的宏观基准测试, 在 [0, 1]^2 上 n x n 的网格中切割有 NP 个点的界面,
+ *   每次迭代从复制的网格开始
+ */
+
+/** @brief 由首尾相连的点生成循环界面 */
+Interface loop_interface(const std::vector<Point> & points)
+{
+  Interface iface;
+  iface.points = points;
+  iface.is_fixed_points.assign(points.size(), false);
+  for(uint32_t i = 0; i < points.size(); i++)
+    iface.segments.push_back(i);
+  iface.segments.push_back(0);
+  return iface;
+}
+
+Interface circle(uint32_t NP)
+{
+  std::vector<Point> points(NP);
+  for(uint32_t i = 0; i < NP; i++)
+  {
+    double t = 2*M_PI*i/NP;
+    points[i] = Point(0.5+0.3*std::cos(t), 0.5+0.3*std::sin(t));
+  }
+  return loop_interface(points);
+}
+
+/** @brief 五角星, 每条边上均匀分布着点 */
+Interface star(uint32_t NP)
+{
+  Point corner[10];
+  for(uint32_t k = 0; k < 10; k++)
+  {
+    double t = M_PI/2 + M_PI*k/5;
+    double r = k%2 == 0 ? 0.4 : 0.16;
+    corner[k] = Point(0.5+r*std::cos(t), 0.5+r*std::sin(t));
+  }
+  uint32_t m = std::max(NP/10, 1u);
+  std::vector<Point> points;
+  for(uint32_t k = 0; k < 10; k++)
+  {
+    const Point & a = corner[k];
+    const Point & b = corner[(k+1)%10];
+    for(uint32_t i = 0; i < m; i++)
+      points.push_back(a + (b-a)*(double(i)/m));
+  }
+  return loop_interface(points);
+}
+
+/** @brief 两圈的阿基米德螺线沿宽为 0.02 的带状区域的边界, 相邻的圈相距 0.06 */
+Interface spiral(uint32_t NP)
+{
+  uint32_t m = std::max(NP/2, 2u);
+  std::vector<Point> points;
+  auto at = [](double t, double w) 
+  {
+    double r = 0.05 + 0.06*t/(2*M_PI) - w;
+    return Point(0.5+r*std::cos(t), 0.5+r*std::sin(t));
+  };
+  for(uint32_t i = 0; i < m; i++)
+    points.push_back(at(4*M_PI*i/(m-1), 0.0));
+  for(uint32_t i = m; i-- > 0;)
+    points.push_back(at(4*M_PI*i/(m-1), 0.02));
+  return loop_interface(points);
+}
+
+template<Interface (*Shape)(uint32_t)>
+void cut_by_loop_interface(State & state)
+{
+  int64_t n = state.range(0);
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/n, 1.0/n, n, n);
+  Interface iface = Shape(state.range(1));
+  CutStats stats;
+  for(auto _ : state)
+  {
+    state.pause_timing();
+    auto m = std::make_shared<Mesh>(*mesh);
+    Interface f = iface;
+    CutMeshAlg alg(m);
+    state.resume_timing();
+    stats += alg.cut_by_loop_interface(f);
+  }
+  state.set_items_processed(state.iterations()*iface.points.size());
+  state.counters["cells_added"] = double(stats.added[2])/stats.cuts;
+  state.counters["inner_cells_ms"] = stats.seconds(CutPhase::InnerCells)*1e3/stats.cuts;
+}
+
+void cut_circle(State & state) { cut_by_loop_interface<circle>(state); }
+HEM_BENCHMARK(cut_circle)->args({256, 1000})->args({1024, 10000});
+
+void cut_star(State & state) { cut_by_loop_interface<star>(state); }
+HEM_BENCHMARK(cut_star)->args({256, 1000})->args({1024, 10000});
+
+void cut_spiral(State & state) { cut_by_loop_interface<spiral>(state); }
+HEM_BENCHMARK(cut_spiral)->args({256, 1000})->args({1024, 10000});
+
+/** @brief 并发切割 k x k 个互不相交的小圆, 参数为 n 和 k */
+void cut_by_interfaces_parallel(State & state)
+{
+  int64_t n = state.range(0), k = state.range(1);
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/n, 1.0/n, n, n);
+  std::vector<Interface> ifaces;
+  for(int64_t i = 0; i < k; i++)
+  {
+    for(int64_t j = 0; j < k; j++)
+    {
+      Interface c = circle(64);
+      for(auto & p : c.points)
+        p = Point((i+0.5)/k, (j+0.5)/k) + (p - Point(0.5, 0.5))*(1.0/k);
+      ifaces.push_back(c);
+    }
+  }
+  for(auto _ : state)
+  {
+    state.pause_timing();
+    auto m = std::make_shared<Mesh>(*mesh);
+    auto fs = ifaces;
+    CutMeshAlg alg(m);
+    state.resume_timing();
+    alg.cut_by_interfaces(fs, true);
+  }
+  state.set_items_processed(state.iterations()*ifaces.size());
+}
+HEM_BENCHMARK(cut_by_interfaces_parallel)->args({1024, 16});
+
+/** @brief 导出切割后的网格, 见 MeshExport::build */
+void cut_mesh_export(State & state)
+{
+  int64_t n = state.range(0);
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/n, 1.0/n, n, n);
+  Interface iface = star(state.range(1));
+  CutMeshAlg(mesh).cut_by_loop_interface(iface);
+  MeshExport<Mesh> ex;
+  for(auto _ : state)
+  {
+    ex.build(*mesh);
+    auto & inner = ex.add_array("inner_cell", mesh->number_of_cells());
+    do_not_optimize(inner.data());
+  }
+  state.set_items_processed(state.iterations()*mesh->number_of_halfedges());
+}
+HEM_BENCHMARK(cut_mesh_export)->args({1024, 10000});
+
+HEM_BENCHMARK_MAIN()
@@ -0,0 +1,271 @@
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include "bench.h"
+#include "uniform_mesh.h"
+#include "uniform_mesh_cut.h"
+#include "find_points.h"
+#include "mesh_export.h"
+
+using namespace HEM;
+using namespace HEM::bench;
+
+using Mesh = UniformMesh<2>;
+using CutMesh = UniformMeshCut<2>;
+using Point = Mesh::Point;
+
+/**
+ * @brief 网格操作的微观基准测试, 参数 n 表示 [0, 1]^2 上 n x n 的网格
+ */
+
+template<typename M>
+std::shared_ptr<M> make_mesh(int64_t n)
+{
+  return std::make_shared<M>(0.0, 0.0, 1.0/n, 1.0/n, n, n);
+}
+
+/** @brief 沿对角线把每个四边形分成两个三角形 */
+template<typename M>
+void split_all_cells(M & mesh)
+{
+  std::vector<typename M::Cell *> cells;
+  for(auto & c : *mesh.get_cell())
+    cells.push_back(&c);
+  for(auto * c : cells)
+  {
+    auto * h0 = c->halfedge();
+    mesh.splite_cell(c, h0, h0->next()->next());
+  }
+}
+
+/** @brief 固定种子的随机点, 每次运行相同 */
+std::vector<Point> random_points(uint32_t N)
+{
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> d(0.0, 1.0);
+  std::vector<Point> points(N);
+  for(auto & p : points)
+    p = Point(d(gen), d(gen));
+  return points;
+}
+
+void construct(State & state)
+{
+  int64_t n = state.range(0);
+  for(auto _ : state)
+  {
+    Mesh mesh(0.0, 0.0, 1.0/n, 1.0/n, n, n);
+    do_not_optimize(mesh.number_of_cells());
+  }
+  state.set_items_processed(state.iterations()*n*n);
+}
+HEM_BENCHMARK(construct)->arg(64)->arg(256)->arg(1024);
+
+void copy_construct(State & state)
+{
+  auto mesh = make_mesh<Mesh>(state.range(0));
+  for(auto _ : state)
+  {
+    Mesh copy(*mesh);
+    do_not_optimize(copy.number_of_cells());
+  }
+  state.set_items_processed(state.iterations()*mesh->number_of_cells());
+}
+HEM_BENCHMARK(copy_construct)->arg(64)->arg(256)->arg(1024);
+
+/** @brief 完整的重新编号, 每次迭代之前把所有实体标记为被修改过 */
+void update(State & state)
+{
+  auto mesh = make_mesh<Mesh>(state.range(0));
+  split_all_cells(*mesh);
+  for(auto _ : state)
+  {
+    state.pause_timing();
+    mesh->set_dirty();
+    state.resume_timing();
+    mesh->update();
+  }
+  state.set_items_processed(state.iterations()*mesh->number_of_halfedges());
+}
+HEM_BENCHMARK(update)->arg(256)->arg(1024);
+
+/** @brief 对 Entity 类型的每个实体读取一个相邻实体的编号 */
+template<typename Entity>
+void for_each_entity(State & state)
+{
+  auto mesh = make_mesh<Mesh>(state.range(0));
+  uint64_t N = mesh->template get_entity<Entity>()->size();
+  for(auto _ : state)
+  {
+    uint64_t s = 0;
+    mesh->template for_each_entity<Entity>([&s](Entity & e)
+    {
+      s += e.halfedge()->index();
+    });
+    do_not_optimize(s);
+  }
+  state.set_items_processed(state.iterations()*N);
+}
+
+void for_each_node(State & state) { for_each_entity<Mesh::Node>(state); }
+HEM_BENCHMARK(for_each_node)->arg(1024);
+
+void for_each_edge(State & state) { for_each_entity<Mesh::Edge>(state); }
+HEM_BENCHMARK(for_each_edge)->arg(1024);
+
+void for_each_cell(State & state) { for_each_entity<Mesh::Cell>(state); }
+HEM_BENCHMARK(for_each_cell)->arg(1024);
+
+void for_each_halfedge(State & state)
+{
+  auto mesh = make_mesh<Mesh>(state.range(0));
+  uint64_t N = mesh->number_of_halfedges();
+  for(auto _ : state)
+  {
+    uint64_t s = 0;
+    mesh->for_each_halfedge([&s](Mesh::HalfEdge & h) { s += h.next()->index(); });
+    do_not_optimize(s);
+  }
+  state.set_items_processed(state.iterations()*N);
+}
+HEM_BENCHMARK(for_each_halfedge)->arg(1024);
+
+/** @brief 加密每条边, 每次迭代从复制的网格开始 */
+void splite_halfedge(State & state)
+{
+  auto mesh = make_mesh<Mesh>(state.range(0));
+  uint64_t NE = mesh->number_of_edges();
+  for(auto _ : state)
+  {
+    state.pause_timing();
+    Mesh m(*mesh);
+    std::vector<Mesh::HalfEdge *> hs;
+    for(auto & e : *m.get_edge())
+      hs.push_back(e.halfedge());
+    state.resume_timing();
+    for(auto * h : hs)
+      m.splite_halfedge(h);
+    do_not_optimize(m.number_of_nodes());
+  }
+  state.set_items_processed(state.iterations()*NE);
+}
+HEM_BENCHMARK(splite_halfedge)->arg(256);
+
+/** @brief 沿对角线分割每个单元, 每次迭代从复制的网格开始 */
+template<typename M>
+void splite_cell_imp(State & state)
+{
+  auto mesh = make_mesh<M>(state.range(0));
+  uint64_t NC = mesh->number_of_cells();
+  for(auto _ : state)
+  {
+    state.pause_timing();
+    M m(*mesh);
+    std::vector<typename M::Cell *> cells;
+    for(auto & c : *m.get_cell())
+      cells.push_back(&c);
+    state.resume_timing();
+    for(auto * c : cells)
+    {
+      auto * h0 = c->halfedge();
+      m.splite_cell(c, h0, h0->next()->next());
+    }
+    do_not_optimize(m.number_of_cells());
+  }
+  state.set_items_processed(state.iterations()*NC);
+}
+
+void splite_cell(State & state) { splite_cell_imp<Mesh>(state); }
+HEM_BENCHMARK(splite_cell)->arg(256);
+
+/** @brief 同时增量更新 subcell_ 的分割 */
+void splite_cell_with_subcell(State & state) { splite_cell_imp<CutMesh>(state); }
+HEM_BENCHMARK(splite_cell_with_subcell)->arg(256);
+
+/** @brief 在分成三角形的网格中查找随机点, 参数为 n 和点数 */
+void find_point(State & state)
+{
+  auto mesh = make_mesh<CutMesh>(state.range(0));
+  split_all_cells(*mesh);
+  auto points = random_points(state.range(1));
+  for(auto _ : state)
+  {
+    uint64_t s = 0;
+    for(auto & p : points)
+      s += mesh->find_point(p) != nullptr;
+    do_not_optimize(s);
+  }
+  state.set_items_processed(state.iterations()*points.size());
+}
+HEM_BENCHMARK(find_point)->args({256, 100000});
+
+/** @brief 按顺序查找一条曲线上的点, 每次从上一次的单元出发 */
+void find_point_locator(State & state)
+{
+  auto mesh = make_mesh<CutMesh>(state.range(0));
+  split_all_cells(*mesh);
+  uint32_t N = state.range(1);
+  std::vector<Point> points(N);
+  for(uint32_t i = 0; i < N; i++)
+  {
+    double t = 2*M_PI*i/N;
+    points[i] = Point(0.5+0.3*std::cos(t), 0.5+0.3*std::sin(t));
+  }
+  for(auto _ : state)
+  {
+    CutMesh::Locator loc(*mesh);
+    uint64_t s = 0;
+    for(auto & p : points)
+      s += loc.find_point(p) != nullptr;
+    do_not_optimize(s);
+  }
+  state.set_items_processed(state.iterations()*N);
+}
+HEM_BENCHMARK(find_point_locator)->args({256, 100000});
+
+void locate_batch(State & state)
+{
+  auto mesh = make_mesh<CutMesh>(state.range(0));
+  split_all_cells(*mesh);
+  auto points = random_points(state.range(1));
+  std::vector<CutMesh::Cell *> cells(points.size());
+  for(auto _ : state)
+    mesh->locate(points.data(), points.size(), cells.data());
+  state.set_items_processed(state.iterations()*points.size());
+}
+HEM_BENCHMARK(locate_batch)->args({256, 100000});
+
+void find_point_quadtree(State & state)
+{
+  auto mesh = make_mesh<Mesh>(state.range(0));
+  split_all_cells(*mesh);
+  QuadTreeFindPointAlg<Mesh> tree(mesh);
+  auto points = random_points(state.range(1));
+  for(auto _ : state)
+  {
+    uint64_t s = 0;
+    for(auto & p : points)
+      s += tree.find_point(p) != nullptr;
+    do_not_optimize(s);
+  }
+  state.set_items_processed(state.iterations()*points.size());
+}
+HEM_BENCHMARK(find_point_quadtree)->args({256, 100000});
+
+/** @brief C 接口导出网格的数组, 见 MeshExport::build */
+void mesh_export(State & state)
+{
+  auto mesh = make_mesh<Mesh>(state.range(0));
+  split_all_cells(*mesh);
+  MeshExport<Mesh> ex;
+  for(auto _ : state)
+  {
+    ex.build(*mesh);
+    do_not_optimize(ex.halfedge().data);
+  }
+  state.set_items_processed(state.iterations()*mesh->number_of_halfedges());
+}
+HEM_BENCHMARK(mesh_export)->arg(256)->arg(1024);
+
+HEM_BENCHMARK_MAIN()
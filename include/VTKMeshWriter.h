@@ -79,7 +79,7 @@ public:
           auto coordinate = pp.coordinate();
           points->InsertNextPoint(coordinate[0], coordinate[1], 0.0);
         };
-        mesh.for_each_entity(func);
+        mesh.for_each_node(func);
       }
       m_ugrid->SetPoints(points);
     }
@@ -101,7 +101,7 @@ public:
         for(int i = 0; i < N; i++)
           cells->InsertCellPoint(nidx[c2n->index()]);
       };
-      mesh.for_each_entity(func);
+      mesh.for_each_cell(func);
       m_ugrid->SetCells(7, cells);
     }
 
@@ -2,12 +2,16 @@
 #define _CHUNK_ARRAY_
 
 #include <cassert>
+#include <cstddef>
 #include <vector>
 #include <stdexcept>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <iostream>
+#include <type_traits>
 
-//#include "mark_array.h"
+#include "mark_array.h"
 
 namespace HEM {
 
@@ -22,8 +26,7 @@ class ChunkArray;
 class ArrayBase 
 {
 public:
-  //using MarkArray = ChunkArrayBool<1024u>;
-  using MarkArray = ChunkArray<uint8_t, 1024u>;
+  using MarkArray = ChunkArrayBool<1024u>;
 
 public:
   ArrayBase(std::string name = "null"): name_(name) {}
@@ -35,8 +38,11 @@ public:
 
   virtual ~ArrayBase() = 0;
   virtual void resize(size_t size) = 0;
+  virtual void reserve(size_t capacity);
   virtual void clear() = 0;
-  virtual void copy_self(std::shared_ptr<MarkArray> &, std::shared_ptr<ArrayBase> & );
+  virtual void copy_self(std::shared_ptr<MarkArray> &, std::shared_ptr<ArrayBase> &, 
+      std::pmr::memory_resource * resource = nullptr);
+  virtual void permute(const uint32_t * order, uint32_t n);
 
 private:
   std::string name_;
@@ -46,9 +52,14 @@ ArrayBase::~ArrayBase() {}
 
 void ArrayBase::resize(size_t ){}
 
+void ArrayBase::reserve(size_t ){}
+
 void ArrayBase::clear() {}
 
-void ArrayBase::copy_self(std::shared_ptr<MarkArray> &, std::shared_ptr<ArrayBase> & ) {}
+void ArrayBase::copy_self(std::shared_ptr<MarkArray> &, std::shared_ptr<ArrayBase> &, 
+    std::pmr::memory_resource * ) {}
+
+void ArrayBase::permute(const uint32_t * , uint32_t ) {}
 
 /**
  * @brief 分块存储的数组
@@ -56,12 +67,18 @@ void ArrayBase::copy_self(std::shared_ptr<MarkArray> &, std::shared_ptr<ArrayBas
  * @param ChunkSize : 每个块的元素个数
  * @param size_     : 当前数组的长度
  * @param chunks_   : 每个块的指针
+ * @param context_  : 块头中存储的上下文指针
+ * @param resource_ : 分配块的内存资源, 默认为 std::pmr::get_default_resource()
+ * @note 每个块的第 0 个元素前面有一个大小为 HeaderSize 的块头，块头中存储了
+ *   context_，这样只要知道一个元素的地址和编号，就可以找到数组的上下文。
  */
 template <typename T, uint32_t CHUNK_SIZE = 1024u>
 class ChunkArray : public ArrayBase 
 {
 public:
   const constexpr static uint32_t ChunkSize = CHUNK_SIZE;
+  const constexpr static size_t HeaderSize = 
+    alignof(T) > alignof(std::max_align_t) ? alignof(T) : alignof(std::max_align_t);
   using Self = ChunkArray<T, ChunkSize>;
   using Base = ArrayBase;
 
@@ -69,15 +86,16 @@ public:
   /**
    * @brief 构造函数
    */
-  ChunkArray(std::string name = "null"): Base(name), size_(0), chunks_(0)
-  { 
-    chunks_.reserve(1024); 
-  }
+  ChunkArray(std::string name = "null", std::pmr::memory_resource * resource = nullptr): 
+    Base(name), size_(0), chunks_(0), resource_(get_resource(resource))
+  {}
 
   /**
    * @brief 构造函数带 resize
    */
-  ChunkArray(int size, std::string name = "null"): Base(name), size_(0), chunks_(0)
+  ChunkArray(int size, std::string name = "null", 
+      std::pmr::memory_resource * resource = nullptr): 
+    Base(name), size_(0), chunks_(0), resource_(get_resource(resource))
   {
     resize(size);
   }
@@ -85,7 +103,8 @@ public:
   /**
    * @brief 复制构造函数
    */
-  ChunkArray(const Self & other)
+  ChunkArray(const Self & other, std::pmr::memory_resource * resource = nullptr): 
+    Base(other.get_name()), size_(0), chunks_(0), resource_(get_resource(resource))
   {
     this->copy(other);
   }
@@ -94,7 +113,7 @@ public:
   ~ChunkArray() override 
   {
     for (T* chunk : chunks_) 
-      delete[] chunk;
+      deallocate_chunk(chunk);
   }
 
   T& operator[](size_t index)
@@ -136,7 +155,7 @@ public:
   void push_back(const T& value) 
   {
     if (size_ == chunks_.size() * ChunkSize) 
-      chunks_.push_back(new T[ChunkSize]);
+      chunks_.push_back(allocate_chunk());
 
     size_t chunkIndex = size_ / ChunkSize;
     size_t offset = size_ % ChunkSize;
@@ -152,7 +171,7 @@ public:
   void emplace_back(Args&&... args)
   {
     if (size_ == capacity())
-      chunks_.push_back(new T[ChunkSize]);
+      chunks_.push_back(allocate_chunk());
 
     size_t chunkIndex = size_ / ChunkSize;
     size_t offset = size_ % ChunkSize;
@@ -167,15 +186,30 @@ public:
   // 获取当前分配的内存容量
   size_t capacity() const { return chunks_.size() * ChunkSize;}
 
-  // 交换两个 ChunkedVector 的内容
+  // 交换两个 ChunkedVector 的内容, 块头中的上下文仍然属于各自的数组
   void swap(Self & other) 
   {
     std::swap(chunks_, other.chunks_);
     std::swap(size_, other.size_);
+    std::swap(resource_, other.resource_);
+    set_context(context_);
+    other.set_context(other.context_);
   }
 
   void clear() override { size_ = 0;}
 
+  /**
+   * @brief 重排元素, 重排后有 n 个元素, 第 k 个元素是原来的第 order[k] 个元素
+   * @note 元素被移动到新的块中, 原来的块全部释放, 所以不会留下多余的块
+   */
+  void permute(const uint32_t * order, uint32_t n) override
+  {
+    Self tmp(n, this->get_name(), resource_);
+    for(uint32_t k = 0; k < n; k++)
+      tmp[k] = std::move((*this)[order[k]]);
+    swap(tmp);
+  }
+
   // 复制另一个 ChunkArray 的内容
   void copy(const Self & other) 
   {
@@ -183,7 +217,8 @@ public:
     {
       this->set_name(other.get_name());
       resize(other.size_);
-      size_t N_chunk = other.chunks_.size();
+      /** other 预留的块可能比这里多, 只复制用到的块 */
+      size_t N_chunk = (other.size_ + ChunkSize - 1) / ChunkSize;
       for (size_t i = 0; i < N_chunk; ++i) 
         std::copy(other.chunks_[i], other.chunks_[i]+ChunkSize, chunks_[i]);
     }
@@ -196,16 +231,32 @@ public:
     return *this;
   }
 
-  /** @breif 预留空间，使得至少可以容纳指定数量的元素 */
-  void reserve(size_t newCapacity) 
+  /** 
+   * @breif 预留空间，使得至少可以容纳指定数量的元素 
+   * @note 一次新增的块不少于 ParallelTouchChunks 时, 先串行地从 resource_ 
+   *   申请内存, 再按 schedule(static) 并行地初始化, 使得每个块的页面由之后
+   *   按同样方式遍历它的线程第一次访问 (first touch), 落在该线程的 NUMA 节点上
+   */
+  void reserve(size_t newCapacity) override
   {
     uint32_t cap = capacity();
     if (newCapacity > cap) 
     {
-      uint32_t requiredChunks = (newCapacity + ChunkSize - 1) / ChunkSize;
+      int32_t begin = cap/ChunkSize;
+      int32_t requiredChunks = (newCapacity + ChunkSize - 1) / ChunkSize;
       chunks_.resize(requiredChunks, nullptr);
-      for (size_t i = cap/ChunkSize; i < requiredChunks; ++i) 
-        chunks_[i] = new T[ChunkSize]();
+      if(requiredChunks - begin < ParallelTouchChunks)
+      {
+        for (int32_t i = begin; i < requiredChunks; ++i) 
+          chunks_[i] = allocate_chunk();
+        return;
+      }
+
+      for (int32_t i = begin; i < requiredChunks; ++i) 
+        chunks_[i] = allocate_raw_chunk();
+      #pragma omp parallel for schedule(static)
+      for (int32_t i = begin; i < requiredChunks; ++i) 
+        construct_chunk(chunks_[i]);
     }
   }
 
@@ -226,6 +277,28 @@ public:
       std::fill(chunk, chunk+ChunkSize, value);
   }
 
+  /** @brief 设置上下文，并写入所有块的块头 */
+  void set_context(void * context)
+  {
+    context_ = context;
+    for(auto chunk : chunks_)
+      header_of(chunk) = context;
+  }
+
+  void * get_context() const { return context_; }
+
+  std::pmr::memory_resource * memory_resource() const { return resource_; }
+
+  /** 
+   * @brief 由元素的地址和编号获取其所在块的块头中的上下文
+   * @param elem  : 数组中的元素
+   * @param index : 元素在数组中的编号
+   */
+  static void * context_of(const T * elem, size_t index)
+  {
+    return header_of(const_cast<T *>(elem - index % ChunkSize));
+  }
+
 public:
   // 迭代子
   class Iterator 
@@ -256,9 +329,54 @@ public:
   // 迭代子的结束位置
   Iterator end() { return Iterator(*this, size_);}
 
+  /** 一次 reserve 新增的块不少于这个数时并行初始化 */
+  const constexpr static int32_t ParallelTouchChunks = 64;
+
+private:
+  const constexpr static size_t ChunkBytes = HeaderSize + sizeof(T)*ChunkSize;
+
+  static std::pmr::memory_resource * get_resource(std::pmr::memory_resource * resource)
+  {
+    return resource ? resource : std::pmr::get_default_resource();
+  }
+
+  /** @brief 从 resource_ 分配一个带块头的块, 块中的元素都是值初始化的 */
+  T * allocate_chunk()
+  {
+    T * chunk = allocate_raw_chunk();
+    construct_chunk(chunk);
+    return chunk;
+  }
+
+  /** @brief 只分配内存, 不访问块中的元素 */
+  T * allocate_raw_chunk()
+  {
+    char * mem = static_cast<char *>(resource_->allocate(ChunkBytes, HeaderSize));
+    return reinterpret_cast<T *>(mem + HeaderSize);
+  }
+
+  void construct_chunk(T * chunk)
+  {
+    std::uninitialized_value_construct_n(chunk, ChunkSize);
+    header_of(chunk) = context_;
+  }
+
+  void deallocate_chunk(T * chunk)
+  {
+    std::destroy_n(chunk, ChunkSize);
+    resource_->deallocate(reinterpret_cast<char *>(chunk) - HeaderSize, ChunkBytes, HeaderSize);
+  }
+
+  static void * & header_of(T * chunk)
+  {
+    return *reinterpret_cast<void **>(reinterpret_cast<char *>(chunk) - HeaderSize);
+  }
+
 private:
-  size_t size_;  // 元素个数
+  size_t size_ = 0;  // 元素个数
   std::vector<T*> chunks_;  // 存储块的指针
+  std::pmr::memory_resource * resource_ = std::pmr::get_default_resource(); // 分配块的内存资源
+  void * context_ = nullptr; // 块头中的上下文
 };
 
 /**
@@ -285,14 +403,19 @@ public:
   /**
    * @brief 构造函数
    */
-  ChunkArrayWithMark(std::string name, std::shared_ptr<MarkArray> mark): 
-    Base(mark->size(), name), mark_(mark) {}
+  ChunkArrayWithMark(std::string name, std::shared_ptr<MarkArray> mark, 
+      std::pmr::memory_resource * resource = nullptr): 
+    Base(mark->size(), name, resource), mark_(mark) {}
 
   void set_mark(std::shared_ptr<MarkArray> & mark) { mark_ = mark; }
 
-  void copy_self(std::shared_ptr<MarkArray> & mark, std::shared_ptr<ArrayBase> & re) override
+  /** @brief 复制自身, 新的数组和它的控制块都从 resource 分配 */
+  void copy_self(std::shared_ptr<MarkArray> & mark, std::shared_ptr<ArrayBase> & re, 
+      std::pmr::memory_resource * resource = nullptr) override
   {
-    std::shared_ptr<Self> cp = std::make_shared<Self>(Base::get_name(), mark);
+    resource = resource ? resource : std::pmr::get_default_resource();
+    std::shared_ptr<Self> cp = std::allocate_shared<Self>(
+        std::pmr::polymorphic_allocator<Self>(resource), Base::get_name(), mark, resource);
     cp->copy(*this);
     re = std::dynamic_pointer_cast<ArrayBase>(cp);
   }
@@ -304,12 +427,10 @@ public:
     Iterator(ChunkArrayWithMark & array, size_t index)
         : array_(array), index_(index) {}
 
-    /** 左 ++ */
+    /** 左 ++, 按 64 位的字跳过被释放的位置 */
     Iterator & operator++() 
     {
-      index_++;
-      while(index_ < array_.size() && (array_.mark_->get(index_)==1))
-        index_++;
+      index_ = array_.next_index(index_+1);
       return *this;
     }
 
@@ -332,12 +453,60 @@ public:
     size_t index_;
   };
 
-  // 迭代子的起始位置
-  Iterator begin() { return Iterator(*this, 0); }
+  // 迭代子的起始位置, 第 0 个位置也可能已经被释放
+  Iterator begin() { return Iterator(*this, next_index(0)); }
 
   // 迭代子的结束位置
   Iterator end() { return Iterator(*this, this->size());}
 
+  /** 块的个数, 最后一个块可能没有满 */
+  size_t number_of_chunks() const { return (this->size()+Base::ChunkSize-1)/Base::ChunkSize; }
+
+  /**
+   * @brief 对第 k 个块中没有被释放的元素调用 f
+   * @note 不同的块互不相交, 可以由不同的线程同时处理
+   */
+  template<typename Fun>
+  void for_each_in_chunk(size_t k, const Fun & f)
+  {
+    size_t end = std::min(this->size(), (k+1)*Base::ChunkSize);
+    for_each_in_range(*this, k*Base::ChunkSize, end, f);
+  }
+
+  /**
+   * @brief 对没有被释放的元素依次调用 f, f 返回 false 时停止
+   * @return 是否遍历了所有元素
+   * @note f 的返回值是 void 时不会停止
+   */
+  template<typename Fun>
+  bool for_each(const Fun & f) { return for_each_in_range(*this, 0, this->size(), f); }
+
+  template<typename Fun>
+  bool for_each(const Fun & f) const { return for_each_in_range(*this, 0, this->size(), f); }
+
+private:
+  /** 对 [begin, end) 中没有被释放的元素调用 f, Array 是 Self 或 const Self */
+  template<typename Array, typename Fun>
+  static bool for_each_in_range(Array & array, size_t begin, size_t end, const Fun & f)
+  {
+    for(size_t i = array.next_index(begin); i < end; i = array.next_index(i+1))
+    {
+      if constexpr (std::is_void_v<std::invoke_result_t<const Fun &, decltype(array[i])>>)
+        f(array[i]);
+      else if(!f(array[i]))
+        return false;
+    }
+    return true;
+  }
+
+  /** 从 index 开始第一个没有被释放的位置 */
+  size_t next_index(size_t index) const
+  {
+    if(!mark_)
+      return std::min(index, this->size());
+    return std::min(mark_->find_next_false(index), this->size());
+  }
+
 private:
   std::shared_ptr<MarkArray> mark_;
 };
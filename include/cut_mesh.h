@@ -11,6 +11,7 @@
 
 #include "irregular_array2d.h"
 #include "geometry_utils.h"
+#include "uniform_mesh.h"
 
 namespace HEM
 {
@@ -20,10 +21,10 @@ namespace HEM
  * @param Mesh : 网格类型, 该网格必须是 HalfEdgeMesh 的子类
  */
 template<typename Mesh>
-class CutMesh : public Mesh
+class CutMesh : public SubCellMesh<CutMesh<Mesh>, Mesh>
 {
 public:
-  using Base = Mesh;
+  using Base = SubCellMesh<CutMesh<Mesh>, Mesh>;
   using Cell = typename Mesh::Cell;
   using Edge = typename Mesh::Edge;
   using Node = typename Mesh::Node;
@@ -55,7 +56,7 @@ public:
 
 public:
   /** 单元是否在界面内部的标记， 0 表示在外部，1 表示在内部 */
-  std::shared_ptr<Array<uint8_t>> cellmarker; 
+  DataHandle<uint8_t> cellmarker; 
 
 
 private:
@@ -73,7 +74,15 @@ public:
   {
     update_cidx();
     eps_ = Base::cell_size()*1e-4;
-    cellmarker = this->template add_cell_data<uint8_t>("is_in_the_interface");
+    cellmarker = this->template add_cell_data_handle<uint8_t>("is_in_the_interface");
+  }
+
+  /** @brief 对 subcell_ 中的每个单元指针调用 f, 空的位置是空指针, 见 SubCellMesh */
+  template<typename F>
+  void for_each_subcell(const F & f)
+  {
+    for(auto & c : subcell_.get_data())
+      f(c);
   }
 
   /**
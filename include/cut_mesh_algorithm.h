@@ -5,10 +5,12 @@
 #include <vector>
 #include <algorithm>
 #include <memory>
-#include <iostream>
-#include <stack>
 #include <string>
 
+#include "uniform_mesh.h"
+#include "region_labeling.h"
+#include "cut_trace.h"
+
 namespace HEM
 {
 
@@ -16,10 +18,10 @@ namespace HEM
  * @brief 被切割的网格
  */
 template<typename Mesh>
-class CutMesh : public Mesh
+class CutMesh : public SubCellMesh<CutMesh<Mesh>, Mesh>
 {
 public:
-  using Base = Mesh;
+  using Base = SubCellMesh<CutMesh<Mesh>, Mesh>;
   using Cell = typename Mesh::Cell;
   using Edge = typename Mesh::Edge;
   using Node = typename Mesh::Node;
@@ -31,7 +33,11 @@ public:
   template<typename Data>
   using Array = typename Base::template Array<Data>;
 
-  std::shared_ptr<Array<uint8_t>> i3f;
+  /** 一个点周围的单元, 一般只有几个, 不需要分配内存 */
+  using CellList = SmallVector<Cell *, 8>;
+
+  /** 单元是否在界面内部的标记 */
+  DataHandle<uint8_t> i3f;
 
 public:
   template<typename... Args>
@@ -39,43 +45,88 @@ public:
   {
     update_cidx();
     eps_ = Base::cell_size()*1e-4;
-    i3f = this->template add_cell_data<uint8_t>("is_in_the_interface");
+    i3f = this->template add_cell_data_handle<uint8_t>("is_in_the_interface");
   }
 
+  Array<uint8_t> & is_in_the_interface() { return this->cell_data(i3f); }
+
+  /**
+   * @brief 由所有单元重新建立 subcell_, 只在构造和单元被删除之后需要,
+   *   切割时由 splite_cell 增量更新
+   */
   void update_cidx()
   {
-    uint32_t NC = Base::number_of_cells();
-    subcell_.resize(NC);
-
-    std::fill(cidx_.begin(), cidx_.end(), 0.0);
-    cidx_.resize(NC+1, 0);
-    auto & cell = *Base::get_cell();
-    for(auto & c : cell)
+    uint32_t NB = Base::number_of_blocks();
+    subcell_.clear();
+    subcell_.resize(NB);
+    for(auto & c : *Base::get_cell())
     {
       uint32_t idx = Base::find_point(c.barycenter());
-      cidx_[idx+1]++;
+      subcell_[idx].push_back(&c);
     }
+  }
 
-    for(uint32_t i = 1; i < NC+1; i++)
-      cidx_[i] += cidx_[i-1];
+  /** @brief subcell_ 中的单元指针个数, 与单元个数相同 */
+  uint32_t number_of_subcells() const
+  {
+    uint32_t n = 0;
+    for(auto & cs : subcell_)
+      n += cs.size();
+    return n;
+  }
 
-    std::vector<uint32_t> I(NC, 0);
-    for(auto & c : cell)
-    {
-      uint32_t idx = Base::find_point(c.barycenter());
-      subcell_[cidx_[idx]+I[idx]] = &c;
-      I[idx]++;
-    }
+  /**
+   * @brief 分割单元, 见 HalfEdgeMeshBase::splite_cell, 同时把新单元加入 subcell_
+   * @note 1. 新单元与 c0 在同一个块中, 只需要更新这一个块, 按存储位置插入,
+   *          所以 subcell_ 与 update_cidx 重新建立的相同。
+   *       2. 并发切割时不同线程的单元在不同的块中, 可以同时调用。
+   *          没有位置时返回空指针, 网格和 subcell_ 都不变。
+   */
+  Cell * splite_cell(Cell * c0, HalfEdge * h0, HalfEdge * h1)
+  {
+    Cell * c1 = Base::splite_cell(c0, h0, h1);
+    if(!c1)
+      return nullptr;
+    auto & cs = subcell_[Base::find_point(c1->barycenter())];
+    cs.insert(std::upper_bound(cs.begin(), cs.end(), c1, [](const Cell * a, const Cell * b)
+          { return a->index() < b->index(); }), c1);
+    return c1;
   }
 
-  Cell * find_point(Point & p, bool maybe_on_the_edge = true)
+  /**
+   * @brief 合并单元, 见 HalfEdgeMeshBase::merge_cell, 同时把新单元从 subcell_ 中删除
+   * @note 恢复新单元刚分割时的半边, 重心与加入 subcell_ 时的相同, 在同一个块中
+   */
+  void merge_cell(HalfEdge * nh1)
   {
+    Cell * c1 = nh1->cell();
+    c1->set_halfedge(nh1);
+    auto & cs = subcell_[Base::find_point(c1->barycenter())];
+    cs.erase(std::lower_bound(cs.begin(), cs.end(), c1, [](const Cell * a, const Cell * b)
+          { return a->index() < b->index(); }));
+    Base::merge_cell(nh1);
+  }
+
+  /**
+   * @brief 查找点所在的单元
+   * @param hint : 不为空时先从 hint 沿半边走到 p 附近, p 在到达的单元内部且与
+   *   边界的距离大于 2*eps_ 时直接返回这个单元, 否则在块中查找, 结果与没有 hint 时相同
+   */
+  Cell * find_point(Point & p, bool maybe_on_the_edge = true, Cell * hint = nullptr)
+  {
+    if(hint)
+    {
+      Cell * c = Base::walk_to_point(p, hint);
+      if(c && Base::is_strictly_inside(p, c, 2*eps_))
+        return c;
+    }
+
     HalfEdge * h = nullptr;
     uint32_t idx = Base::find_point(p);
     Cell * c = nullptr;
-    for(uint32_t i = cidx_[idx]; i < cidx_[idx+1]; i++)
+    for(Cell * sc : subcell_[idx])
     {
-      c = subcell_[i]; 
+      c = sc; 
       bool flag = is_on_the_polygon(p, c, h, maybe_on_the_edge);
       if(flag==1)
         break;
@@ -156,13 +207,26 @@ public:
    *   - 如果 p 在某个单元中，那么返回的 hp1 = nullptr。
    *   - 如果 p 在某个边上, 那么返回的 hp1 是 p 所在的半边。
    *   - 如果 p 和某个顶点重合，那么返回的 hp1 是指向与 p 重合的顶点的半边的。
+   * @param hint : 查找的起点, 见 find_point
    */
-  HalfEdge * get_cell_of_point(Point & p, std::vector<Cell * > & c1s);
+  HalfEdge * get_cell_of_point(Point & p, CellList & c1s, Cell * hint = nullptr);
+
+
+private:
+  friend Base;
 
+  /** @brief 对 subcell_ 中的每个单元指针调用 f, 见 SubCellMesh */
+  template<typename F>
+  void for_each_subcell(const F & f)
+  {
+    for(auto & cs : subcell_)
+      for(auto & c : cs)
+        f(c);
+  }
 
 private:
-  std::vector<Cell * > subcell_;
-  std::vector<uint32_t> cidx_;
+  /** 背景网格的每个块中的单元, 按存储位置排列 */
+  std::vector<std::vector<Cell *>> subcell_;
   double eps_;
 };
 
@@ -359,9 +423,9 @@ typename BaseMesh::HalfEdge * CutMesh<BaseMesh>::is_on_the_edge_of_cell(
  */
 template<typename BaseMesh>
 typename BaseMesh::HalfEdge * CutMesh<BaseMesh>::get_cell_of_point(
-    Point & p, std::vector<Cell * > & c1s)
+    Point & p, CellList & c1s, Cell * hint)
 {
-  Cell * c1 = find_point(p);
+  Cell * c1 = find_point(p, true, hint);
   HalfEdge * h = is_on_the_edge_of_cell(c1, p);
   if(!h) /**< 单元内部 */
     c1s.push_back(c1);
@@ -385,10 +449,28 @@ typename BaseMesh::HalfEdge * CutMesh<BaseMesh>::get_cell_of_point(
 }
 
 
+/**
+ * @brief 表示一个二维界面
+ */
+template<typename Point>
+struct CutInterface
+{
+  std::vector<bool> is_fixed_points;
+  std::vector<Point> points;
+  std::vector<uint32_t> segments;
+
+  bool is_loop_interface() 
+  {
+    return segments[0]==segments.back();
+  }
+};
+
 /**
  * @brief 一个使用界面直接 Cut 网格的算法
+ * @param Trace : 记录阶段耗时, 计数和警告的追踪类型, 见 cut_trace.h。
+ *   默认的 NullCutTrace 不做任何事, 追踪代码在编译时被去掉
  */
-template<typename BaseMesh>
+template<typename BaseMesh, typename Trace = NullCutTrace>
 class CutMeshAlgorithm
 {
 public:
@@ -401,24 +483,13 @@ public:
 
   using Point = typename BaseMesh::Point;
   using Vector = typename BaseMesh::Vector;
+  using CellList = typename Mesh::CellList;
 
   template<typename Data>
   using Array = typename BaseMesh::template Array<Data>;
 
-  /**
-   * @brief 表示一个二维界面
-   */
-  struct Interface
-  {
-    std::vector<bool> is_fixed_points;
-    std::vector<Point> points;
-    std::vector<uint32_t> segments;
-
-    bool is_loop_interface() 
-    {
-      return segments[0]==segments.back();
-    }
-  };
+  /** @brief 二维界面, 与追踪类型无关 */
+  using Interface = CutInterface<Point>;
 
 public:
 
@@ -437,25 +508,82 @@ public:
     mesh_ = mesh;
   }
 
-  void cut_by_loop_interface(Interface & interfaces);
+  /** @brief 设置追踪, 为 nullptr 时不记录 */
+  void set_trace(Trace * trace)
+  {
+    trace_ = trace;
+  }
+
+  /** @brief 用一个循环界面 cut 网格, 返回这次切割的统计 */
+  CutStats cut_by_loop_interface(Interface & interfaces);
 
   void cut_by_non_loop_interface(Interface & interfaces);
 
   /**
-   * @brief 多个界面 cut 网格
+   * @brief 多个界面 cut 网格, 内部单元是在任意一个界面内部的单元
+   * @param parallel : 为 true 时, 影响范围与其他界面都不相交的界面由多个线程
+   *   同时切割, 其余的界面之后串行切割, 见 _independent_interfaces
+   * @param region : 不为空时返回每个单元所在区域的编号, 嵌套的界面分出的每一层
+   *   都是不同的区域, 见 label_regions
+   * @return 这次切割的统计
+   */
+  CutStats cut_by_interfaces(std::vector<Interface> & interfaces, bool parallel = false, 
+      std::vector<uint32_t> * region = nullptr);
+
+  /** 
+   * @brief 并发切割时按估计的新增实体个数的 r 倍预留空间, 默认为 1,
+   *   r 较小时余量会在切割中用完, 见 cut_by_interfaces
+   */
+  void set_reserve_ratio(double r) { reserve_ratio_ = r; }
+
+  /** @brief 这个算法对象所有切割的累计统计 */
+  const CutStats & cumulative_stats() const { return stats_; }
+
+  void reset_cumulative_stats() { stats_ = CutStats(); }
+
+private:
+  /**
+   * @brief 界面可能修改的背景网格的块 [x0, x1] x [y0, y1], 
+   *   work 是切割时新增实体个数的估计
    */
-  void cut_by_interfaces(std::vector<Interface> & interfaces)
+  struct Footprint
   {
-    for(auto & iface : interfaces)
+    uint32_t x0, y0, x1, y1;
+    uint64_t work;
+
+    /** 两个范围之间至少隔着一个块时才是独立的 */
+    bool is_independent(const Footprint & other) const
     {
-      if(iface.is_loop_interface())
-        cut_by_loop_interface(iface);
-      else
-        cut_by_non_loop_interface(iface);
+      return x0 > other.x1+1 || other.x0 > x1+1 || y0 > other.y1+1 || other.y0 > y1+1;
     }
-  }
+  };
+
+  /**
+   * @brief 界面点所在的块向外扩一层, 切割会修改穿过的单元和与它们相邻的单元
+   */
+  Footprint _footprint(const Interface & interface);
+
+  /**
+   * @brief 把循环界面分为两类: independent 中的界面与其他任何界面的范围都不相交,
+   *   dependent 中的界面与某个界面的范围相交
+   */
+  void _independent_interfaces(std::vector<Interface> & interfaces, 
+      std::vector<Footprint> & footprints,
+      std::vector<uint32_t> & independent, std::vector<uint32_t> & dependent);
+
+  /**
+   * @brief 沿循环界面切割网格, 标记界面两侧的单元, 不处理内部单元和 subcell
+   * @return 并发模式下网格没有余量时停止切割并返回 false, 已经做的分割不撤销
+   */
+  bool _cut_along_loop_interface(Interface & interface);
+
+  /**
+   * @brief 并发模式下沿循环界面切割, 网格的余量用完时按相反的顺序撤销这个界面
+   *   已经做的分割, 恢复标记, 计数和界面, 并返回 false
+   * @note 撤销后网格与切割前的拓扑相同, 之后可以串行地重新切割
+   */
+  bool _try_cut_along_loop_interface(Interface & interface);
 
-private:
   /**
    * @brief 判断 segment [p0, p1] 与从 start 到 end 之间的哪条半边相交, 交点为 p。
    */
@@ -474,45 +602,147 @@ private:
    * @param p1 : segment 的终点。
    * @param can_be_splite : bool 值，表示当前单元是否可以被强行加密，因为如果 
    *   c0 中有固定点，那么及时入射点和出射点在同一个半边，那我们也可以加密这个单元
+   * @return 并发模式下网格没有余量时返回 false
    */
-  void _out_cell_1(Cell * c0, HalfEdge* & h0, HalfEdge* & h1, Point & p, 
+  bool _out_cell_1(Cell * c0, HalfEdge* & h0, HalfEdge* & h1, Point & p, 
       const Point & p0, const Point p1, 
-      bool can_be_splite=false, const std::vector<Cell *> * c1s=nullptr);
+      bool can_be_splite=false, const CellList * c1s=nullptr);
 
   /** 
-   * @brief 线段 [p0, p1] 与网格相交,  
+   * @brief 线段 [p0, p1] 与网格相交, 并发模式下网格没有余量时返回空指针
    */
   HalfEdge * _cut_by_segment(const Point & p0, const Point & p1, HalfEdge * h0, 
-      const std::vector<Cell *> & c1s);
+      const CellList & c1s);
 
   /**
-   * @brief 获取内部单元
+   * @brief 获取内部单元, 从各线程标记过的单元出发, 见 label_inner_cells;
+   *   需要区域编号时在整个网格上并行地标记连通分支, 见 label_regions
    */
-  void get_inner_cell(Array<uint8_t> & is_in_the_interface);
+  void get_inner_cell(Array<uint8_t> & is_in_the_interface, 
+      std::vector<uint32_t> * region = nullptr);
 
   /** 
    * @brief 找到循环界面的第一个点，这个点是一个边上的点或与网格节点重合的点，
-   *   如果没有就加一个。
+   *   如果没有就加一个。并发模式下网格没有余量时返回 uint32_t(-1)
    */
   uint32_t _find_first_point_in_loop_interface(Interface & interface, HalfEdge* & h0);
 
+  /** 
+   * @brief 分割单元并计数, 见 CutMesh::splite_cell, 需要时记下这次分割, 
+   *   并发模式下网格没有余量时返回 false
+   */
+  bool _splite_cell(Cell * c0, HalfEdge * h0, HalfEdge * h1)
+  {
+    Cell * c1 = mesh_->splite_cell(c0, h0, h1);
+    if(!c1)
+      return false;
+    _record(c1->halfedge(), true);
+    _count(CutCounter::SplitCell);
+    return true;
+  }
+
+  /** @brief 加密半边并计数, 见 HalfEdgeMeshBase::splite_halfedge, 同 _splite_cell */
+  bool _splite_halfedge(HalfEdge * h, const Point & p)
+  {
+    HalfEdge * h0 = mesh_->splite_halfedge(h, p);
+    if(!h0)
+      return false;
+    _record(h0, false);
+    _count(CutCounter::SplitHalfEdge);
+    return true;
+  }
+
+  /** @brief 当前线程在 _try_cut_along_loop_interface 中时记下一次分割 */
+  void _record(HalfEdge * h, bool is_cell)
+  {
+    auto & ts = thread_stats_[thread_id()];
+    if(ts.recording)
+      ts.splits.push_back({h, is_cell});
+  }
+
+  /** @brief 当前线程的统计, 并发切割时每个线程各写自己的统计 */
+  CutStats & _stats() { return thread_stats_[thread_id()].stats; }
+
+  /** 
+   * @brief 把界面一侧的单元 c 标记为 m (1 为内侧, 2 为外侧), 
+   *   并记到当前线程的列表中作为搜索内部单元的起点
+   */
+  void _mark_cell(Cell * c, uint8_t m)
+  {
+    mesh_->is_in_the_interface()[c->index()] = m;
+    thread_stats_[thread_id()].marked.push_back(c->index());
+  }
+
+  /** @brief 计时阶段 p, 到返回的对象析构为止 */
+  CutPhaseScope<Trace> _phase(CutPhase p) 
+  { 
+    return CutPhaseScope<Trace>(trace_, &_stats().time[uint32_t(p)], p); 
+  }
+
+  /** @brief 计数只写当前线程的统计, 撤销分割时可以恢复, 切割结束时写入追踪 */
+  void _count(CutCounter c, uint64_t n = 1)
+  {
+    _stats().count[uint32_t(c)] += n;
+  }
+
+  void _warning(CutWarning w, uint64_t value = 0)
+  {
+    if constexpr (Trace::enabled)
+    {
+      if(trace_)
+        trace_->warning(w, value);
+    }
+  }
+
+  /** @brief 切割开始时清空各线程的统计和标记过的单元, 记下网格的大小 */
+  void _begin_stats();
+
+  /** @brief 切割结束时合并各线程的统计, 累计到 stats_ 中, 并把计数写入追踪 */
+  CutStats _end_stats();
 
 private:
+  /** 
+   * @brief 一次分割, 撤销时使用: is_cell 为 true 时 h 是新单元的半边, 
+   *   见 HalfEdgeMeshBase::merge_cell, 否则 h 是加密得到的半边, 见 merge_halfedge
+   */
+  struct Split
+  {
+    HalfEdge * h;
+    bool is_cell;
+  };
+
+  /** 每个线程的统计占用不同的缓存行 */
+  struct alignas(64) ThreadStats
+  {
+    CutStats stats;
+    std::vector<uint32_t> marked; /**< 这个线程标记过的单元, 见 _mark_cell */
+    std::vector<Split> splits;    /**< 当前界面的分割, 见 _record */
+    bool recording = false;
+  };
+
   std::shared_ptr<Mesh> mesh_;
+  Trace * trace_ = nullptr;
+  double reserve_ratio_ = 1.0; /**< 见 set_reserve_ratio */
+
+  std::vector<ThreadStats> thread_stats_{1};
+  FrontierBuffer frontier_; /**< 标记内部单元的缓冲区, 见 label_inner_cells */
+  int64_t size0_[4] = {}; /**< 切割开始时的顶点, 边, 单元, 半边个数 */
+  CutStats stats_; /**< 累计的统计 */
 };
 
 /**
  * @brief 判断 segment [p0, p1] 与从 start 到 end 之间的哪条半边相交, 交点为 p。
  */
-template<typename BaseMesh>
-typename BaseMesh::HalfEdge * CutMeshAlgorithm<BaseMesh>::_out_cell_0(
+template<typename BaseMesh, typename Trace>
+typename BaseMesh::HalfEdge * CutMeshAlgorithm<BaseMesh, Trace>::_out_cell_0(
     HalfEdge * start, HalfEdge * end, const Point & p0, const Point & p1, Point & p)
 {
   uint32_t ii = 0; /**< 防止 start == end */
   double t = 2, tempt = 0.0;
   HalfEdge * h1 = nullptr;
   double l = (p1-p0).length();
-  for(HalfEdge * h = start; h != end || ii==0; h = h->next())
+  uint64_t NI = 0; /**< 计算交点的次数 */
+  for(HalfEdge * h = start; h != end || ii==0; h = h->next(), NI++)
   {
     auto & q0 = h->previous()->node()->coordinate();
     auto & q1 = h->node()->coordinate();
@@ -525,6 +755,8 @@ typename BaseMesh::HalfEdge * CutMeshAlgorithm<BaseMesh>::_out_cell_0(
     ii = 1;
   }
   p = p0*(1-t) + p1*t; /**< 获得 p */
+  _count(CutCounter::CellVisit);
+  _count(CutCounter::Intersection, NI);
   return h1;
 }
 
@@ -542,10 +774,10 @@ typename BaseMesh::HalfEdge * CutMeshAlgorithm<BaseMesh>::_out_cell_0(
  * @param can_be_splite : bool 值，表示当前单元是否可以被强行加密，因为如果 
  *   c0 中有固定点，那么及时入射点和出射点在同一个半边，那我们也可以加密这个单元
  */
-template<typename BaseMesh>
-void CutMeshAlgorithm<BaseMesh>::_out_cell_1(
+template<typename BaseMesh, typename Trace>
+bool CutMeshAlgorithm<BaseMesh, Trace>::_out_cell_1(
     Cell * c0, HalfEdge* & h0, HalfEdge* & h1, Point & p, 
-    const Point & p0, const Point p1, bool can_be_splite, const std::vector<Cell *> * c1s)
+    const Point & p0, const Point p1, bool can_be_splite, const CellList * c1s)
 {
   Vector v = p1 - p0;
   if(mesh_->is_same_point(p, h1->previous()->node()->coordinate()))
@@ -557,30 +789,35 @@ void CutMeshAlgorithm<BaseMesh>::_out_cell_1(
      * 2. 但是 can_be_splite 为 true 时可无视上一种情况。
      */
     p = h1->node()->coordinate();
+    _count(CutCounter::VertexHit);
     if(can_be_splite)
     {
-      mesh_->splite_cell(c0, h0, h1);
-      (*(mesh_->i3f))[h0->cell()->index()] = 1;
-      (*(mesh_->i3f))[h1->cell()->index()] = 2;
+      if(!_splite_cell(c0, h0, h1))
+        return false;
+      _mark_cell(h0->cell(), 1);
+      _mark_cell(h1->cell(), 2);
     }
     else if(h0)
     {
       uint8_t flag = mesh_->is_can_be_splite(h0, h1);
       if(flag==2)
       {
-        mesh_->splite_cell(c0, h0, h1);
-        (*(mesh_->i3f))[h0->cell()->index()] = 1;
-        (*(mesh_->i3f))[h1->cell()->index()] = 2;
+        if(!_splite_cell(c0, h0, h1))
+          return false;
+        _mark_cell(h0->cell(), 1);
+        _mark_cell(h1->cell(), 2);
       }
       else if(flag==1)
       {
-        (*(mesh_->i3f))[h0->cell()->index()] = 1;
-        (*(mesh_->i3f))[h1->opposite()->cell()->index()] = 2;
+        _mark_cell(h0->cell(), 1);
+        _mark_cell(h1->opposite()->cell(), 2);
+        _count(CutCounter::SmallCell);
       }
       else if(flag==0)
       {
-        (*(mesh_->i3f))[h0->opposite()->cell()->index()] = 1;
-        (*(mesh_->i3f))[h1->cell()->index()] = 2;
+        _mark_cell(h0->opposite()->cell(), 1);
+        _mark_cell(h1->cell(), 2);
+        _count(CutCounter::SmallCell);
       }
     }
     h0 = mesh_->find_cell_by_vector_on_node(h1->node(), v);
@@ -590,38 +827,48 @@ void CutMeshAlgorithm<BaseMesh>::_out_cell_1(
       const Point & p2 = h0->previous()->node()->coordinate();
       const Point & p3 = h0->next()->node()->coordinate();
       if(mesh_->is_collinear(p, p1, p2))
+      {
         h0 = h0->opposite()->previous();
+        _count(CutCounter::Collinear);
+      }
       else if(mesh_->is_collinear(p, p1, p3))
+      {
         h0 = h0->next()->opposite();
+        _count(CutCounter::Collinear);
+      }
     }
   }
   else /**< 没有交到顶点上 */
   {
-    mesh_->splite_halfedge(h1, p);
+    if(!_splite_halfedge(h1, p))
+      return false;
     h1 = h1->previous();
     if(h0)
     {
-      mesh_->splite_cell(c0, h0, h1);
-      (*(mesh_->i3f))[h0->cell()->index()] = 1;
-      (*(mesh_->i3f))[h1->cell()->index()] = 2;
+      if(!_splite_cell(c0, h0, h1))
+        return false;
+      _mark_cell(h0->cell(), 1);
+      _mark_cell(h1->cell(), 2);
     }
     h0 = h1->opposite()->previous();
   }
+  return true;
 }
 
 /** 
- * @brief 线段 [p0, p1] 与网格相交,  
+ * @brief 线段 [p0, p1] 与网格相交, 并发模式下网格没有余量时返回空指针
  */
-template<typename BaseMesh>
-typename BaseMesh::HalfEdge * CutMeshAlgorithm<BaseMesh>::_cut_by_segment(
-    const Point & p0, const Point & p1, HalfEdge * h0, const std::vector<Cell *> & c1s)
+template<typename BaseMesh, typename Trace>
+typename BaseMesh::HalfEdge * CutMeshAlgorithm<BaseMesh, Trace>::_cut_by_segment(
+    const Point & p0, const Point & p1, HalfEdge * h0, const CellList & c1s)
 {
   Point p = p0;
   Cell * c0 = h0->cell();
   while(std::find(c1s.begin(), c1s.end(), c0)==c1s.end())
   { 
     HalfEdge * h1 = _out_cell_0(h0->next()->next(), h0, p, p1, p);
-    _out_cell_1(c0, h0, h1, p, p0, p1, false, &c1s);
+    if(!_out_cell_1(c0, h0, h1, p, p0, p1, false, &c1s))
+      return nullptr;
     //_out_cell_1(c0, h0, h1, p, p0, p1, false);
     c0 = h0->cell();
     p = h0->node()->coordinate();
@@ -631,10 +878,10 @@ typename BaseMesh::HalfEdge * CutMeshAlgorithm<BaseMesh>::_cut_by_segment(
 
 /** 
  * @brief 找到循环界面的第一个点，这个点是一个边上的点或与网格节点重合的点，
- *   如果没有就加一个。
+ *   如果没有就加一个。并发模式下网格没有余量时返回 uint32_t(-1)
  */
-template<typename BaseMesh>
-uint32_t CutMeshAlgorithm<BaseMesh>::_find_first_point_in_loop_interface(
+template<typename BaseMesh, typename Trace>
+uint32_t CutMeshAlgorithm<BaseMesh, Trace>::_find_first_point_in_loop_interface(
     Interface & interface, HalfEdge* & h0)
 {
   auto & segments = interface.segments;
@@ -646,8 +893,8 @@ uint32_t CutMeshAlgorithm<BaseMesh>::_find_first_point_in_loop_interface(
   for(uint32_t i = 0; i < N; i++)
   {
     Point p = points[segments[i]];
-    std::vector<Cell * > cs;
-    HalfEdge * h = mesh_->get_cell_of_point(p, cs);
+    CellList cs;
+    HalfEdge * h = mesh_->get_cell_of_point(p, cs, c0);
     if(!h) /**< p 在单元内部 */
     {
       Cell * c = cs[0];
@@ -665,7 +912,8 @@ uint32_t CutMeshAlgorithm<BaseMesh>::_find_first_point_in_loop_interface(
       else
       {
         HalfEdge * h1 = _out_cell_0(c0->halfedge(), c0->halfedge(), p0, p, p0);
-        _out_cell_1(c0, h0, h1, p0, p0, p);
+        if(!_out_cell_1(c0, h0, h1, p0, p0, p))
+          return uint32_t(-1);
         segments.push_back(points.size());
         points.push_back(h0->node()->coordinate());
         return i;
@@ -681,7 +929,8 @@ uint32_t CutMeshAlgorithm<BaseMesh>::_find_first_point_in_loop_interface(
           h = h->previous();
         else if(!mesh_->is_same_point(q1, p))
         {
-          mesh_->splite_halfedge(h, p);
+          if(!_splite_halfedge(h, p))
+            return uint32_t(-1);
           h = h->previous();
         }
 
@@ -693,7 +942,8 @@ uint32_t CutMeshAlgorithm<BaseMesh>::_find_first_point_in_loop_interface(
       else
       {
         HalfEdge * h1 = _out_cell_0(c0->halfedge(), c0->halfedge(), p0, p, p0);
-        _out_cell_1(c0, h0, h1, p0, p0, p);
+        if(!_out_cell_1(c0, h0, h1, p0, p0, p))
+          return uint32_t(-1);
         segments.push_back(points.size());
         points.push_back(h0->node()->coordinate());
         return i;
@@ -703,57 +953,308 @@ uint32_t CutMeshAlgorithm<BaseMesh>::_find_first_point_in_loop_interface(
   return 0;
 }
 
-template<typename BaseMesh>
-void CutMeshAlgorithm<BaseMesh>::get_inner_cell(Array<uint8_t> & is_in_the_interface)
+template<typename BaseMesh, typename Trace>
+void CutMeshAlgorithm<BaseMesh, Trace>::get_inner_cell(Array<uint8_t> & is_in_the_interface, 
+    std::vector<uint32_t> * region)
+{
+  if(region)
+  {
+    label_regions(*mesh_, is_in_the_interface, *region);
+    return;
+  }
+  auto & seeds = thread_stats_[0].marked;
+  for(uint32_t t = 1; t < thread_stats_.size(); t++)
+    seeds.insert(seeds.end(), thread_stats_[t].marked.begin(), thread_stats_[t].marked.end());
+  label_inner_cells(*mesh_, is_in_the_interface, seeds, frontier_);
+}
+
+template<typename BaseMesh, typename Trace>
+CutStats CutMeshAlgorithm<BaseMesh, Trace>::cut_by_loop_interface(Interface & interface)
+{
+  _begin_stats();
+  {
+    auto total = _phase(CutPhase::Total);
+
+    /** 设置单元状态为在界面外部 */
+    auto & is_in_the_interface = mesh_->is_in_the_interface();
+    is_in_the_interface.set_value(0);
+
+    {
+      auto phase = _phase(CutPhase::Serial);
+      _cut_along_loop_interface(interface);
+    }
+    auto phase = _phase(CutPhase::InnerCells);
+    get_inner_cell(is_in_the_interface);
+  }
+  return _end_stats();
+}
+
+template<typename BaseMesh, typename Trace>
+void CutMeshAlgorithm<BaseMesh, Trace>::_begin_stats()
 {
-  /** 处理内部单元标记 */
-  std::stack<typename Mesh::Cell*> inner_cell;
-  auto & cell = *(mesh_->get_cell());
-  for(auto & c : cell)
+  /** 保留各线程列表的容量, 重复切割时不需要分配内存 */
+  thread_stats_.resize(number_of_threads());
+  for(auto & ts : thread_stats_)
   {
-    if(is_in_the_interface[c.index()]==1)
-      inner_cell.push(&c);
+    ts.stats = CutStats();
+    ts.marked.clear();
+  }
+  size0_[0] = mesh_->number_of_nodes();
+  size0_[1] = mesh_->number_of_edges();
+  size0_[2] = mesh_->number_of_cells();
+  size0_[3] = mesh_->number_of_halfedges();
+}
+
+template<typename BaseMesh, typename Trace>
+CutStats CutMeshAlgorithm<BaseMesh, Trace>::_end_stats()
+{
+  CutStats s;
+  for(auto & ts : thread_stats_)
+    s += ts.stats;
+  s.added[0] = int64_t(mesh_->number_of_nodes()) - size0_[0];
+  s.added[1] = int64_t(mesh_->number_of_edges()) - size0_[1];
+  s.added[2] = int64_t(mesh_->number_of_cells()) - size0_[2];
+  s.added[3] = int64_t(mesh_->number_of_halfedges()) - size0_[3];
+  s.cuts = 1;
+  stats_ += s;
+
+  if constexpr (Trace::enabled)
+  {
+    if(trace_)
+    {
+      for(uint32_t c = 0; c < uint32_t(CutCounter::Count); c++)
+        trace_->count(CutCounter(c), s.count[c]);
+      trace_->commit_counts();
+    }
   }
-  while(!inner_cell.empty())
+  return s;
+}
+
+template<typename BaseMesh, typename Trace>
+typename CutMeshAlgorithm<BaseMesh, Trace>::Footprint 
+CutMeshAlgorithm<BaseMesh, Trace>::_footprint(const Interface & interface)
+{
+  const auto & param = mesh_->parameter();
+  const auto & points = interface.points;
+  const auto & segments = interface.segments;
+
+  Footprint fp{uint32_t(-1), uint32_t(-1), 0, 0, segments.size()};
+  for(uint32_t i = 0; i < segments.size(); i++)
   {
-    typename Mesh::Cell * c = inner_cell.top();
-    inner_cell.pop();
-    Cell * cell2cell[32];
-    uint32_t N = c->adj_cell(cell2cell);
-    for(uint8_t i = 0; i < N; i++)
+    const Point & p = points[segments[i]];
+    uint32_t idx = mesh_->BaseMesh::find_point(p);
+    uint32_t x = idx/param.ny, y = idx%param.ny;
+    fp.x0 = std::min(fp.x0, x); fp.x1 = std::max(fp.x1, x);
+    fp.y0 = std::min(fp.y0, y); fp.y1 = std::max(fp.y1, y);
+
+    /** 线段穿过的块的个数 */
+    if(i > 0)
     {
-      typename Mesh::Cell * ci = cell2cell[i];
-      if(is_in_the_interface[ci->index()]==0)
+      Vector v = p - points[segments[i-1]];
+      fp.work += std::abs(v.x)/param.hx + std::abs(v.y)/param.hy + 1;
+    }
+  }
+  fp.x0 = fp.x0 > 0 ? fp.x0-1 : 0; fp.x1 = std::min(fp.x1+1, param.nx-1);
+  fp.y0 = fp.y0 > 0 ? fp.y0-1 : 0; fp.y1 = std::min(fp.y1+1, param.ny-1);
+  return fp;
+}
+
+template<typename BaseMesh, typename Trace>
+void CutMeshAlgorithm<BaseMesh, Trace>::_independent_interfaces(
+    std::vector<Interface> & interfaces, std::vector<Footprint> & footprints,
+    std::vector<uint32_t> & independent, std::vector<uint32_t> & dependent)
+{
+  uint32_t N = interfaces.size();
+  std::vector<uint32_t> loop;
+  for(uint32_t i = 0; i < N; i++)
+  {
+    if(interfaces[i].is_loop_interface())
+      loop.push_back(i);
+  }
+
+  footprints.resize(N);
+  #pragma omp parallel for
+  for(uint32_t k = 0; k < loop.size(); k++)
+    footprints[loop[k]] = _footprint(interfaces[loop[k]]);
+
+  /** 按 x0 排序后扫描, 只需要比较 x 方向上可能相交的界面 */
+  std::sort(loop.begin(), loop.end(), [&footprints](uint32_t a, uint32_t b) 
+      { return footprints[a].x0 < footprints[b].x0; });
+  std::vector<uint8_t> is_dependent(N, 0);
+  for(uint32_t k = 0; k < loop.size(); k++)
+  {
+    const Footprint & a = footprints[loop[k]];
+    for(uint32_t l = k+1; l < loop.size() && footprints[loop[l]].x0 <= a.x1+1; l++)
+    {
+      if(!a.is_independent(footprints[loop[l]]))
+        is_dependent[loop[k]] = is_dependent[loop[l]] = 1;
+    }
+  }
+
+  for(uint32_t i = 0; i < N; i++)
+  {
+    if(!interfaces[i].is_loop_interface())
+      continue;
+    if(is_dependent[i])
+      dependent.push_back(i);
+    else
+      independent.push_back(i);
+  }
+}
+
+template<typename BaseMesh, typename Trace>
+CutStats CutMeshAlgorithm<BaseMesh, Trace>::cut_by_interfaces(
+    std::vector<Interface> & interfaces, bool parallel, std::vector<uint32_t> * region)
+{
+  _begin_stats();
+  {
+    auto total = _phase(CutPhase::Total);
+
+    auto & is_in_the_interface = mesh_->is_in_the_interface();
+    is_in_the_interface.set_value(0);
+
+    std::vector<Footprint> footprints;
+    std::vector<uint32_t> independent, dependent;
+    if(parallel)
+    {
+      auto phase = _phase(CutPhase::Partition);
+      _independent_interfaces(interfaces, footprints, independent, dependent);
+    }
+    else
+    {
+      for(uint32_t i = 0; i < interfaces.size(); i++)
       {
-        inner_cell.push(ci);
-        is_in_the_interface[ci->index()]=1;
+        if(interfaces[i].is_loop_interface())
+          dependent.push_back(i);
       }
     }
+
+    if(!independent.empty())
+    {
+      auto phase = _phase(CutPhase::Parallel);
+
+      /** 
+       * 预留空间, 并发切割时不需要再分配块。每个界面点和每次穿过单元的边最多
+       * 加密一条半边并分割一个单元, 即新增 1 个顶点, 2 条边, 1 个单元, 4 条半边。
+       */
+      uint64_t W = 0;
+      for(uint32_t i : independent)
+        W += footprints[i].work;
+      W = uint64_t(W*reserve_ratio_);
+      mesh_->reserve(mesh_->get_node()->size() + W, mesh_->get_edge()->size() + 2*W, 
+          mesh_->get_cell()->size() + W, mesh_->get_halfedge()->size() + 4*W);
+
+      mesh_->set_concurrent(true, W, 2*W, W, 4*W);
+
+      /** 
+       * 添加的实体超过预计时不再开始新的界面, 正在切割的界面用预留的余量完成,
+       * 余量也用完时撤销。没有开始和撤销的界面之后串行切割
+       */
+      std::vector<uint8_t> skipped(independent.size(), 0);
+      #pragma omp parallel for schedule(dynamic, 1)
+      for(uint32_t k = 0; k < independent.size(); k++)
+      {
+        if(mesh_->is_concurrent_overflowed())
+          skipped[k] = 1;
+        else
+          skipped[k] = !_try_cut_along_loop_interface(interfaces[independent[k]]);
+      }
+      mesh_->set_concurrent(false);
+
+      uint32_t ND = dependent.size();
+      for(uint32_t k = 0; k < independent.size(); k++)
+      {
+        if(skipped[k])
+          dependent.push_back(independent[k]);
+      }
+      if(dependent.size() > ND)
+      {
+        _warning(CutWarning::ConcurrentOverflow, dependent.size()-ND);
+        std::sort(dependent.begin(), dependent.end());
+      }
+    }
+
+    {
+      auto phase = _phase(CutPhase::Serial);
+      for(uint32_t i : dependent)
+        _cut_along_loop_interface(interfaces[i]);
+
+      for(auto & iface : interfaces)
+      {
+        if(!iface.is_loop_interface())
+          cut_by_non_loop_interface(iface);
+      }
+    }
+
+    auto phase = _phase(CutPhase::InnerCells);
+    get_inner_cell(is_in_the_interface, region);
   }
-  for(auto & c : cell)
-    is_in_the_interface[c.index()] = is_in_the_interface[c.index()]==1;
+  return _end_stats();
 }
 
-template<typename BaseMesh>
-void CutMeshAlgorithm<BaseMesh>::cut_by_loop_interface(Interface & interface)
+template<typename BaseMesh, typename Trace>
+bool CutMeshAlgorithm<BaseMesh, Trace>::_try_cut_along_loop_interface(Interface & interface)
 {
-  std::cout << "cuting..." << std::endl;
-
-  /** 设置单元状态为在界面外部 */
-  auto & is_in_the_interface = *(mesh_->i3f);
-  for(auto & t : is_in_the_interface)
-    t = 0;
+  /** 切割会去掉最后一个段再添加点和段 */
+  auto & points = interface.points;
+  auto & segments = interface.segments;
+  uint32_t NP = points.size(), NS = segments.size(), last = segments.back();
+
+  auto & ts = thread_stats_[thread_id()];
+  size_t NM = ts.marked.size();
+  CutStats stats = ts.stats;
+  ts.splits.clear();
+  ts.recording = true;
+  bool ok = _cut_along_loop_interface(interface);
+  ts.recording = false;
+  if(ok)
+    return true;
+
+  /** 后面的分割可能修改了前面分割得到的实体, 所以按相反的顺序撤销 */
+  for(auto it = ts.splits.rbegin(); it != ts.splits.rend(); ++it)
+  {
+    if(it->is_cell)
+      mesh_->merge_cell(it->h);
+    else
+      mesh_->merge_halfedge(it->h);
+  }
+  auto & is_in_the_interface = mesh_->is_in_the_interface();
+  for(size_t i = NM; i < ts.marked.size(); i++)
+    is_in_the_interface[ts.marked[i]] = 0;
+  ts.marked.resize(NM);
+  std::copy(stats.count, stats.count+uint32_t(CutCounter::Count), ts.stats.count);
+  _warning(CutWarning::ConcurrentRollback, ts.splits.size());
+
+  points.resize(NP);
+  segments.resize(NS);
+  segments.back() = last;
+  return false;
+}
 
+template<typename BaseMesh, typename Trace>
+bool CutMeshAlgorithm<BaseMesh, Trace>::_cut_along_loop_interface(Interface & interface)
+{
   auto & points = interface.points;
   auto & segments = interface.segments;
   auto & is_fixed_points = interface.is_fixed_points;
   segments.pop_back();
 
   HalfEdge * h0 = nullptr;
-  std::vector<Point> fpc, fpn;
+  SmallVector<Point, 8> fpc, fpn; /**< 当前单元和下一个单元中的固定点 */
 
   /** 获取第一个点的信息 */
-  uint32_t start = _find_first_point_in_loop_interface(interface, h0);
+  uint32_t start = 0;
+  {
+    auto phase = _phase(CutPhase::FirstPoint);
+    start = _find_first_point_in_loop_interface(interface, h0);
+  }
+  if(start == uint32_t(-1))
+    return false;
+  if(!h0) /**< 所有的点都在同一个单元内部 */
+  {
+    _warning(CutWarning::NoStartPoint, points.size());
+    return true;
+  }
 
   Cell * c0 = h0->cell();
   Point p0 = h0->node()->coordinate();
@@ -761,9 +1262,10 @@ void CutMeshAlgorithm<BaseMesh>::cut_by_loop_interface(Interface & interface)
   uint32_t N = segments.size();
   for(uint32_t i = start; i < N; i++)
   {
+    _count(CutCounter::Segment);
     Point p1 = points[segments[i]];
-    std::vector<Cell * > c1s;
-    HalfEdge * hp1 = mesh_->get_cell_of_point(p1, c1s);
+    CellList c1s;
+    HalfEdge * hp1 = mesh_->get_cell_of_point(p1, c1s, c0);
     if(!hp1) /**< p1 在单元内部 */
     {
       /** p1 和 p0 同一个单元 */
@@ -782,12 +1284,18 @@ void CutMeshAlgorithm<BaseMesh>::cut_by_loop_interface(Interface & interface)
         /** 转折 */
         Point p;
         HalfEdge * h1 = _out_cell_0(c0->halfedge(), c0->halfedge(), p0, p1, p);
-        _out_cell_1(c0, h0, h1, p, p0, p1, !fpc.empty(), &c1s);
+        if(!_out_cell_1(c0, h0, h1, p, p0, p1, !fpc.empty(), &c1s))
+          return false;
         for(auto & p : fpc)
-          mesh_->splite_halfedge(h1->next(), p);
+        {
+          if(!_splite_halfedge(h1->next(), p))
+            return false;
+        }
         fpc.clear();
         /** 连线 */
         h0 = _cut_by_segment(h0->node()->coordinate(), p1, h0, c1s);
+        if(!h0)
+          return false;
       }
     }
     else /**< p1 在边上或者点上 */
@@ -798,12 +1306,18 @@ void CutMeshAlgorithm<BaseMesh>::cut_by_loop_interface(Interface & interface)
         /** 转折 */
         Point p;
         HalfEdge * h1 = _out_cell_0(c0->halfedge(), c0->halfedge(), p0, p1, p);
-        _out_cell_1(c0, h0, h1, p, p0, p1, !fpc.empty(), &c1s);
+        if(!_out_cell_1(c0, h0, h1, p, p0, p1, !fpc.empty(), &c1s))
+          return false;
         for(auto & p : fpc)
-          mesh_->splite_halfedge(h1->next(), p);
+        {
+          if(!_splite_halfedge(h1->next(), p))
+            return false;
+        }
         fpc.clear();
         /** 连线 */
         h0 = _cut_by_segment(h0->node()->coordinate(), p1, h0, c1s);
+        if(!h0)
+          return false;
         c0 = h0->cell();
       }
 
@@ -821,38 +1335,46 @@ void CutMeshAlgorithm<BaseMesh>::cut_by_loop_interface(Interface & interface)
       auto q0 = hp1->previous()->node()->coordinate();
       if(!mesh_->is_same_point(q0, p1) && !mesh_->is_same_point(q1, p1))
       {
-        mesh_->splite_halfedge(hp1, p1);
+        if(!_splite_halfedge(hp1, p1))
+          return false;
         hp1 = hp1->previous();
       }
 
       if(!fpc.empty())
       {
-        mesh_->splite_cell(c0, h0, hp1);
-        (*(mesh_->i3f))[h0->cell()->index()] = 1;
-        (*(mesh_->i3f))[hp1->cell()->index()] = 2;
+        if(!_splite_cell(c0, h0, hp1))
+          return false;
+        _mark_cell(h0->cell(), 1);
+        _mark_cell(hp1->cell(), 2);
       }
       else if(h0 != hp1)
       {
         uint8_t flag = mesh_->is_can_be_splite(h0, hp1);
         if(flag==2)
         {
-          mesh_->splite_cell(c0, h0, hp1);
-          (*(mesh_->i3f))[h0->cell()->index()] = 1;
-          (*(mesh_->i3f))[hp1->cell()->index()] = 2;
+          if(!_splite_cell(c0, h0, hp1))
+            return false;
+          _mark_cell(h0->cell(), 1);
+          _mark_cell(hp1->cell(), 2);
         }
         else if(flag==1)
         {
-          (*(mesh_->i3f))[h0->cell()->index()] = 2;
-          (*(mesh_->i3f))[hp1->opposite()->cell()->index()] = 1;
+          _mark_cell(h0->cell(), 2);
+          _mark_cell(hp1->opposite()->cell(), 1);
+          _count(CutCounter::SmallCell);
         }
         else if(flag==0)
         {
-          (*(mesh_->i3f))[h0->opposite()->cell()->index()] = 1;
-          (*(mesh_->i3f))[hp1->cell()->index()] = 2;
+          _mark_cell(h0->opposite()->cell(), 1);
+          _mark_cell(hp1->cell(), 2);
+          _count(CutCounter::SmallCell);
         }
       }
       for(auto & p : fpc)
-        mesh_->splite_halfedge(hp1->next(), p);
+      {
+        if(!_splite_halfedge(hp1->next(), p))
+          return false;
+      }
 
       if(i<N-1)
       {
@@ -863,14 +1385,14 @@ void CutMeshAlgorithm<BaseMesh>::cut_by_loop_interface(Interface & interface)
     }
     c0 = h0->cell(); p0 = p1; fpc = fpn; fpn.clear();
   }
-  get_inner_cell(is_in_the_interface);
-  mesh_->update_cidx();
+  return true;
 }
 
-template<typename BaseMesh>
-void CutMeshAlgorithm<BaseMesh>::cut_by_non_loop_interface(Interface & )
+template<typename BaseMesh, typename Trace>
+void CutMeshAlgorithm<BaseMesh, Trace>::cut_by_non_loop_interface(Interface & interface)
 {
   //TODO
+  _warning(CutWarning::NonLoopIgnored, interface.points.size());
 }
 
 }
@@ -2,16 +2,16 @@
 #define _CUT_MESH_ALGORITHM_
 
 #include <array>
-#include <deque>
-#include <queue>
-#include <stack>
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <memory>
-#include <unordered_set>
+#include <limits>
 #include <assert.h>
 
 #include "interface.h"
+#include "region_labeling.h"
+#include "cut_trace.h"
 
 namespace HEM
 {
@@ -62,31 +62,39 @@ public:
    */
   CutMeshAlgorithm(std::shared_ptr<Mesh> mesh): mesh_(mesh) 
   {
-    is_in_cell_ = mesh_->template add_cell_data<uint8_t>("is_in_the_interface");
+    is_in_cell_ = mesh_->template add_cell_data_handle<uint8_t>("is_in_the_interface");
   }
 
   void set_mesh(std::shared_ptr<Mesh> mesh)
   {
     mesh_ = mesh;
-    is_in_cell_ = mesh_->template add_cell_data<uint8_t>("is_in_the_interface");
+    is_in_cell_ = mesh_->template add_cell_data_handle<uint8_t>("is_in_the_interface");
   }
 
-  void cut_by_loop_interface(Interface & interfaces);
+  /**
+   * @brief 用一个循环界面 cut 网格, 返回这次切割的统计, 见 cut_trace.h
+   * @note 只统计 Serial (求交点和连接), InnerCells 和 Total 的耗时, 
+   *   Segment 和 Intersection 的次数, 以及新增的实体; 每次加密半边新增一个顶点, 
+   *   每次分割单元新增一个单元, 所以 SplitHalfEdge 和 SplitCell 由新增的实体得到
+   */
+  CutStats cut_by_loop_interface(Interface & interfaces);
 
   void cut_by_non_loop_interface(Interface & interfaces);
 
   /**
-   * @brief 多个界面 cut 网格
+   * @brief 多个界面 cut 网格, 返回所有循环界面的切割的统计之和
    */
-  void cut_by_interfaces(std::vector<Interface> & interfaces)
+  CutStats cut_by_interfaces(std::vector<Interface> & interfaces)
   {
+    CutStats stats;
     for(auto & iface : interfaces)
     {
       if(iface.is_loop_interface())
-        cut_by_loop_interface(iface);
+        stats += cut_by_loop_interface(iface);
       else
         cut_by_non_loop_interface(iface);
     }
+    return stats;
   }
 
   /**
@@ -106,7 +114,7 @@ private:
    * @param iface: 界面
    * @param corners: 返回角点列表
    */
-  std::deque<std::array<uint32_t, 3> > _find_corners_of_same_cell(Interface & iface);
+  void _find_corners_of_same_cell(Interface & iface, std::vector<std::array<uint32_t, 3> > & corners);
 
   /**
    * @brief 找到 a，b 连接线所在的单元, 要求 a 和 b 都在顶点上，而且不在同一条边上
@@ -133,25 +141,70 @@ private:
   HalfEdge * _find_halfedge_of_intersection(Intersection & a);
 
   /**
-   * @brief 获取内部单元
+   * @brief 角点的连接线所在的单元
+   * @param c: 角点的界面点所在的单元, 界面多次经过这个单元时, 它可能已经被前面的
+   *           角点分割, 不再包含 a 和 b, 这时在 a 周围找朝向 b 的单元
+   */
+  Cell * _find_corner_cell(Cell * c, Intersection & a, Intersection & b)
+  {
+    bool has_a = false, has_b = false;
+    for(auto & h : c->adj_halfedges())
+    {
+      has_a = has_a || h.node() == a.h->node();
+      has_b = has_b || h.node() == b.h->node();
+    }
+    return has_a && has_b ? c : _find_link_cell(a, b);
+  }
+
+  /** @brief 标记界面内侧的单元 in 和外侧的单元 out, 并记下它们作为搜索内部单元的起点 */
+  void _mark_cells(Array<uint8_t> & is_in_cell, Cell * in, Cell * out)
+  {
+    is_in_cell[out->index()] = 2;
+    is_in_cell[in->index()] = 1;
+    marked_cells_.push_back(in->index());
+    marked_cells_.push_back(out->index());
+  }
+
+  /**
+   * @brief 从标记过的单元出发获取内部单元, 见 label_inner_cells
    */
   void _get_inner_cell(Array<uint8_t> & is_in_the_interface);
 
 private:
   std::shared_ptr<Mesh> mesh_;
-  std::shared_ptr<Array<uint8_t>> is_in_cell_;
+  DataHandle<uint8_t> is_in_cell_;
+
+  /** 
+   * 切割时重复使用的缓冲区, 只增不减, 所以切割过一个界面之后,
+   * 再切割同样大小的界面时不需要分配内存 
+   */
+  std::vector<Cell *> walk_cells_[3]; /**< find_intersections_of_segment 中沿 segment 行走时的单元集合 */
+  std::vector<Intersection> segment_; /**< 一个 segment 的交点 */
+  std::vector<Intersection> intersections_; /**< 所有交点列表连续存放 */
+  std::vector<uint32_t> offsets_; /**< 第 k 个交点列表是 intersections_ 的 [offsets_[k], offsets_[k+1]) */
+  std::vector<std::array<uint32_t, 3> > corners_; /**< 界面的角点 */
+  std::vector<uint32_t> marked_cells_; /**< 界面两侧的单元, label_inner_cells 的起点 */
+  FrontierBuffer frontier_; /**< label_inner_cells 的缓冲区 */
 };
 
 /**
  * @brief 计算一个 segment 和网格的交点，算法流程：
- *     1. 从起点和终点所在的单元开始，将所有的边插入到一个队列中
- *     2. 从队列中取出一个边，计算它和 segment 的交点，如果有交点，将交点插入到交点列表中
- *     3. 将边的相邻单元插入到队列中
- *     4. 重复 2-3 步骤，直到队列为空
+ *     1. 从起点所在的单元开始，计算单元的边和 segment 的交点
+ *     2. 在这些交点中取离起点最远的一个作为出口:
+ *        出口在边的内部时, 下一步是边另一侧的单元;
+ *        出口在顶点上时, 下一步是这个顶点周围其它的单元
+ *     3. 重复 1-2 步骤，直到没有更远的交点, 最后检查终点所在的单元
+ *     4. 每个交点按到起点的距离插入列表, 重复的交点不插入, 终点最后插入
  *
  * @param p0: 起点
  * @param p1: 终点
  * @param intersections: 交点列表
+ * @note 1. 只经过 segment 穿过的单元, 工作量与穿过的单元个数成正比,
+ *          单元的集合使用成员中的缓冲区, 不为每个 segment 分配内存。
+ *       2. 交点按经过的顺序产生, 只有同一个单元的入口和出口可能颠倒,
+ *          所以从列表的末尾向前找插入的位置, 几乎都是直接放在末尾, 不再排序。
+ *       3. 每条边按它的第一条半边的方向计算交点, 两侧的单元得到相同的交点,
+ *          所以重复的交点可以直接比较坐标去掉。
  */
 template<typename Mesh>
 void CutMeshAlgorithm<Mesh>::find_intersections_of_segment(InterfacePoint & ip0, 
@@ -164,86 +217,132 @@ void CutMeshAlgorithm<Mesh>::find_intersections_of_segment(InterfacePoint & ip0,
   auto & p0 = ip0.point;
   auto & p1 = ip1.point;
   auto & geometry_utils = mesh_->geometry_utils();
+  const Vector d = p1 - p0;
 
-  std::unordered_set<Edge *> edge_traversed;/** 已经遍历过的边 */
-  std::queue<Edge *> edges;       /** 待遍历的边 */
-
-  /** 插入一个单元的所有边 */
-  auto insert_cell = [&edges, &edge_traversed](Cell * c)
+  /** 按到起点的距离 s 插入交点, 与已有的交点重合时不插入 */
+  auto insert = [&](const Intersection & ins, double s)
   {
-    auto c2e = c->adj_edges();
-    for(Edge & e : c2e)
+    auto it = intersections.end();
+    for(; it != intersections.begin(); --it)
     {
-      if(edge_traversed.find(&e) == edge_traversed.end())
-      {
-        edges.push(&e);
-        edge_traversed.insert(&e);
-      }
+      if((std::prev(it)->point - p0).dot(d) < s)
+        break;
+      if(*std::prev(it) == ins)
+        return;
     }
+    intersections.insert(it, ins);
   };
 
-  for(auto & c : ip0.cells)
-    insert_cell(c);
-
-  for(auto & c : ip1.cells)
-    insert_cell(c);
-
   if (ip0.type != 2)
     intersections.push_back(Intersection(p0, ip0.h, ip0.type));
 
-  if (ip1.type != 2)
-    intersections.push_back(Intersection(p1, ip1.h, ip1.type));
-
-  Cell  * c[2];
-  Point * p[2];
-  HalfEdge * h[2];
-  while(!edges.empty())
+  auto & cur  = walk_cells_[0]; /**< 当前检查的单元 */
+  auto & next = walk_cells_[1]; /**< 下一步检查的单元 */
+  auto & prev = walk_cells_[2]; /**< 上一步检查过的单元, 与它们共有的边不再计算 */
+  auto in = [](const std::vector<Cell *> & cs, const Cell * c)
   {
-    Edge * e = edges.front();
-    edges.pop();
-    e->vertices(p);   
-    e->adj_cell(c);
+    return std::find(cs.begin(), cs.end(), c) != cs.end();
+  };
 
-    h[0] = e->halfedge();
-    h[1] = h[0]->previous();
+  /** 出口: 在边 hc 的内部, 或者在顶点 node 上 */
+  double s_out = -std::numeric_limits<double>::infinity();
+  HalfEdge * exit_h = nullptr;
+  Node * exit_node = nullptr;
 
-    Point ip; /**< 交点 */
-    uint8_t flag = geometry_utils.relative_position_of_two_segments(p0, p1, *(p[0]), *(p[1]), ip);
-    if (flag == 0) /**< 两条线段重合 */
-    {
-      intersections.push_back(Intersection(*(p[0]), h[1], 0));
-      intersections.push_back(Intersection(*(p[1]), h[0], 0));
-    }
-    else if(flag == 1) /** 交于 e 的起点 */
-    {
-      intersections.push_back(Intersection(ip, h[1], 0));
-    }
-    else if(flag == 2) /** 交于 e 的终点 */
-    {
-      intersections.push_back(Intersection(ip, h[0], 0));
-    }
-    else if(flag == 3) /** 交于 e 的内部 */
+  /** 计算 c 的边与 segment 的交点, 并更新出口 */
+  auto intersect_cell = [&](Cell * c)
+  {
+    for(HalfEdge & hc : c->adj_halfedges())
     {
-      intersections.push_back(Intersection(ip, h[0], 1));
+      if(hc.opposite() != &hc && in(prev, hc.opposite()->cell()))
+        continue;
+
+      Edge * e = hc.edge();
+      HalfEdge * h[2];
+      Point * p[2];
+      e->vertices(p);
+      h[0] = e->halfedge();
+      h[1] = h[0]->previous();
+
+      auto push = [&](const Point & ip, HalfEdge * ih, uint8_t type)
+      {
+        double s = (ip - p0).dot(d);
+        insert(Intersection(ip, ih, type), s);
+        if(s > s_out)
+        {
+          s_out = s;
+          exit_h = type == 1 ? &hc : nullptr;
+          exit_node = type == 1 ? nullptr : ih->node();
+        }
+      };
+
+      Point ip; /**< 交点 */
+      uint8_t flag = geometry_utils.relative_position_of_two_segments(p0, p1, *(p[0]), *(p[1]), ip);
+      if (flag == 0) /**< 两条线段重合 */
+      {
+        push(*(p[0]), h[1], 0);
+        push(*(p[1]), h[0], 0);
+      }
+      else if(flag == 1) /** 交于 e 的起点 */
+        push(ip, h[1], 0);
+      else if(flag == 2) /** 交于 e 的终点 */
+        push(ip, h[0], 0);
+      else if(flag == 3) /** 交于 e 的内部 */
+        push(ip, h[0], 1);
     }
+  };
 
-    edge_traversed.insert(e);
+  prev.clear();
+  cur.assign(ip0.cells.begin(), ip0.cells.end());
+  while(!cur.empty())
+  {
+    double s_in = s_out;
+    for(Cell * c : cur)
+      intersect_cell(c);
+    if(!(s_out > s_in))
+      break;
 
-    if(flag != 4)
+    next.clear();
+    if(exit_h)
+    {
+      if(!exit_h->is_boundary())
+        next.push_back(exit_h->opposite()->cell());
+    }
+    else
     {
-      insert_cell(c[0]);
-      insert_cell(c[1]);
+      /** 出口顶点周围的单元, 遇到边界时反方向再转一次 */
+      HalfEdge * h0 = exit_node->halfedge();
+      HalfEdge * h = h0;
+      bool on_boundary = false;
+      do
+      {
+        if(!in(cur, h->cell()))
+          next.push_back(h->cell());
+        on_boundary = h->next()->is_boundary();
+        h = h->next()->opposite();
+      } while(!on_boundary && h != h0);
+      if(on_boundary)
+      {
+        for(h = h0; !h->is_boundary(); )
+        {
+          h = h->opposite()->previous();
+          if(!in(cur, h->cell()))
+            next.push_back(h->cell());
+        }
+      }
     }
+    std::swap(prev, cur);
+    std::swap(cur, next);
   }
 
-  /** 移除重复的交点 */
-  std::sort(intersections.begin(), intersections.end(), 
-      [&p0](const Intersection & a, const Intersection & b)
-      {
-        return (a.point-p0).length() < (b.point-p0).length();
-      });
-  auto last = std::unique(intersections.begin(), intersections.end());
-  intersections.erase(last, intersections.end());
+  /** 终点所在的单元 */
+  prev.clear();
+  for(Cell * c : ip1.cells)
+    intersect_cell(c);
+
+  /** 终点离起点最远, 放在最后 */
+  if (ip1.type != 2)
+    insert(Intersection(p1, ip1.h, ip1.type), d.dot(d));
 
   /** 1.2 边上的点加密 */
   for(auto & ins : intersections)
@@ -288,46 +387,45 @@ Mesh::HalfEdge * CutMeshAlgorithm<Mesh>::_find_halfedge_of_intersection(Intersec
 /**
  * @brief 找到同一个单元的界面角点
  * @param iface: 界面
- * @return: 返回角点列表
+ * @param corners: 返回角点列表
  *          每个元素是一个数组，
  *          第一个元素是角点的起始点编号，
  *          第二个元素是角点的终点编号,
  *          第三个元素是角点是否是固定点
  */
 template<typename Mesh>
-std::deque<std::array<uint32_t, 3> > CutMeshAlgorithm<Mesh>::_find_corners_of_same_cell(
-    Interface & iface)
+void CutMeshAlgorithm<Mesh>::_find_corners_of_same_cell(
+    Interface & iface, std::vector<std::array<uint32_t, 3> > & corners)
 {
   auto & ipoints  = iface.points();
 
   uint32_t NP = ipoints.size(); /** 界面的点数 */
-  std::deque<std::array<uint32_t, 3> > corners; 
+  corners.clear();
 
   Cell * c = nullptr;
   std::array<uint32_t, 3> corn{0, 0, 0};
   for(uint32_t i = 0; i < NP; i++)
   {
     const auto & ip0 = ipoints[i];
-    if(ip0.type == 2)
+    /**
+     * 在顶点或边上的点结束当前的角点, 否则同一个单元中在它前后的点会被连成
+     * 一个角点, 这个点 (可能是固定点) 就被跳过了
+     */
+    if(ip0.type != 2 || c != ip0.cells[0])
     {
-      if (c != ip0.cells[0])
-      {
-        if (c != nullptr)
-        {
-          corners.push_back(corn);
-          corn = {0, 0, 0};
-        }
-        c = ip0.cells[0];
-        corn = {i, i, ip0.is_fixed_point};
-      }
-      else if(c == ip0.cells[0])
-      {
-        corn[1] = i;
-        corn[2] = ip0.is_fixed_point || corn[2];
-      }
+      if(c != nullptr)
+        corners.push_back(corn);
+      c = ip0.type == 2 ? ip0.cells[0] : nullptr;
+      corn = {i, i, ip0.is_fixed_point};
+    }
+    else
+    {
+      corn[1] = i;
+      corn[2] = ip0.is_fixed_point || corn[2];
     }
   }
-  corners.push_back(corn);
+  if(c != nullptr)
+    corners.push_back(corn);
 
   if(iface.is_loop_interface() && ipoints[0].type==2 && ipoints.back().type==2
     && ipoints[0].cells[0] == ipoints.back().cells[0])
@@ -338,13 +436,12 @@ std::deque<std::array<uint32_t, 3> > CutMeshAlgorithm<Mesh>::_find_corners_of_sa
   }
   else if(!iface.is_loop_interface() && ipoints[0].type==2)
   {
-    corners.pop_front();
+    corners.erase(corners.begin());
   }
   else if(!iface.is_loop_interface() && ipoints.back().type==2)
   {
     corners.pop_back();
   }
-  return corners;
 }
 
 /**
@@ -457,20 +554,50 @@ Mesh::Cell * CutMeshAlgorithm<Mesh>::_find_link_cell(Intersection & a,
  * @param intersections: 交点列表
  */
 template<typename Mesh>
-void CutMeshAlgorithm<Mesh>::cut_by_loop_interface(Interface & iface)
+CutStats CutMeshAlgorithm<Mesh>::cut_by_loop_interface(Interface & iface)
 {
-  auto & is_in_cell = *is_in_cell_;
+  using Clock = std::chrono::steady_clock;
+  auto ns = [](Clock::duration d) 
+  { 
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()); 
+  };
+  auto t0 = Clock::now();
+  int64_t size0[4] = {mesh_->number_of_nodes(), mesh_->number_of_edges(), 
+    mesh_->number_of_cells(), mesh_->number_of_halfedges()};
+
+  auto & is_in_cell = mesh_->cell_data(is_in_cell_);
   const auto & geometry_utils = mesh_->geometry_utils();
 
-  std::vector<std::vector<Intersection> > intersections;
+  /** 标记只描述这一次切割, 上一次的内部单元不是这次搜索的起点 */
+  is_in_cell.set_value(0);
+
   auto & ipoints  = iface.points();
 
   uint32_t NP = ipoints.size(); /** 界面的点数 */
   uint32_t NS = NP - 1 + iface.is_loop_interface(); /** 界面的 segment 数 */
-  intersections.resize(NS);
 
   /** 0. 找到同一个单元的界面角点 */
-  auto corners = _find_corners_of_same_cell(iface);
+  auto & corners = corners_;
+  _find_corners_of_same_cell(iface, corners);
+
+  /** 
+   * 每个 segment 和每个不固定的角点各有一个交点列表, 按顺序连续地存放在
+   * intersections_ 中, 不为每个列表分配内存
+   */
+  auto & intersections = intersections_;
+  auto & offsets = offsets_;
+  intersections.clear();
+  offsets.assign(1, 0);
+  marked_cells_.clear();
+
+  /** 计算 [ip0, ip1] 和网格的交点, 作为一个新的交点列表 */
+  auto add_list = [this, &intersections, &offsets](InterfacePoint & ip0, InterfacePoint & ip1)
+  {
+    segment_.clear();
+    find_intersections_of_segment(ip0, ip1, segment_);
+    intersections.insert(intersections.end(), segment_.begin(), segment_.end());
+    offsets.push_back(intersections.size());
+  };
 
   /** 1. 计算每个 segment 和网格的交点 */
   for(uint32_t i = 0; i < NS; i++)
@@ -481,24 +608,22 @@ void CutMeshAlgorithm<Mesh>::cut_by_loop_interface(Interface & iface)
     auto & ip1 = ipoints[i1];
 
     /** 1.1 找到 segment[i] 与网格的交点 */
-    find_intersections_of_segment(ip0, ip1, intersections[i]);
+    add_list(ip0, ip1);
   }
 
   /** 2. 处理转折点
    * 对于有固定点的情况，连接了以后折断半边连接到固定点
    * 对于没有固定点的情况，就把他们变成一个 segment
    */
-  uint32_t NC = corners.size();
-  std::vector<bool> need_insert_point;
-  need_insert_point.reserve(NC);
   for(auto & corn : corners)
   {
     auto & start = corn[0];
     auto & end   = corn[1];
     auto & fixed = corn[2];
-    auto & ins0 = intersections[(NP+start-1)%NP].back();
-    auto & ins1 = intersections[end].front();
-    Cell * c = ipoints[start].cells[0];
+    /** 增加列表时 intersections 可能重新分配, 所以 ins0, ins1 只在增加之前使用 */
+    auto & ins0 = intersections[offsets[(NP+start-1)%NP+1]-1];
+    auto & ins1 = intersections[offsets[end]];
+    Cell * c = _find_corner_cell(ipoints[start].cells[0], ins0, ins1);
     if(fixed) /** 固定转折点的情况 */
     {
       HalfEdge * h = _link_two_intersections(ins0, ins1, c);
@@ -510,63 +635,56 @@ void CutMeshAlgorithm<Mesh>::cut_by_loop_interface(Interface & iface)
           break;
         }
       }
-      is_in_cell[h->opposite()->cell()->index()] = 2;
-      is_in_cell[h->cell()->index()] = 1;
+      _mark_cells(is_in_cell, h->cell(), h->opposite()->cell());
     }
     else     
     {
-      intersections.push_back({});
+      InterfacePoint ip0{ins0.point, false, {c}, ins0.h, 0};
+      InterfacePoint ip1{ins1.point, false, {c}, ins1.h, 0};
 
-      std::vector<Cell * > c0 = {c};
-      std::vector<Cell * > c1 = {c};
-      InterfacePoint ip0(ins0.point, false, c0, ins0.h, 0);
-      InterfacePoint ip1(ins1.point, false, c1, ins1.h, 0);
-
-      find_intersections_of_segment(ip0, ip1, intersections.back());
+      add_list(ip0, ip1);
     }
   }
 
   /** 3. 连接每个 segment 的交点*/
-  for(auto & ips : intersections)
+  for(uint32_t k = 0; k+1 < offsets.size(); k++)
   {
-    int Ni = ips.size();
-    for(int j = 0; j < Ni-1; j++)
+    for(uint32_t j = offsets[k]; j+1 < offsets[k+1]; j++)
     {
-      HalfEdge * h = _link_two_intersections_in_same_segment(ips[j], ips[j+1]);
-      is_in_cell[h->opposite()->cell()->index()] = 2;
-      is_in_cell[h->cell()->index()] = 1;
+      /** 
+       * 交到顶点附近的交点的坐标不一定等于顶点, 排序去重之后仍可能有两个交点在
+       * 同一个顶点上, 它们之间没有可以连接的边
+       */
+      if(intersections[j].h->node() == intersections[j+1].h->node())
+        continue;
+      HalfEdge * h = _link_two_intersections_in_same_segment(intersections[j], intersections[j+1]);
+      _mark_cells(is_in_cell, h->cell(), h->opposite()->cell());
     }
   }
+  auto t1 = Clock::now();
   _get_inner_cell(is_in_cell);
-  mesh_->update_subcell();
+  auto t2 = Clock::now();
+
+  CutStats stats;
+  stats.time[uint32_t(CutPhase::Serial)] = ns(t1-t0);
+  stats.time[uint32_t(CutPhase::InnerCells)] = ns(t2-t1);
+  stats.time[uint32_t(CutPhase::Total)] = ns(t2-t0);
+  stats.added[0] = int64_t(mesh_->number_of_nodes()) - size0[0];
+  stats.added[1] = int64_t(mesh_->number_of_edges()) - size0[1];
+  stats.added[2] = int64_t(mesh_->number_of_cells()) - size0[2];
+  stats.added[3] = int64_t(mesh_->number_of_halfedges()) - size0[3];
+  stats.count[uint32_t(CutCounter::Segment)] = NS;
+  stats.count[uint32_t(CutCounter::Intersection)] = intersections.size();
+  stats.count[uint32_t(CutCounter::SplitHalfEdge)] = stats.added[0];
+  stats.count[uint32_t(CutCounter::SplitCell)] = stats.added[2];
+  stats.cuts = 1;
+  return stats;
 }
 
 template<typename Mesh>
 void CutMeshAlgorithm<Mesh>::_get_inner_cell(Array<uint8_t> & is_in_the_interface)
 {
-  /** 处理内部单元标记 */
-  std::stack<typename Mesh::Cell*> inner_cell;
-  auto & cell = *(mesh_->get_cell());
-  for(auto & c : cell)
-  {
-    if(is_in_the_interface[c.index()]==1)
-      inner_cell.push(&c);
-  }
-  while(!inner_cell.empty())
-  {
-    typename Mesh::Cell * c = inner_cell.top();
-    inner_cell.pop();
-    for(auto & ci : c->adj_cells())
-    {
-      if(is_in_the_interface[ci.index()]==0)
-      {
-        inner_cell.push(&ci);
-        is_in_the_interface[ci.index()]=1;
-      }
-    }
-  }
-  for(auto & c : cell)
-    is_in_the_interface[c.index()] = is_in_the_interface[c.index()]==1;
+  label_inner_cells(*mesh_, is_in_the_interface, marked_cells_, frontier_);
 }
 
 }
@@ -0,0 +1,299 @@
+#ifndef _CUT_TRACE_
+#define _CUT_TRACE_
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "tools.h"
+
+namespace HEM
+{
+
+/** @brief 切割的阶段 */
+enum class CutPhase : uint8_t
+{
+  Partition,  /**< 找出可以并发切割的界面 */
+  Parallel,   /**< 并发切割独立的界面 */
+  Serial,     /**< 串行切割其余的界面 */
+  FirstPoint, /**< 找循环界面的第一个点, 包含在 Parallel 或 Serial 中 */
+  InnerCells, /**< 标记内部单元 */
+  Total,      /**< 整个切割 */
+  Count
+};
+
+/** @brief 切割中计数的事件 */
+enum class CutCounter : uint8_t
+{
+  Segment,       /**< 处理的界面线段 */
+  SplitHalfEdge, /**< 加密的半边 */
+  SplitCell,     /**< 分割的单元 */
+  VertexHit,     /**< 线段交到网格顶点上 */
+  SmallCell,     /**< 因为会产生面积很小的单元而没有分割 */
+  Collinear,     /**< 出射方向与顶点处的边共线 */
+  CellVisit,     /**< 线段走出单元时经过的单元 */
+  Intersection,  /**< 计算的线段与半边的交点 */
+  Count
+};
+
+/** @brief 切割中的警告 */
+enum class CutWarning : uint8_t
+{
+  NoStartPoint,       /**< 循环界面找不到起点, 界面没有被切割 */
+  NonLoopIgnored,     /**< 非循环界面还不支持, 被忽略 */
+  ConcurrentOverflow, /**< 并发切割时实体超过了预留的空间, 其余的界面改为串行切割 */
+  ConcurrentRollback, /**< 并发切割时余量用完, 撤销了一个界面已经做的分割 */
+  Count
+};
+
+/**
+ * @brief 追踪记录的一个事件
+ * @note kind 为 Phase 时 id 是 CutPhase, value 是耗时 (纳秒);
+ *       kind 为 Counter 时 id 是 CutCounter, value 是上一次 commit_counts 之后的计数;
+ *       kind 为 Warning 时 id 是 CutWarning, value 是界面的点数, 
+ *       ConcurrentOverflow 的 value 是改为串行切割的界面个数, 
+ *       ConcurrentRollback 的 value 是撤销的分割次数。
+ */
+struct CutEvent
+{
+  enum Kind : uint8_t { Phase, Counter, Warning };
+
+  uint64_t time;   /**< 记录时的时间 (纳秒, steady_clock) */
+  uint64_t value;
+  uint8_t kind;
+  uint8_t id;
+  uint16_t thread; /**< 记录事件的 OpenMP 线程编号 */
+};
+
+/**
+ * @brief 切割的统计, 由 CutMeshAlgorithm 的切割函数返回, 可以用 += 累计
+ * @note 1. 只含有 uint64_t 和 int64_t 数组, 是标准布局的, 可以直接通过 C 接口传出
+ *       2. 并发切割时各线程中的阶段 (FirstPoint) 的耗时是所有线程的和
+ */
+struct CutStats
+{
+  uint64_t time[uint32_t(CutPhase::Count)] = {};    /**< 各阶段的耗时 (纳秒) */
+  uint64_t count[uint32_t(CutCounter::Count)] = {}; /**< 各种事件的次数 */
+  int64_t added[4] = {}; /**< 新增的顶点, 边, 单元, 半边的个数 */
+  uint64_t cuts = 0;     /**< 统计的切割次数 */
+
+  double seconds(CutPhase p) const { return time[uint32_t(p)]*1e-9; }
+
+  uint64_t operator[](CutCounter c) const { return count[uint32_t(c)]; }
+
+  CutStats & operator += (const CutStats & other)
+  {
+    for(uint32_t i = 0; i < uint32_t(CutPhase::Count); i++)
+      time[i] += other.time[i];
+    for(uint32_t i = 0; i < uint32_t(CutCounter::Count); i++)
+      count[i] += other.count[i];
+    for(uint32_t i = 0; i < 4; i++)
+      added[i] += other.added[i];
+    cuts += other.cuts;
+    return *this;
+  }
+};
+
+/**
+ * @brief 不做任何事的追踪, 切割算法的默认追踪类型
+ * @note enabled 为 false, 算法中所有追踪代码都在 if constexpr 中, 会被完全去掉
+ */
+class NullCutTrace
+{
+public:
+  static constexpr bool enabled = false;
+
+  void count(CutCounter, uint64_t = 1) {}
+  void phase(CutPhase, uint64_t) {}
+  void warning(CutWarning, uint64_t = 0) {}
+  void commit_counts() {}
+};
+
+/**
+ * @brief 把事件记录到固定大小的无锁环形缓冲区中的追踪
+ * @param CAPACITY : 缓冲区能保存的事件个数, 必须是 2 的幂
+ * @note 1. 任意多个线程可以同时记录和读取事件 (有界 MPMC 队列, 每个位置有一个
+ *          序号), 缓冲区满时丢弃新事件并计入 dropped(), 切割线程不会等待。
+ *       2. count 只是增加当前线程的计数器, 不写缓冲区; commit_counts 把上一次
+ *          之后的计数作为 Counter 事件写入缓冲区, 由切割算法在切割结束时调用。
+ */
+template<uint32_t CAPACITY = 4096u>
+class RingBufferCutTrace
+{
+public:
+  static constexpr bool enabled = true;
+  static_assert((CAPACITY & (CAPACITY-1)) == 0, "CAPACITY must be a power of 2.");
+
+public:
+  RingBufferCutTrace() :
+    NT_(number_of_threads()),
+    slots_(new Slot[CAPACITY]),
+    counters_(new ThreadCounters[NT_])
+  {
+    for(uint32_t i = 0; i < CAPACITY; i++)
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  /** @brief 当前线程的计数器 c 增加 n */
+  void count(CutCounter c, uint64_t n = 1)
+  {
+    auto & v = counters_[thread() % NT_].value[uint32_t(c)];
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  void phase(CutPhase p, uint64_t ns) { push(CutEvent::Phase, uint8_t(p), ns); }
+
+  void warning(CutWarning w, uint64_t value = 0) { push(CutEvent::Warning, uint8_t(w), value); }
+
+  /** @brief 把上一次调用之后的计数写入缓冲区, 不能与另一个 commit_counts 同时调用 */
+  void commit_counts()
+  {
+    for(uint32_t c = 0; c < uint32_t(CutCounter::Count); c++)
+    {
+      uint64_t n = counter(CutCounter(c));
+      if(n != committed_[c])
+        push(CutEvent::Counter, c, n - committed_[c]);
+      committed_[c] = n;
+    }
+  }
+
+  /** @brief 计数器 c 在所有线程上的和 */
+  uint64_t counter(CutCounter c) const
+  {
+    uint64_t n = 0;
+    for(uint32_t t = 0; t < NT_; t++)
+      n += counters_[t].value[uint32_t(c)].load(std::memory_order_relaxed);
+    return n;
+  }
+
+  /** @brief 取出最早的一个事件, 缓冲区为空时返回 false */
+  bool pop(CutEvent & e)
+  {
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    Slot * slot = nullptr;
+    while(true)
+    {
+      slot = &slots_[pos & (CAPACITY-1)];
+      int64_t diff = int64_t(slot->seq.load(std::memory_order_acquire)) - int64_t(pos+1);
+      if(diff == 0 && head_.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+        break;
+      else if(diff < 0)
+        return false;
+      else if(diff > 0)
+        pos = head_.load(std::memory_order_relaxed);
+    }
+    e = slot->event;
+    slot->seq.store(pos+CAPACITY, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief 按顺序取出所有事件并对每个事件调用 f, 返回事件个数 */
+  template<typename F>
+  uint32_t drain(F && f)
+  {
+    uint32_t n = 0;
+    CutEvent e;
+    for(; pop(e); n++)
+      f(e);
+    return n;
+  }
+
+  /** @brief 缓冲区满时丢弃的事件个数 */
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  static constexpr uint32_t capacity() { return CAPACITY; }
+
+private:
+  static uint16_t thread() { return thread_id(); }
+
+  static uint64_t now()
+  {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+  }
+
+  void push(uint8_t kind, uint8_t id, uint64_t value)
+  {
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    Slot * slot = nullptr;
+    while(true)
+    {
+      slot = &slots_[pos & (CAPACITY-1)];
+      int64_t diff = int64_t(slot->seq.load(std::memory_order_acquire)) - int64_t(pos);
+      if(diff == 0 && tail_.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+        break;
+      else if(diff < 0)
+      {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      else if(diff > 0)
+        pos = tail_.load(std::memory_order_relaxed);
+    }
+    slot->event = CutEvent{now(), value, kind, id, thread()};
+    slot->seq.store(pos+1, std::memory_order_release);
+  }
+
+private:
+  /**
+   * 位置 i 的序号等于 i 时可以写入第 i 个事件, 等于 i+1 时可以读出,
+   * 读出之后变成 i+CAPACITY, 即下一轮可以写入
+   */
+  struct Slot
+  {
+    std::atomic<uint64_t> seq;
+    CutEvent event;
+  };
+
+  /** 每个线程一行缓存, 只有自己的线程写 */
+  struct alignas(64) ThreadCounters
+  {
+    std::atomic<uint64_t> value[uint32_t(CutCounter::Count)] = {};
+  };
+
+  uint32_t NT_;
+  std::unique_ptr<Slot[]> slots_;
+  std::unique_ptr<ThreadCounters[]> counters_;
+  uint64_t committed_[uint32_t(CutCounter::Count)] = {};
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  alignas(64) std::atomic<uint64_t> dropped_{0};
+};
+
+/**
+ * @brief 在作用域结束时把经过的时间加到 *time 上, 并记为追踪中阶段 p 的耗时
+ * @note 只在阶段的开始和结束时读时钟, Trace::enabled 为 false 时不调用追踪
+ */
+template<typename Trace>
+class CutPhaseScope
+{
+public:
+  CutPhaseScope(Trace * trace, uint64_t * time, CutPhase p) : 
+    trace_(trace), time_(time), phase_(p), start_(std::chrono::steady_clock::now()) {}
+
+  CutPhaseScope(const CutPhaseScope &) = delete;
+
+  ~CutPhaseScope()
+  {
+    auto t = std::chrono::steady_clock::now() - start_;
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+    if(time_)
+      *time_ += ns;
+    if constexpr (Trace::enabled)
+    {
+      if(trace_)
+        trace_->phase(phase_, ns);
+    }
+  }
+
+private:
+  Trace * trace_;
+  uint64_t * time_;
+  CutPhase phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}
+
+#endif /* _CUT_TRACE_ */
@@ -4,11 +4,37 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <memory_resource>
+#include <mutex>
+#include <atomic>
 
 #include "chunk_array.h"
+#include "tools.h"
 
 namespace HEM {
 
+/**
+ * @brief 数据的句柄, 即数据在 DataContainer 中的编号
+ * @note 通过名字得到一次句柄之后, 就可以用 O(1) 的时间访问数据, 
+ *   没有字符串比较和 dynamic_cast。数据被删除后编号不会被重新使用, 
+ *   复制 DataContainer 之后编号不变。
+ */
+template<typename T>
+class DataHandle
+{
+public:
+  constexpr DataHandle(uint32_t key = -1): key_(key) {}
+
+  constexpr uint32_t key() const { return key_; }
+
+  constexpr bool is_valid() const { return key_ != uint32_t(-1); }
+
+private:
+  uint32_t key_;
+};
+
 template<uint32_t CHUNK_SIZE = 1024u>
 class DataContainer
 {
@@ -20,13 +46,16 @@ public:
 public:
   /**
    * @brief 构造函数
+   * @param resource : 数据数组的块和数组对象都从 resource 分配, 
+   *                   为空时使用 std::pmr::get_default_resource()
    */
-  DataContainer(unsigned int size=0): data_number_(size), 
-    is_free_(std::make_shared<MarkArray>(size)), 
-    free_index_(), data_() 
+  DataContainer(unsigned int size=0, std::pmr::memory_resource * resource = nullptr): 
+    data_number_(size), 
+    resource_(resource ? resource : std::pmr::get_default_resource()), 
+    is_free_(make_array<MarkArray>(size, resource_)), 
+    free_index_(), dirty_begin_(0), data_() 
   {
-    //is_free_->set_false();
-    is_free_->set_value(0);
+    is_free_->set_false();
   }
 
   uint32_t size() {return is_free_->size();}
@@ -37,34 +66,27 @@ public:
   template<typename T>
   std::shared_ptr<DataArray<T> > add_data(std::string name)
   {
-    auto ff = [&](std::shared_ptr<ArrayBase> & data) -> bool
-    {
-      return data->get_name().compare(name)==0;
-    };
-    auto it = std::find_if(data_.begin(), data_.end(), ff);
-    if(it==data_.end())
+    uint32_t key = key_of(name);
+    if(key == uint32_t(-1))
     {
-      std::shared_ptr<DataArray<T> > data = std::make_shared<DataArray<T> >(name, is_free_);
+      std::shared_ptr<DataArray<T> > data = make_array<DataArray<T> >(name, is_free_, resource_);
+      key_.emplace(name, data_.size());
       data_.push_back(data);
       return data;
     }
-    return std::dynamic_pointer_cast<DataArray<T> >(*it);
+    return std::dynamic_pointer_cast<DataArray<T> >(data_[key]);
   }
 
   /**
-   * @brief 删除一个数据
+   * @brief 删除一个数据, 它的编号不会被其他数据使用
    */
   template<typename T>
   void delete_data(std::string name)
   {
-    auto ff = [&](std::shared_ptr<ArrayBase> & data) -> bool
-    {
-      return data->get_name().compare(name)==0;
-    };
-    auto it = std::find_if(data_.begin(), data_.end(), ff);
-    assert(it!=data_.end());
-    *it = data_.back();
-    data_.pop_back();
+    auto it = key_.find(name);
+    assert(it!=key_.end());
+    data_[it->second].reset();
+    key_.erase(it);
   }
 
   /**
@@ -73,27 +95,74 @@ public:
   template<typename T>
   std::shared_ptr<DataArray<T> > get_data(std::string name)
   {
-    auto ff = [&](std::shared_ptr<ArrayBase> & data) -> bool
-    {
-      return data->get_name().compare(name)==0;
-    };
-    auto it = std::find_if(data_.begin(), data_.end(), ff);
-    assert(it!=data_.end());
-    return std::dynamic_pointer_cast<DataArray<T> >(*it);
+    uint32_t key = key_of(name);
+    assert(key != uint32_t(-1));
+    return std::dynamic_pointer_cast<DataArray<T> >(data_[key]);
+  }
+
+  /**
+   * @brief 添加一个数据, 并返回它的句柄
+   */
+  template<typename T>
+  DataHandle<T> add_handle(std::string name)
+  {
+    add_data<T>(name);
+    return get_handle<T>(name);
+  }
+
+  /**
+   * @brief 获取某个数据的句柄, 只在这里检查数据的类型
+   */
+  template<typename T>
+  DataHandle<T> get_handle(std::string name)
+  {
+    uint32_t key = key_of(name);
+    assert(key != uint32_t(-1));
+    assert(dynamic_cast<DataArray<T> *>(data_[key].get()) != nullptr);
+    return DataHandle<T>(key);
+  }
+
+  /** 
+   * @brief 由句柄获取数据, 不做检查 
+   */
+  template<typename T>
+  DataArray<T> & operator[](DataHandle<T> handle)
+  {
+    return *static_cast<DataArray<T> *>(data_[handle.key()].get());
+  }
+
+  template<typename T>
+  const DataArray<T> & operator[](DataHandle<T> handle) const
+  {
+    return *static_cast<const DataArray<T> *>(data_[handle.key()].get());
+  }
+
+  /** 
+   * @brief 数据的编号, 没有这个数据时返回 -1
+   */
+  uint32_t key_of(const std::string & name) const
+  {
+    auto it = key_.find(name);
+    return it == key_.end() ? uint32_t(-1) : it->second;
   }
 
   void clear()
   {
     data_.clear();
+    key_.clear();
+    is_free_->clear();
     free_index_.clear();
     data_number_ = 0;
+    dirty_begin_ = 0;
   }
 
   void release()
   {
     data_.clear();
+    key_.clear();
     free_index_.clear();
     data_number_ = 0;
+    dirty_begin_ = 0;
   }
 
   DataContainer & operator = (DataContainer & other)
@@ -102,12 +171,16 @@ public:
     {
       clear();
       data_number_ = other.data_number_;
-      is_free_ = std::make_shared<MarkArray>(*(other.is_free_));
+      is_free_ = make_array<MarkArray>(*(other.is_free_), resource_);
       free_index_ = other.free_index_;
+      dirty_begin_ = other.dirty_begin_;
+      key_ = other.key_;
       for(auto & otherData : other.data_)
       {
-        std::shared_ptr<ArrayBase> data = std::make_shared<DataArray<uint8_t>>();
-        otherData->copy_self(is_free_, data);
+        /** 被删除的数据也要占位, 使得编号不变 */
+        std::shared_ptr<ArrayBase> data;
+        if(otherData)
+          otherData->copy_self(is_free_, data, resource_);
         data_.emplace_back(data);
       }
     }
@@ -118,61 +191,346 @@ public:
   void swap(DataContainer & other)
   {
     std::swap(data_number_, other.data_number_);
+    std::swap(resource_, other.resource_);
     is_free_.swap(other.is_free_);
     std::swap(free_index_, other.free_index_);
+    std::swap(dirty_begin_, other.dirty_begin_);
     std::swap(data_, other.data_);
+    std::swap(key_, other.key_);
   }
 
   std::shared_ptr<MarkArray> & is_free() {return is_free_;}
 
+  std::pmr::memory_resource * memory_resource() const { return resource_; }
+
   /** 获取 data 的接口 */
   std::vector<std::shared_ptr<ArrayBase>> & data() {return data_;}
 
   void delete_index(uint32_t idx)
   {
-    //is_free_->set_true(idx); 
-    is_free_->get(idx) = 1; 
+    if(concurrent_)
+      _concurrent_delete_index(idx);
+    else
+      _delete_index(idx);
+  }
+
+  /** @brief 添加一个位置, 并发模式下余量用完时返回 -1, 见 set_concurrent */
+  uint32_t add_index()
+  {
+    if(concurrent_)
+      return _concurrent_add_index();
+    return _add_index();
+  }
+
+  /**
+   * @brief 为所有数据预留 n 个位置的空间
+   */
+  void reserve(uint32_t n)
+  {
+    for(auto & ptr : data_)
+    {
+      if(ptr)
+        ptr->reserve(n);
+    }
+    is_free_->reserve(n);
+  }
+
+  /**
+   * @brief 进入或退出并发模式, 并发模式下 add_index 和 delete_index 可以被
+   *   一个 OpenMP 并行区域中的多个线程同时调用
+   * @param n : 预计添加的位置个数
+   * @note 1. 每个线程有自己的空位列表和独占的一段位置, 添加和删除都不加锁。
+   *          线程自己的位置用完时, 在锁内取一批全局的空位, 或者下一段新的位置。
+   *       2. 进入时把所有数组一次扩容到预计的个数再加上每个线程几个块的余量, 
+   *          并发模式下不改变任何数组的大小和块, 所以其他线程可以同时读写已有位置的数据。
+   *       3. 退出时把各个线程剩下的位置放回全局的空位列表, 数组缩回到用到的位置, 
+   *          size(), number_of_data() 和 dirty_begin() 在退出之后才是正确的。
+   *       4. 只能在并行区域之外进入和退出, 添加或删除数据数组、复制和重排
+   *          都不能在并发模式下进行。
+   *       5. 位置超过预计的 n 个时不会抛出异常 (异常不能离开并行区域), 而是
+   *          标记 is_overflowed() 并继续使用余量, 调用者应该在余量用完之前
+   *          停止添加; 余量也用完时 add_index 返回 -1。
+   */
+  void set_concurrent(bool flag, uint32_t n = 0)
+  {
+    if(flag == concurrent_)
+      return;
+    if(flag)
+    {
+      pools_.assign(number_of_threads(), LocalPool());
+      top_ = size();
+      reserved_ = std::max<size_t>(is_free_->capacity(), top_+n);
+      /** 给每个线程留几个块的余量 */
+      size_t cap = reserved_ + 4*CHUNK_SIZE*pools_.size();
+      slot_capacity_ = (cap + CHUNK_SIZE - 1)/CHUNK_SIZE*CHUNK_SIZE;
+      for(auto & ptr : data_)
+      {
+        if(ptr)
+          ptr->resize(slot_capacity_);
+      }
+      is_free_->resize(slot_capacity_);
+      /** 新的位置在 is_free_ 中是 false, 没有用到的位置在退出并发模式时才被标记为空位 */
+      for(size_t i = top_; i < slot_capacity_; i++)
+        is_free_->set_false(i);
+      overflow_.store(false, std::memory_order_relaxed);
+    }
+    else
+      _merge_pools();
+    concurrent_ = flag;
+  }
+
+  bool is_concurrent() const { return concurrent_; }
+
+  /** @brief 并发模式下添加的位置是否超过了 set_concurrent 时预计的个数 */
+  bool is_overflowed() const { return overflow_.load(std::memory_order_relaxed); }
+
+  uint32_t number_of_data() { return data_number_;}
+
+  /** @brief 没有被释放的位置, 即存储位置就是紧凑编号 */
+  bool is_compact() const { return free_index_.empty(); }
+
+  /**
+   * @brief 重排所有数据, 重排后有 n 个位置, 第 k 个位置是原来的第 order[k] 个位置
+   * @note 1. order 中只能有没有被释放的位置, 重排之后没有空位, 多余的块都被释放。
+   *       2. 所有位置都被标记为被修改过。
+   */
+  void permute(const uint32_t * order, uint32_t n)
+  {
+    for(auto & data : data_)
+    {
+      if(data)
+        data->permute(order, n);
+    }
+    is_free_->resize(n);
+    is_free_->set_false();
+    is_free_->shrink_to_fit();
+    free_index_.clear();
+    free_index_.shrink_to_fit();
+    data_number_ = n;
+    dirty_begin_ = 0;
+  }
+
+  /** 
+   * @brief 上次 clear_dirty() 之后被添加或删除的第一个位置, 
+   *   在它之前的位置都没有变化 
+   */
+  uint32_t dirty_begin() const { return dirty_begin_; }
+
+  /** @brief 将 begin 之后的位置都标记为被修改过 */
+  void set_dirty(uint32_t begin = 0) { dirty_begin_ = std::min(dirty_begin_, begin); }
+
+  void clear_dirty() { dirty_begin_ = size(); }
+
+  /** 
+   * @brief 对 [begin, size()) 中没有被释放的位置 i 调用 f(i) 
+   */
+  template<typename Fun>
+  void for_each_index(uint32_t begin, const Fun & f)
+  {
+    uint32_t N = size();
+    if(is_compact())
+    {
+      for(uint32_t i = begin; i < N; i++)
+        f(i);
+      return;
+    }
+    for(uint32_t i = is_free_->find_next_false(begin); i < N; 
+        i = is_free_->find_next_false(i+1))
+      f(i);
+  }
+
+private:
+  /** 在 resource_ 中创建数组, 控制块也从 resource_ 分配 */
+  template<typename Array, typename... Args>
+  std::shared_ptr<Array> make_array(Args&&... args)
+  {
+    return std::allocate_shared<Array>(std::pmr::polymorphic_allocator<Array>(resource_), 
+        std::forward<Args>(args)...);
+  }
+
+  /** 并发模式下每个线程自己的位置, 对齐到缓存行避免伪共享 */
+  struct alignas(64) LocalPool
+  {
+    /** 本线程可以使用的空位 */
+    std::vector<uint32_t> free_index;
+
+    /** 本线程独占的位置 [next, end) */
+    uint32_t next = 0;
+    uint32_t end = 0;
+
+    /** 本线程添加的位置个数减去删除的位置个数 */
+    int64_t number = 0;
+
+    uint32_t dirty_begin = uint32_t(-1);
+  };
+
+  uint32_t _concurrent_add_index()
+  {
+    LocalPool & pool = pools_[thread_id()];
+    if(pool.free_index.empty() && pool.next == pool.end && !_refill_pool(pool))
+      return uint32_t(-1);
+
+    uint32_t index;
+    if(!pool.free_index.empty())
+    {
+      index = pool.free_index.back();
+      pool.free_index.pop_back();
+      is_free_->atomic_set_false(index);
+    }
+    else
+      index = pool.next++;
+    pool.number++;
+    pool.dirty_begin = std::min(pool.dirty_begin, index);
+    return index;
+  }
+
+  void _concurrent_delete_index(uint32_t idx)
+  {
+    LocalPool & pool = pools_[thread_id()];
+    is_free_->atomic_set_true(idx); 
+    pool.free_index.push_back(idx);
+    pool.number--;
+    pool.dirty_begin = std::min(pool.dirty_begin, idx);
+  }
+
+  /**
+   * @brief 线程自己的位置用完了, 先取一批全局的空位, 没有的话取 top_ 到下一个块末尾的位置
+   * @return 余量也用完时设置 overflow_ 并返回 false
+   * @note 数组在进入并发模式时已经扩容, 这里不改变数组
+   */
+  bool _refill_pool(LocalPool & pool)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!free_index_.empty())
+    {
+      size_t n = std::min<size_t>(free_index_.size(), 64);
+      pool.free_index.assign(free_index_.end()-n, free_index_.end());
+      free_index_.resize(free_index_.size()-n);
+      return true;
+    }
+
+    uint32_t begin = top_;
+    uint32_t end = std::min<size_t>((begin/CHUNK_SIZE+1)*CHUNK_SIZE, slot_capacity_);
+    if(end > reserved_ || begin == end)
+      overflow_.store(true, std::memory_order_relaxed);
+    if(begin == end)
+      return false;
+    top_ = end;
+    pool.next = begin;
+    pool.end = end;
+    return true;
+  }
+
+  /** @brief 合并各个线程的位置, 没有用到的位置都成为空位 */
+  void _merge_pools()
+  {
+    for(auto & pool : pools_)
+    {
+      for(uint32_t i = pool.next; i < pool.end; i++)
+      {
+        is_free_->set_true(i);
+        free_index_.push_back(i);
+      }
+      free_index_.insert(free_index_.end(), pool.free_index.begin(), pool.free_index.end());
+      data_number_ += pool.number;
+      dirty_begin_ = std::min(dirty_begin_, pool.dirty_begin);
+    }
+    pools_.clear();
+
+    /** top_ 之后的位置没有被分给任何线程 */
+    for(auto & ptr : data_)
+    {
+      if(ptr)
+        ptr->resize(top_);
+    }
+    is_free_->resize(top_);
+  }
+
+  void _delete_index(uint32_t idx)
+  {
+    is_free_->set_true(idx); 
     free_index_.emplace_back(idx);
     data_number_--;
+    dirty_begin_ = std::min(dirty_begin_, idx);
   }
 
-  uint32_t add_index()
+  uint32_t _add_index()
   {
     data_number_++;
     /** 当 free_index_ 非空时，启用最后一个可用指标 */
     if(!free_index_.empty())
     {
       uint32_t index = free_index_.back();
-      //is_free_->set_false(index);
-      is_free_->get(index) = 0;
+      is_free_->set_false(index);
       free_index_.pop_back();
+      dirty_begin_ = std::min(dirty_begin_, index);
       return index; 
     }
     /** 当 free_index_ 为空时，没有可用指标所以要重新分配内存 */
     else
     {
       for(auto & ptr : data_)
-        ptr->resize(size()+1);
-      //is_free_->push_back_false();
-      is_free_->push_back(0);
+      {
+        if(ptr)
+          ptr->resize(size()+1);
+      }
+      is_free_->push_back_false();
       return size()-1;
     }
   }
 
-  uint32_t number_of_data() { return data_number_;}
 
 private:
   /** 实际上 data 的大小 */ 
   uint32_t data_number_;
 
+  /** 分配数据的内存资源 */
+  std::pmr::memory_resource * resource_;
+
   /** is_free_[i] = 1 代表第 i 个位置已经被释放了*/
   std::shared_ptr<MarkArray> is_free_;
 
   /** 存储已经被释放的位置的编号 */
   std::vector<uint32_t> free_index_;
 
-  /** 数据使用 shared_ptr 管理 */
+  /** [dirty_begin_, size()) 是上次更新之后可能被修改过的位置 */
+  uint32_t dirty_begin_;
+
+  /** 数据使用 shared_ptr 管理, 第 i 个数据的编号为 i, 被删除的数据为空指针 */
   std::vector<std::shared_ptr<ArrayBase>> data_;
+
+  /** 数据的名字到编号 */
+  std::unordered_map<std::string, uint32_t> key_;
+
+  /** 是否处于并发模式, 见 set_concurrent */
+  bool concurrent_ = false;
+
+  /** 并发模式下每个线程的位置 */
+  std::vector<LocalPool> pools_;
+
+  /** 并发模式下所有数组的大小 */
+  size_t slot_capacity_ = 0;
+
+  /** 并发模式下还没有分给任何线程的第一个位置 */
+  size_t top_ = 0;
+
+  /** 并发模式下预计的位置个数, 超过时设置 overflow_ */
+  size_t reserved_ = 0;
+
+  std::atomic<bool> overflow_{false};
+
+  /** 并发模式下扩容和取全局空位的锁 */
+  std::mutex mutex_;
+};
+
+/**
+ * @brief 实体的内置数据, 编号在编译期确定
+ */
+template<typename Entity>
+struct EntityBuiltinData
+{
+  constexpr static DataHandle<Entity> entity = DataHandle<Entity>(0);
+  constexpr static DataHandle<uint32_t> indices = DataHandle<uint32_t>(1);
 };
 
 template<typename Entity, uint32_t CHUNK_SIZE>
@@ -183,12 +541,17 @@ public:
   using Self = EntityDataContainer<Entity, CHUNK_SIZE>;
   template<typename T>
   using DataArray = typename Base::template DataArray<T>;
+  using Builtin = EntityBuiltinData<Entity>;
 
 public:
-  EntityDataContainer(uint32_t size=0): Base(size)
+  EntityDataContainer(uint32_t size=0, std::pmr::memory_resource * resource = nullptr): 
+    Base(size, resource)
   {
-    entity_ = Base::template add_data<Entity>("entity");
-    indices_ = Base::template add_data<uint32_t>("indices");
+    add_builtin_data();
+
+    /** 实体的编号就是它的存储位置 */
+    for(uint32_t i = 0; i < size; i++)
+      entity_->get(i).set_index(i);
   }
 
   std::shared_ptr<DataArray<Entity> > get_entity() const { return entity_;}
@@ -196,31 +559,48 @@ public:
   std::shared_ptr<DataArray<uint32_t> > get_entity_indices() const { return indices_;}
 
   Entity & add_entity()
+  {
+    Entity * e = try_add_entity();
+    assert(e != nullptr);
+    return *e;
+  }
+
+  /** @brief 添加一个实体, 并发模式下余量用完时返回空指针 */
+  Entity * try_add_entity()
   {
     uint32_t idx = Base::add_index();
+    if(idx == uint32_t(-1))
+      return nullptr;
     entity_->get(idx).set_index(idx);
-    return entity_->get(idx);
+    return &entity_->get(idx);
   }
 
   void delete_entity(Entity & e)
   {
-    delete_index(e->index());
+    Base::delete_index(e.index());
   }
 
+  /**
+   * @brief 更新实体的紧凑编号, 只重新编号上次更新之后被修改过的位置
+   */
   void update()
   {
-    entity_ = Base::template get_data<Entity>("entity");
-    indices_ = Base::template get_data<uint32_t>("indices");
-    uint32_t N = 0;
-    for(auto & idx : *indices_)
-      idx = N++;
+    auto & data = Base::data();
+    entity_ = std::static_pointer_cast<DataArray<Entity> >(data[Builtin::entity.key()]);
+    indices_ = std::static_pointer_cast<DataArray<uint32_t> >(data[Builtin::indices.key()]);
+
+    /** dirty_begin 之前的编号没有变化, 从它前面最后一个实体的编号接着编号 */
+    auto & indices = *indices_;
+    uint32_t prev = Base::is_free()->find_prev_false(Base::dirty_begin());
+    uint32_t N = prev == uint32_t(-1) ? 0 : indices[prev]+1;
+    Base::for_each_index(Base::dirty_begin(), [&](uint32_t i) { indices[i] = N++; });
+    Base::clear_dirty();
   }
 
   void clear()
   {
     Base::clear();
-    entity_ = Base::template add_data<Entity>("entity");
-    indices_ = Base::template add_data<uint32_t>("indices");
+    add_builtin_data();
   }
 
   Self & operator = (Self & other)
@@ -230,6 +610,27 @@ public:
     return *this;
   }
 
+  /**
+   * @brief 重排实体和数据, 见 DataContainer::permute, 重排后实体的编号就是存储位置
+   */
+  void permute(const uint32_t * order, uint32_t n)
+  {
+    Base::permute(order, n);
+    for(uint32_t i = 0; i < n; i++)
+      entity_->get(i).set_index(i);
+    update();
+  }
+
+private:
+  /** 按 EntityBuiltinData 中的编号添加内置数据 */
+  void add_builtin_data()
+  {
+    entity_ = Base::template add_data<Entity>("entity");
+    indices_ = Base::template add_data<uint32_t>("indices");
+    assert(Base::key_of("entity") == Builtin::entity.key());
+    assert(Base::key_of("indices") == Builtin::indices.key());
+  }
+
 private:
   std::shared_ptr<DataArray<Entity> > entity_;
   std::shared_ptr<DataArray<uint32_t> > indices_;
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "view.h"
+#include "entity_storage.h"
 
 namespace HEM
 {
@@ -19,20 +20,27 @@ public:
   using Point  = typename Traits::Point;
   using Vector = typename Traits::Vector;
 
+  using Storage = typename Traits::Storage;
+  template<typename Entity>
+  using Link = typename Storage::template Link<Entity>;
+
 public:
   THalfEdge(uint32_t index=0) : 
-    next_(nullptr), prev_(nullptr), oppo_((HalfEdge*)this), cell_(nullptr), 
-    edge_(nullptr), node_(nullptr), index_(index)  
-  {}
+    next_(link<HalfEdge>(nullptr)), prev_(link<HalfEdge>(nullptr)), 
+    oppo_(link<HalfEdge>(nullptr)), cell_(link<Cell>(nullptr)), 
+    edge_(link<Edge>(nullptr)), node_(link<Node>(nullptr)), index_(index)  
+  {
+    oppo_ = link((HalfEdge*)this);
+  }
 
   /** 数据接口 */
-  HalfEdge * next() {return next_;}
+  HalfEdge * next() {return get<HalfEdge>(next_);}
 
-  HalfEdge * previous() {return prev_;}
+  HalfEdge * previous() {return get<HalfEdge>(prev_);}
 
-  HalfEdge * opposite() {return oppo_;}
+  HalfEdge * opposite() {return get<HalfEdge>(oppo_);}
 
-  HalfEdge * halfedge() {return this;}
+  HalfEdge * halfedge() {return static_cast<HalfEdge *>(this);}
 
   HalfEdge * next(uint32_t i) 
   {
@@ -48,70 +56,70 @@ public:
     return h;
   }
 
-  Cell * cell() {return cell_;}
+  Cell * cell() {return get<Cell>(cell_);}
 
-  Edge * edge() {return edge_;}
+  Edge * edge() {return get<Edge>(edge_);}
 
-  Node * node() {return node_;}
+  Node * node() {return get<Node>(node_);}
 
   uint32_t & index() { return index_;}
 
-  HalfEdge * next_oppo() {return next_->opposite();}
+  HalfEdge * next_oppo() {return next()->opposite();}
 
-  HalfEdge * oppo_prev() {return oppo_->previous();}
+  HalfEdge * oppo_prev() {return opposite()->previous();}
 
   /** const 数据接口 */
-  const HalfEdge * next() const {return next_;}
+  const HalfEdge * next() const {return get<HalfEdge>(next_);}
 
-  const HalfEdge * previous() const {return prev_;}
+  const HalfEdge * previous() const {return get<HalfEdge>(prev_);}
 
-  const HalfEdge * opposite() const {return oppo_;}
+  const HalfEdge * opposite() const {return get<HalfEdge>(oppo_);}
 
-  const HalfEdge * halfedge() const {return this;}
+  const HalfEdge * halfedge() const {return static_cast<const HalfEdge *>(this);}
 
-  const Cell * cell() const {return cell_;}
+  const Cell * cell() const {return get<Cell>(cell_);}
 
-  const Edge * edge() const {return edge_;}
+  const Edge * edge() const {return get<Edge>(edge_);}
 
-  const Node * node() const {return node_;}
+  const Node * node() const {return get<Node>(node_);}
 
   const uint32_t & index() const { return index_;}
 
-  const HalfEdge * next_oppo() const {return next_->opposite();}
+  const HalfEdge * next_oppo() const {return next()->opposite();}
 
-  const HalfEdge * oppo_prev() const {return oppo_->previous();}
+  const HalfEdge * oppo_prev() const {return opposite()->previous();}
 
   template<typename Entity>
   Entity & entity()
   {
     if constexpr (std::is_same_v<Entity, Cell>)
-      return cell_;
+      return *cell();
     else if constexpr (std::is_same_v<Entity, Edge>)
-      return edge_;
+      return *edge();
     else if constexpr (std::is_same_v<Entity, Node>)
-      return node_;
+      return *node();
   }
 
   /** 设置数据 */
-  void set_next(HalfEdge * next) {next_ = next;}
+  void set_next(HalfEdge * next) {next_ = link(next);}
 
-  void set_previous(HalfEdge * prev) {prev_ = prev;}
+  void set_previous(HalfEdge * prev) {prev_ = link(prev);}
 
-  void set_opposite(HalfEdge * oppo) {oppo_ = oppo;}
+  void set_opposite(HalfEdge * oppo) {oppo_ = link(oppo);}
 
-  void set_node(Node * node) {node_ = node;}
+  void set_node(Node * node) {node_ = link(node);}
 
-  void set_edge(Edge * edge) {edge_ = edge;}
+  void set_edge(Edge * edge) {edge_ = link(edge);}
 
-  void set_cell(Cell * cell) {cell_ = cell;}
+  void set_cell(Cell * cell) {cell_ = link(cell);}
 
   void set_index(uint32_t index) {index_=index;}
 
   void reset(HalfEdge * next, HalfEdge * prev, HalfEdge * oppo, 
       Cell * cell, Edge * edge, Node * node, uint32_t index)
   {
-    next_ = next; prev_ = prev; oppo_ = oppo;
-    cell_ = cell; edge_ = edge; node_ = node;
+    next_ = link(next); prev_ = link(prev); oppo_ = link(oppo);
+    cell_ = link(cell); edge_ = link(edge); node_ = link(node);
     index_ = index;
   }
 
@@ -126,7 +134,7 @@ public:
     return *this;
   }
 
-  bool is_boundary() { return this==oppo_;}
+  bool is_boundary() const { return halfedge()==opposite();}
 
   /** h 到 self 需要 next 的次数 */
   uint8_t distance(HalfEdge * h)
@@ -147,13 +155,24 @@ public:
 
   Point barycenter();
 
+private:
+  /** 由存储的连接得到实体 */
+  template<typename Entity>
+  Entity * get(Link<Entity> l) const 
+  { 
+    return Storage::template get<Entity>(static_cast<const HalfEdge *>(this), l);
+  }
+
+  template<typename Entity>
+  static Link<Entity> link(Entity * e) { return Storage::template link<Entity>(e); }
+
 private:
   /** 下一条半边, 上一条半边, 对边 */
-  HalfEdge * next_, * prev_, * oppo_;
+  Link<HalfEdge> next_, prev_, oppo_;
 
-  Cell * cell_; /**< 所属单元*/ 
-  Edge * edge_; /**< 所在边*/
-  Node * node_; /**< 指向顶点 */
+  Link<Cell> cell_; /**< 所属单元*/ 
+  Link<Edge> edge_; /**< 所在边*/
+  Link<Node> node_; /**< 指向顶点 */
   uint32_t index_; /**< 半边的存储编号 */ 
 };
 
@@ -231,21 +250,25 @@ public:
   using AdjCellView = AdjEntityViewBase<AdjCellIterator<HalfEdge, Cell>>;
   using ConstAdjCellView = AdjEntityViewBase<AdjCellIterator<const HalfEdge, const Cell>>;
 
+  using Storage = typename Traits::Storage;
+  template<typename Entity>
+  using Link = typename Storage::template Link<Entity>;
+
 public:
-  TNode(uint32_t index = -1): start_(nullptr), index_(index), coordinate_(0.0, 0.0) {}
+  TNode(uint32_t index = -1): start_(link(nullptr)), index_(index), coordinate_(0.0, 0.0) {}
 
   TNode(Point & coordinate, uint32_t index, HalfEdge * h = nullptr): 
-    start_(h), index_(index), coordinate_(coordinate)
+    start_(link(h)), index_(index), coordinate_(coordinate)
   {}
 
   /** 获取数据 */
-  HalfEdge * halfedge() { return start_; }
+  HalfEdge * halfedge() { return start(); }
 
   uint32_t & index() { return index_; }
 
   Point & coordinate() { return coordinate_;}
 
-  const HalfEdge * halfedge() const { return start_; }
+  const HalfEdge * halfedge() const { return start(); }
 
   const uint32_t & index() const { return index_; }
 
@@ -254,24 +277,24 @@ public:
   /** 设置数据 */
   void set_coordinate(const Point & p) { coordinate_ = p;}
 
-  void set_halfedge(HalfEdge * h) { start_ = h;}
+  void set_halfedge(HalfEdge * h) { start_ = link(h);}
 
   void set_index(uint32_t index) { index_ = index;}
 
   void reset(const Point & p, uint32_t index, HalfEdge * h) 
   { 
     index_ = index; 
-    start_ = h; 
+    start_ = link(h); 
     coordinate_ = p;
   }
 
   uint32_t adj_cell(Cell ** n2c);
 
-  AdjNodeView adj_nodes() const { return AdjNodeView(start_); }
+  AdjNodeView adj_nodes() const { return AdjNodeView(start()); }
 
-  AdjEdgeView adj_edges() const { return AdjEdgeView(start_); }
+  AdjEdgeView adj_edges() const { return AdjEdgeView(start()); }
 
-  AdjCellView adj_cells() const { return AdjCellView(start_); }
+  AdjCellView adj_cells() const { return AdjCellView(start()); }
 
   Node & operator=(const Node & other)
   {
@@ -285,7 +308,15 @@ public:
   }
 
 private:
-  HalfEdge * start_;
+  HalfEdge * start() const 
+  { 
+    return Storage::template get<HalfEdge>(static_cast<const Node *>(this), start_); 
+  }
+
+  static Link<HalfEdge> link(HalfEdge * h) { return Storage::template link<HalfEdge>(h); }
+
+private:
+  Link<HalfEdge> start_;
   uint32_t index_;
   Point coordinate_;
 };
@@ -305,20 +336,26 @@ public:
   using Point  = typename Traits::Point;
   using Vector = typename Traits::Vector;
 
+  using Storage = typename Traits::Storage;
+  template<typename Entity>
+  using Link = typename Storage::template Link<Entity>;
+
 public:
-  TEdge(uint32_t index=-1, HalfEdge * h = nullptr): start_(h), index_(index) {}
+  TEdge(uint32_t index=-1, HalfEdge * h = nullptr): start_(link(h)), index_(index) {}
 
-  HalfEdge * halfedge() { return start_; }
+  HalfEdge * halfedge() { return start(); }
 
   uint32_t & index() { return index_; }
 
-  const HalfEdge * halfedge() const { return start_; }
+  const HalfEdge * halfedge() const { return start(); }
+
+  const uint32_t & index() const { return index_; }
 
-  void set_halfedge(HalfEdge * h) { start_ = h;}
+  void set_halfedge(HalfEdge * h) { start_ = link(h);}
 
   void set_index(uint32_t index) { index_ = index;}
 
-  void reset(uint32_t index, HalfEdge * h) { index_ = index; start_ = h; }
+  void reset(uint32_t index, HalfEdge * h) { index_ = index; start_ = link(h); }
 
   /** 获取边的邻接关系 */
   void get_top(Node ** e2n, Cell ** e2c, uint8_t * e2cidx);
@@ -331,7 +368,7 @@ public:
 
   bool has_node(Node * n) const
   {
-    return start_->node() == n || start_->previous()->node() == n;
+    return start()->node() == n || start()->previous()->node() == n;
   }
 
   Edge & operator=(const Edge & other)
@@ -353,7 +390,15 @@ public:
   double length(); 
 
 private:
-  HalfEdge * start_;
+  HalfEdge * start() const 
+  { 
+    return Storage::template get<HalfEdge>(static_cast<const Edge *>(this), start_); 
+  }
+
+  static Link<HalfEdge> link(HalfEdge * h) { return Storage::template link<HalfEdge>(h); }
+
+private:
+  Link<HalfEdge> start_;
   uint32_t index_;
 };
 
@@ -446,22 +491,26 @@ public:
   using AdjCellView = AdjEntityViewBase<AdjCellIterator<HalfEdge, Cell>>;
   using ConstAdjCellView = AdjEntityViewBase<AdjCellIterator<const HalfEdge, const Cell>>;
 
+  using Storage = typename Traits::Storage;
+  template<typename Entity>
+  using Link = typename Storage::template Link<Entity>;
+
 public:
-  TCell(uint32_t index = -1, HalfEdge * h = nullptr): start_(h), index_(index) {}
+  TCell(uint32_t index = -1, HalfEdge * h = nullptr): start_(link(h)), index_(index) {}
 
-  HalfEdge * halfedge() { return start_; }
+  HalfEdge * halfedge() { return start(); }
 
   uint32_t & index() { return index_; }
 
-  const HalfEdge * halfedge() const { return start_; }
+  const HalfEdge * halfedge() const { return start(); }
 
   const uint32_t & index() const { return index_; }
 
-  void set_halfedge(HalfEdge * h) { start_ = h;}
+  void set_halfedge(HalfEdge * h) { start_ = link(h);}
 
   void set_index(uint32_t index) { index_ = index;}
 
-  void reset(uint32_t index, HalfEdge * h) { index_ = index; start_ = h; }
+  void reset(uint32_t index, HalfEdge * h) { index_ = index; start_ = link(h); }
 
   /** 获取单元的邻接关系 */
   uint32_t get_top(Node ** c2n, Edge ** c2e, Cell ** c2c);
@@ -481,19 +530,19 @@ public:
   /** 单元第 i 个邻接边 */
   Edge * adj_edge(uint32_t i) const 
   { 
-    return start_->next(i)->edge(); 
+    return start()->next(i)->edge(); 
   }
 
   /** 单元第 i 个邻接点 */
   Node * adj_node(uint32_t i) const 
   { 
-    return start_->previous()->next(i)->node(); 
+    return start()->previous()->next(i)->node(); 
   }
 
   /** 单元第 i 个邻接单元 */
   Cell * adj_cell(uint32_t i) const
   { 
-    return start_->next(i)->opposite()->cell(); 
+    return start()->next(i)->opposite()->cell(); 
   }
 
   /** 单元第 i 个顶点的坐标 */
@@ -502,21 +551,21 @@ public:
     return &(adj_node(i)->coordinate());
   }
 
-  AdjNodeView adj_nodes() { return AdjNodeView(start_->previous()); }
+  AdjNodeView adj_nodes() { return AdjNodeView(start()->previous()); }
 
-  AdjHalfEdgeView adj_halfedges() { return AdjHalfEdgeView(start_); }
+  AdjHalfEdgeView adj_halfedges() { return AdjHalfEdgeView(start()); }
 
-  AdjEdgeView adj_edges() { return AdjEdgeView(start_); }
+  AdjEdgeView adj_edges() { return AdjEdgeView(start()); }
 
-  AdjCellView adj_cells() { return AdjCellView(start_); }
+  AdjCellView adj_cells() { return AdjCellView(start()); }
 
-  ConstAdjNodeView adj_nodes() const { return ConstAdjNodeView(start_->previous()); }
+  ConstAdjNodeView adj_nodes() const { return ConstAdjNodeView(start()->previous()); }
 
-  ConstAdjHalfEdgeView adj_halfedges() const { return ConstAdjHalfEdgeView(start_); }
+  ConstAdjHalfEdgeView adj_halfedges() const { return ConstAdjHalfEdgeView(start()); }
 
-  ConstAdjEdgeView adj_edges() const { return ConstAdjEdgeView(start_); }
+  ConstAdjEdgeView adj_edges() const { return ConstAdjEdgeView(start()); }
 
-  ConstAdjCellView adj_cells() const { return ConstAdjCellView(start_); }
+  ConstAdjCellView adj_cells() const { return ConstAdjCellView(start()); }
 
   Cell & operator=(const Cell & other)
   {
@@ -534,8 +583,9 @@ public:
   Point barycenter() const
   {
     uint8_t n = 1;
-    Point p = start_->node()->coordinate();
-    for(HalfEdge * h = start_->next(); h != start_; h = h->next(), n++)
+    HalfEdge * start = this->start();
+    Point p = start->node()->coordinate();
+    for(HalfEdge * h = start->next(); h != start; h = h->next(), n++)
       p += h->node()->coordinate(); 
     return p/n; 
   }
@@ -543,7 +593,15 @@ public:
   double area();
 
 private:
-  HalfEdge * start_;
+  HalfEdge * start() const 
+  { 
+    return Storage::template get<HalfEdge>(static_cast<const Cell *>(this), start_); 
+  }
+
+  static Link<HalfEdge> link(HalfEdge * h) { return Storage::template link<HalfEdge>(h); }
+
+private:
+  Link<HalfEdge> start_;
   uint32_t index_;
 };
 
@@ -553,8 +611,8 @@ private:
 template<typename Traits>
 inline bool THalfEdge<Traits>::is_on_the_left(const Point & p)
 {
-  Vector v0 = node_->coordinate()-prev_->node()->coordinate();
-  Vector v1 = p-prev_->node()->coordinate();
+  Vector v0 = node()->coordinate()-previous()->node()->coordinate();
+  Vector v1 = p-previous()->node()->coordinate();
   return v0.cross(v1)>0;
 }
 
@@ -588,8 +646,8 @@ template<typename Traits>
 inline uint32_t TNode<Traits>::adj_cell(Cell ** n2c)
 {
   uint32_t N = 1;
-  n2c[0] = start_->cell(); 
-  for(HalfEdge * h = start_->next_oppo(); h != start_ && !h->is_boundary(); 
+  n2c[0] = start()->cell(); 
+  for(HalfEdge * h = start()->next_oppo(); h != start() && !h->is_boundary(); 
       h = h->next_oppo())
   {
     n2c[N++] = h->cell(); 
@@ -601,59 +659,59 @@ inline uint32_t TNode<Traits>::adj_cell(Cell ** n2c)
 template<typename Traits>
 inline void TEdge<Traits>::get_top(Node ** e2n, Cell ** e2c, uint8_t * e2cidx)
 {
-  e2n[0] = start_->previous()->node();
-  e2n[1] = start_->node();
-  e2c[0] = start_->cell(); 
-  e2c[1] = start_->cell(); 
-  e2cidx[0] = start_->distance(start_->cell()->halfedge());
-  e2cidx[1] = start_->opposite()->distance(start_->opposite()->cell()->halfedge());
+  e2n[0] = start()->previous()->node();
+  e2n[1] = start()->node();
+  e2c[0] = start()->cell(); 
+  e2c[1] = start()->cell(); 
+  e2cidx[0] = start()->distance(start()->cell()->halfedge());
+  e2cidx[1] = start()->opposite()->distance(start()->opposite()->cell()->halfedge());
 }
 
 template<typename Traits>
 inline uint32_t TEdge<Traits>::adj_cell(Cell ** e2c)
 {
-  e2c[0] = start_->cell(); 
-  e2c[1] = start_->opposite()->cell(); 
+  e2c[0] = start()->cell(); 
+  e2c[1] = start()->opposite()->cell(); 
   return 2;
 }
 
 template<typename Traits>
 inline uint32_t TEdge<Traits>::adj_node(Node ** e2n)
 {
-  e2n[0] = start_->previous()->node();
-  e2n[1] = start_->node();
+  e2n[0] = start()->previous()->node();
+  e2n[1] = start()->node();
   return 2;
 }
 
 template<typename Traits>
 inline void TEdge<Traits>::vertices(Point ** vertices) const
 {
-  vertices[0] = &start_->previous()->node()->coordinate();
-  vertices[1] = &start_->node()->coordinate();
+  vertices[0] = &start()->previous()->node()->coordinate();
+  vertices[1] = &start()->node()->coordinate();
 }
 
 template<typename Traits>
 inline double TEdge<Traits>::length()
 {
-  return start_->length();
+  return start()->length();
 }
 
 template<typename Traits>
 inline typename TEdge<Traits>::Vector TEdge<Traits>::tangential() const 
 {
-  return start_->tangential();
+  return start()->tangential();
 }
 
 template<typename Traits>
 inline typename TEdge<Traits>::Vector TEdge<Traits>::normal() const 
 {
-  return start_->normal(); 
+  return start()->normal(); 
 }
 
 template<typename Traits>
 inline typename TEdge<Traits>::Point TEdge<Traits>::barycenter() const
 {
-  return start_->barycenter(); 
+  return start()->barycenter(); 
 }
 
 
@@ -662,10 +720,10 @@ template<typename Traits>
 uint32_t TCell<Traits>::get_top(Node ** c2n, Edge ** c2e, Cell ** c2c)
 {
   uint32_t N = 0;
-  c2n[N] = start_->node();
-  c2e[N] = start_->edge(); 
-  c2c[N++] = start_->cell(); 
-  for(HalfEdge * h = start_->next(); h != start_; h = h->next())
+  c2n[N] = start()->node();
+  c2e[N] = start()->edge(); 
+  c2c[N++] = start()->cell(); 
+  for(HalfEdge * h = start()->next(); h != start(); h = h->next())
   {
     c2n[N] = h->node();
     c2e[N] = h->edge(); 
@@ -678,8 +736,8 @@ template<typename Traits>
 uint32_t TCell<Traits>::adj_edge(Edge ** c2e)
 {
   uint32_t N = 0;
-  c2e[N++] = start_->edge(); 
-  for(HalfEdge * h = start_->next(); h != start_; h = h->next())
+  c2e[N++] = start()->edge(); 
+  for(HalfEdge * h = start()->next(); h != start(); h = h->next())
     c2e[N++] = h->edge(); 
   return N;
 }
@@ -688,8 +746,8 @@ template<typename Traits>
 uint32_t TCell<Traits>::adj_node(Node ** c2n)
 {
   uint32_t N = 0;
-  c2n[N++] = start_->previous()->node(); 
-  for(HalfEdge * h = start_; h != start_->previous(); h = h->next())
+  c2n[N++] = start()->previous()->node(); 
+  for(HalfEdge * h = start(); h != start()->previous(); h = h->next())
     c2n[N++] = h->node(); 
   return N;
 }
@@ -698,9 +756,9 @@ template<typename Traits>
 uint32_t TCell<Traits>::adj_cell(Cell ** c2c)
 {
   uint32_t N = 0;
-  c2c[N++] = start_->cell(); 
-  for(HalfEdge * h = start_->next(); h != start_; h = h->next())
-    c2c[N++] = h->cell(); 
+  c2c[N++] = start()->opposite()->cell(); 
+  for(HalfEdge * h = start()->next(); h != start(); h = h->next())
+    c2c[N++] = h->opposite()->cell(); 
   return N;
 }
 
@@ -708,8 +766,8 @@ template <typename Traits>
 uint32_t TCell<Traits>::vertices(Point ** vertices) const
 {
   uint32_t N = 0;
-  vertices[N++] = &start_->previous()->node()->coordinate();
-  for(HalfEdge * h = start_; h != start_->previous(); h = h->next())
+  vertices[N++] = &start()->previous()->node()->coordinate();
+  for(HalfEdge * h = start(); h != start()->previous(); h = h->next())
     vertices[N++] = &h->node()->coordinate();
   return N;
 }
@@ -717,11 +775,11 @@ uint32_t TCell<Traits>::vertices(Point ** vertices) const
 template<typename Traits>
 double TCell<Traits>::area()
 {
-  Point p0 = start_->previous()->node()->coordinate();
-  Vector v0 = start_->node()->coordinate()-p0;
-  Vector v1 = start_->next()->node()->coordinate()-p0;
+  Point p0 = start()->previous()->node()->coordinate();
+  Vector v0 = start()->node()->coordinate()-p0;
+  Vector v1 = start()->next()->node()->coordinate()-p0;
   double a = v0.cross(v1);
-  for(HalfEdge * h = start_->next()->next(); h != start_->previous(); h = h->next())
+  for(HalfEdge * h = start()->next()->next(); h != start()->previous(); h = h->next())
   {
     v0 = v1;
     v1 = h->node()->coordinate()-p0;
@@ -735,7 +793,7 @@ template<typename Traits>
 typename TCell<Traits>::Point TCell<Traits>::inner_point() const
 {
   Point p(0, 0);
-  for(HalfEdge* h = start_->next(); h != start_; h = h->next())
+  for(HalfEdge* h = start()->next(); h != start(); h = h->next())
   {
     if(h->tangential().cross(h->next()->tangential())>0)
     {
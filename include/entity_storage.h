@@ -0,0 +1,103 @@
+#ifndef ENTITY_STORAGE_H
+#define ENTITY_STORAGE_H
+
+#include <stdint.h>
+#include <type_traits>
+
+#include "chunk_array.h"
+
+namespace HEM
+{
+
+/**
+ * @brief 指针存储模式: 实体之间的连接关系直接存储为指针
+ */
+template<typename Traits>
+class PointerStorage
+{
+public:
+  template<typename Entity>
+  using Link = Entity *;
+
+  /** 连接关系与实体的内存地址有关, 复制网格后需要重新设置指针 */
+  constexpr static bool is_relocatable = false;
+
+  /** 指针存储不需要上下文 */
+  struct Context {};
+
+  template<typename Entity, typename Self>
+  static Entity * get(const Self *, Link<Entity> l) { return l; }
+
+  template<typename Entity>
+  static Link<Entity> link(Entity * e) { return e; }
+};
+
+/**
+ * @brief 编号存储模式: 实体之间的连接关系存储为实体在 ChunkArray 中的 32 位编号
+ * @note 1. 通过实体所在块的块头找到网格的 Context, 再由编号得到实体,
+ *          所以实体的 index() 必须是它在 ChunkArray 中的存储编号。
+ *       2. 实体中没有指针, 网格可以直接按内存复制、移动和序列化,
+ *          之后只需要调用 HalfEdgeMeshBase::bind_storage() 重写块头。
+ */
+template<typename Traits>
+class IndexStorage
+{
+public:
+  using Node = typename Traits::Node;
+  using Edge = typename Traits::Edge;
+  using Cell = typename Traits::Cell;
+  using HalfEdge = typename Traits::HalfEdge;
+
+  constexpr static uint32_t ChunkSize = Traits::ChunkSize;
+
+  template<typename Entity>
+  using Link = uint32_t;
+
+  constexpr static bool is_relocatable = true;
+
+  /** 空的连接 */
+  constexpr static uint32_t null = -1;
+
+  /**
+   * @brief 存储在实体数组块头中的上下文, 指向网格的四个实体数组
+   */
+  struct Context
+  {
+    ChunkArray<Node, ChunkSize> * node = nullptr;
+    ChunkArray<Edge, ChunkSize> * edge = nullptr;
+    ChunkArray<Cell, ChunkSize> * cell = nullptr;
+    ChunkArray<HalfEdge, ChunkSize> * halfedge = nullptr;
+
+    template<typename Entity>
+    ChunkArray<Entity, ChunkSize> & array()
+    {
+      if constexpr (std::is_same_v<Entity, Node>)
+        return *node;
+      else if constexpr (std::is_same_v<Entity, Edge>)
+        return *edge;
+      else if constexpr (std::is_same_v<Entity, Cell>)
+        return *cell;
+      else
+        return *halfedge;
+    }
+  };
+
+  /**
+   * @brief 获取 self 中编号为 l 的连接所指向的实体
+   */
+  template<typename Entity, typename Self>
+  static Entity * get(const Self * self, Link<Entity> l)
+  {
+    if(l == null)
+      return nullptr;
+    void * ctx = ChunkArray<Self, ChunkSize>::context_of(self, self->index());
+    return &(static_cast<Context *>(ctx)->template array<Entity>()[l]);
+  }
+
+  template<typename Entity>
+  static Link<Entity> link(const Entity * e) { return e ? e->index() : null; }
+};
+
+}
+
+#endif // ENTITY_STORAGE_H
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <vector>
+#include <algorithm>
 
 #include "irregular_array2d.h"
 
@@ -14,21 +15,33 @@ class FindPointAlgorithmBase
 {
 public:
   using Point = typename Mesh::Point;
+  using Cell = typename Mesh::Cell;
 
 public:
   FindPointAlgorithmBase(std::shared_ptr<Mesh> mesh) : mesh_(mesh) {}
 public:
 
-  void find_point(const Point & query_point)
+  /** @brief 点所在的单元, 点在网格外面时返回空 */
+  Cell * find_point(const Point & query_point)
   {
-    static_cast<Derived*>(this)->find_point_imp(query_point);
+    return static_cast<Derived*>(this)->find_point_imp(query_point);
   }
 
+  /** @brief 由整个网格重新建立索引 */
   void update()
   {
     static_cast<Derived*>(this)->update_imp();
   }
 
+  /**
+   * @brief 增量更新: cells 是新增加的单元和形状改变了的单元,
+   *   例如 splite_cell 的两个单元
+   */
+  void update(const std::vector<Cell *> & cells)
+  {
+    static_cast<Derived*>(this)->update_imp(cells);
+  }
+
   std::shared_ptr<Mesh> get_mesh() { return mesh_; }
 
 protected:
@@ -36,18 +49,302 @@ protected:
 };
 
 /**
- * @brief The KDTreeFindPointAlg class
- * This class is used to find the nearest point in a mesh using a KDTree
- * @todo TODO
+ * @brief 单元包围盒的四叉树
+ * @note 1. 叶子中存放与它相交的单元的存储位置, 一个单元可以在多个叶子中。
+ *          叶子中的单元超过 leaf_size 个时分成四个子节点, 所以加密的地方树更深,
+ *          查找只需要从根走到点所在的叶子, 再检查叶子中的几个单元。
+ *          叶子中的单元无法分开时容量加倍, 见 split。
+ *       2. 根节点是建立索引时网格的包围盒, 增量更新的单元超出根节点时重新建立索引。
+ *       3. 包围盒向外扩大了几何容差, 与 GeometryUtils2D 判断点在边上的结果一致。
  */
 template <typename Mesh>
-class KDTreeFindPointAlg : public FindPointAlgorithmBase<KDTreeFindPointAlg<Mesh>, Mesh>
+class QuadTreeFindPointAlg : public FindPointAlgorithmBase<QuadTreeFindPointAlg<Mesh>, Mesh>
 {
 public:
-  using Base = FindPointAlgorithmBase<KDTreeFindPointAlg<Mesh>, Mesh>;
+  using Base = FindPointAlgorithmBase<QuadTreeFindPointAlg<Mesh>, Mesh>;
+  using Base::find_point;
+  using Base::update;
+
+  using Cell = typename Mesh::Cell;
+  using HalfEdge = typename Mesh::HalfEdge;
+  using Point  = typename Mesh::Point;
+
+private:
+  struct Box
+  {
+    double x0, y0, x1, y1;
+
+    bool contains(const Point & p) const
+    {
+      return p.x >= x0 && p.x <= x1 && p.y >= y0 && p.y <= y1;
+    }
+
+    bool contains(const Box & b) const
+    {
+      return b.x0 >= x0 && b.x1 <= x1 && b.y0 >= y0 && b.y1 <= y1;
+    }
+
+    bool overlaps(const Box & b) const
+    {
+      return b.x0 <= x1 && b.x1 >= x0 && b.y0 <= y1 && b.y1 >= y0;
+    }
+  };
+
+  /**
+   * @brief 四叉树的节点, child 是第一个子节点的位置, 四个子节点连续存放,
+   *   依次为左下, 左上, 右下, 右上; 叶子的 child 为 -1
+   */
+  struct TreeNode
+  {
+    Box box;
+    int32_t child;
+    uint32_t depth;
+    uint32_t capacity; /**< 叶子中的单元超过这个数时分开 */
+    std::vector<uint32_t> items;
+  };
 
 public:
-  KDTreeFindPointAlg(const Mesh& mesh) : Base(mesh) {}
+  QuadTreeFindPointAlg(std::shared_ptr<Mesh> mesh, uint32_t leaf_size = 8, uint32_t max_depth = 24) :
+    Base(mesh), leaf_size_(leaf_size), max_depth_(max_depth)
+  {
+    update_imp();
+  }
+
+  /**
+   * @brief 查找点所在的单元, 参数和返回值与 UniformMeshCut::find_point 相同
+   * @note 点在几个单元的公共边或顶点上时返回其中一个
+   */
+  uint32_t find_point(const Point & p, Cell* & out, uint32_t & index) const
+  {
+    out = nullptr;
+    if(tree_.empty() || !tree_[0].box.contains(p))
+      return 3;
+
+    const TreeNode * n = &tree_[0];
+    while(n->child >= 0)
+    {
+      const Box & b = n->box;
+      int k = 2*(p.x >= 0.5*(b.x0+b.x1)) + (p.y >= 0.5*(b.y0+b.y1));
+      n = &tree_[n->child+k];
+    }
+
+    auto & cell = *(Base::mesh_->get_cell());
+    auto & geo = Base::mesh_->geometry_utils();
+    Point * points[32];
+    for(uint32_t i : n->items)
+    {
+      if(!box_[i].contains(p))
+        continue;
+      uint32_t N = cell[i].vertices(points);
+      uint32_t flag = geo.relative_position_of_point_and_polygon({points, N}, p, index);
+      if(flag != 3)
+      {
+        out = &cell[i];
+        return flag;
+      }
+    }
+    return 3;
+  }
+
+  Cell * find_point_imp(const Point & p) const
+  {
+    Cell * out;
+    uint32_t index;
+    find_point(p, out, index);
+    return out;
+  }
+
+  /**
+   * @brief 由网格中所有的单元重新建立四叉树
+   */
+  void update_imp()
+  {
+    auto & mesh = *Base::mesh_;
+    tree_.clear();
+    box_.clear();
+    in_tree_.clear();
+
+    Box root = {1e300, 1e300, -1e300, -1e300};
+    for(auto & n : *mesh.get_node())
+    {
+      const Point & p = n.coordinate();
+      root.x0 = std::min(root.x0, p.x);
+      root.y0 = std::min(root.y0, p.y);
+      root.x1 = std::max(root.x1, p.x);
+      root.y1 = std::max(root.y1, p.y);
+    }
+    if(root.x0 > root.x1)
+      return;
+    double eps = mesh.geometry_utils().tolerance();
+    tree_.push_back({{root.x0-eps, root.y0-eps, root.x1+eps, root.y1+eps}, -1, 0, leaf_size_, {}});
+
+    for(auto & c : *mesh.get_cell())
+      insert(&c);
+  }
+
+  /**
+   * @brief 增量更新, 先把 cells 从原来所在的叶子中去掉, 再按新的包围盒插入
+   */
+  void update_imp(const std::vector<Cell *> & cells)
+  {
+    if(tree_.empty())
+      return update_imp();
+    for(Cell * c : cells)
+    {
+      if(!tree_[0].box.contains(bounding_box(c)))
+        return update_imp();
+      remove(c);
+      insert(c);
+    }
+  }
+
+  /** @brief 单元 c 被删除之前, 把它从四叉树中去掉 */
+  void remove(Cell * c)
+  {
+    uint32_t i = c->index();
+    if(i >= in_tree_.size() || !in_tree_[i])
+      return;
+    for_each_leaf(box_[i], [i](TreeNode & n)
+    {
+      auto it = std::find(n.items.begin(), n.items.end(), i);
+      if(it != n.items.end())
+      {
+        *it = n.items.back();
+        n.items.pop_back();
+      }
+    });
+    in_tree_[i] = false;
+  }
+
+  /** @brief 四叉树的最大深度 */
+  uint32_t depth() const
+  {
+    uint32_t d = 0;
+    for(auto & n : tree_)
+      d = std::max(d, n.depth);
+    return d;
+  }
+
+  uint32_t number_of_tree_nodes() const { return tree_.size(); }
+
+private:
+  /** @brief 单元的包围盒, 向外扩大几何容差 */
+  Box bounding_box(const Cell * c) const
+  {
+    const HalfEdge * h0 = c->halfedge();
+    const Point & p0 = h0->node()->coordinate();
+    Box b = {p0.x, p0.y, p0.x, p0.y};
+    for(const HalfEdge * h = h0->next(); h != h0; h = h->next())
+    {
+      const Point & p = h->node()->coordinate();
+      b.x0 = std::min(b.x0, p.x);
+      b.y0 = std::min(b.y0, p.y);
+      b.x1 = std::max(b.x1, p.x);
+      b.y1 = std::max(b.y1, p.y);
+    }
+    double eps = Base::mesh_->geometry_utils().tolerance();
+    return {b.x0-eps, b.y0-eps, b.x1+eps, b.y1+eps};
+  }
+
+  void insert(Cell * c)
+  {
+    uint32_t i = c->index();
+    if(i >= box_.size())
+    {
+      box_.resize(i+1);
+      in_tree_.resize(i+1, false);
+    }
+    box_[i] = bounding_box(c);
+    in_tree_[i] = true;
+
+    std::vector<uint32_t> full;
+    for_each_leaf(box_[i], [this, i, &full](TreeNode & n)
+    {
+      n.items.push_back(i);
+      if(is_full(n))
+        full.push_back(&n - tree_.data());
+    });
+    for(uint32_t k : full)
+      split(k);
+  }
+
+  /** @brief 对与 b 相交的每个叶子调用 f */
+  template<typename F>
+  void for_each_leaf(const Box & b, const F & f)
+  {
+    std::vector<uint32_t> stack = {0};
+    while(!stack.empty())
+    {
+      TreeNode & n = tree_[stack.back()];
+      stack.pop_back();
+      if(!n.box.overlaps(b))
+        continue;
+      if(n.child < 0)
+        f(n);
+      else
+        for(int k = 0; k < 4; k++)
+          stack.push_back(n.child+k);
+    }
+  }
+
+  /**
+   * @brief 把叶子 k 分成四个子节点, 子节点中的单元仍然太多时继续分
+   * @note 有一个子节点会得到叶子中所有的单元时 (例如很多单元有一个公共顶点),
+   *   分开没有用, 这时不分, 而是把叶子的容量加倍, 避免树在这里无限变深
+   */
+  void split(uint32_t k)
+  {
+    Box b = tree_[k].box;
+    uint32_t depth = tree_[k].depth+1;
+    double xm = 0.5*(b.x0+b.x1), ym = 0.5*(b.y0+b.y1);
+    Box cb[4] = {{b.x0, b.y0, xm, ym}, {b.x0, ym, xm, b.y1}, 
+      {xm, b.y0, b.x1, ym}, {xm, ym, b.x1, b.y1}};
+
+    const auto & items = tree_[k].items;
+    std::vector<uint32_t> sub[4];
+    for(uint32_t i : items)
+    {
+      for(int j = 0; j < 4; j++)
+      {
+        if(cb[j].overlaps(box_[i]))
+          sub[j].push_back(i);
+      }
+    }
+    for(int j = 0; j < 4; j++)
+    {
+      if(sub[j].size() == items.size())
+      {
+        tree_[k].capacity = 2*items.size();
+        return;
+      }
+    }
+
+    int32_t child = tree_.size();
+    tree_[k].child = child;
+    std::vector<uint32_t>().swap(tree_[k].items);
+    for(int j = 0; j < 4; j++)
+      tree_.push_back({cb[j], -1, depth, leaf_size_, std::move(sub[j])});
+    for(int j = 0; j < 4; j++)
+    {
+      if(is_full(tree_[child+j]))
+        split(child+j);
+    }
+  }
+
+  bool is_full(const TreeNode & n) const
+  {
+    return n.items.size() > n.capacity && n.depth < max_depth_;
+  }
+
+private:
+  uint32_t leaf_size_;
+  uint32_t max_depth_;
+
+  std::vector<TreeNode> tree_;
+
+  /** 以单元的存储位置为下标, 单元的包围盒和是否在树中 */
+  std::vector<Box> box_;
+  std::vector<bool> in_tree_;
 };
 
 /**
@@ -55,22 +352,22 @@ public:
  * This class is used to find the nearest point in a 2D uniform mesh
  */
 template<typename Mesh>
-class UniformMesh2dFindPointAlg : public HEM::FindPointAlgorithmBase<UniformMesh2dFindPointAlg<Mesh>, Mesh> 
+class UniformMesh2dFindPointAlg : public HEM::FindPointAlgorithmBase<UniformMesh2dFindPointAlg<Mesh>, Mesh>
 {
 public:
-  using Base = FindPointAlgorithmBase<UniformMesh2dFindPointAlg<Mesh>, Mesh>; 
+  using Base = FindPointAlgorithmBase<UniformMesh2dFindPointAlg<Mesh>, Mesh>;
   using Self = UniformMesh2dFindPointAlg<Mesh>;
 
   using Cell = typename Mesh::Cell;
   using Edge = typename Mesh::Edge;
   using Node = typename Mesh::Node;
-  using HalfEdge = typename Mesh::HalfEdge; 
+  using HalfEdge = typename Mesh::HalfEdge;
 
   using Point  = typename Mesh::Point;
   using Vector = typename Mesh::Vector;
 
 private:
-  /** 
+  /**
    * @brief 背景网格中单元的子单元
    */
   IrregularArray2D<Cell *> subcell_;
@@ -80,16 +377,16 @@ public:
   /**
    * @brief 默认构造函数
    */
-  UniformMesh2dFindPointAlg(std::shared_ptr<Mesh> mesh) : Base(mesh), 
-    subcell_() 
+  UniformMesh2dFindPointAlg(std::shared_ptr<Mesh> mesh) : Base(mesh),
+    subcell_()
   {
     update_imp();
   }
 
-  
+
   uint32_t find_point_in_uniform_mesh(const Point & p)
   {
-    return mesh_->find_point(p);
+    return Base::mesh_->find_point(p);
   }
 
   /**
@@ -97,49 +394,51 @@ public:
    */
   void update_imp()
   {
-    uint32_t NC = mesh_->number_of_cells();
+    uint32_t NC = Base::mesh_->number_of_cells();
+    uint32_t NB = Base::mesh_->number_of_blocks();
     auto & data = subcell_.get_data();
     auto & start = subcell_.get_start_pos();
 
     data.resize(NC);
 
-    std::fill(start.begin(), start.end(), 0.0);
-    start.resize(NC+1, 0);
-    auto & cell = *(mesh_->get_cell());
+    start.assign(NB+1, 0);
+    auto & cell = *(Base::mesh_->get_cell());
     for(auto & c : cell)
     {
-      uint32_t idx = meshfind_point(c.barycenter());
+      uint32_t idx = find_point_in_uniform_mesh(c.barycenter());
       start[idx+1]++;
     }
 
-    for(uint32_t i = 1; i < NC+1; i++)
+    for(uint32_t i = 1; i < NB+1; i++)
       start[i] += start[i-1];
 
-    std::vector<uint32_t> I(NC, 0);
+    std::vector<uint32_t> I(NB, 0);
     for(auto & c : cell)
     {
-      uint32_t idx = Base::find_point(c.barycenter());
+      uint32_t idx = find_point_in_uniform_mesh(c.barycenter());
       data[start[idx]+I[idx]] = &c;
       I[idx]++;
     }
   }
 
-  Cell * find_point(Point & p, bool maybe_on_the_edge = true)
+  void update_imp(const std::vector<Cell *> &) { update_imp(); }
+
+  Cell * find_point_imp(const Point & p)
   {
-    HalfEdge * h = nullptr;
-    uint32_t idx = Base::find_point(p);
-    auto cellc = subcell_[idx];
-    for(auto & c : cellc)
+    uint32_t idx = find_point_in_uniform_mesh(p);
+    auto & geo = Base::mesh_->geometry_utils();
+    Point * points[32];
+    for(uint32_t k = 0; k < subcell_.row_size(idx); k++)
     {
-      bool flag = is_on_the_polygon(p, c, h, maybe_on_the_edge);
-      if(flag==1)
+      Cell * c = subcell_[idx][k];
+      uint32_t N = c->vertices(points);
+      uint32_t index;
+      if(geo.relative_position_of_point_and_polygon({points, N}, p, index) != 3)
         return c;
     }
     return nullptr;
   }
-
-
-}
+};
 
 } // namespace HEM
 
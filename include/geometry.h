@@ -11,8 +11,8 @@ public:
     // 构造函数
     Vector2d(double x_ = 0.0, double y_ = 0.0) : x(x_), y(y_) {}
 
-    // 复制构造函数
-    Vector2d(const Vector2d& other) : x(other.x), y(other.y) {}
+    // 复制构造函数, 保持平凡可复制, 使得实体数组可以直接按内存复制
+    Vector2d(const Vector2d& other) = default;
 
     Vector2d rotcw() { return Vector2d(y, -x); }
 
@@ -52,13 +52,7 @@ public:
     }
 
     // 重载赋值运算符 =
-    Vector2d& operator=(const Vector2d& other) {
-        if (this != &other) {
-            x = other.x;
-            y = other.y;
-        }
-        return *this;
-    }
+    Vector2d& operator=(const Vector2d& other) = default;
 
     // 向量模长
     double length() const 
@@ -103,7 +97,7 @@ public:
     Vector3d(double x_ = 0.0, double y_ = 0.0, double z_ = 0.0) : x(x_), y(y_), z(z_) {}
 
     // 复制构造函数
-    Vector3d(const Vector3d& other) : x(other.x), y(other.y), z(other.z) {}
+    Vector3d(const Vector3d& other) = default;
 
     Vector3d rotcwxy() { return Vector3d(y, -x, z); }
     Vector3d rotcwxz() { return Vector3d(-z, y, x); }
@@ -146,14 +140,7 @@ public:
     }
 
     // 重载赋值运算符 =
-    Vector3d& operator=(const Vector3d& other) {
-        if (this != &other) {
-            x = other.x;
-            y = other.y;
-            z = other.z;
-        }
-        return *this;
-    }
+    Vector3d& operator=(const Vector3d& other) = default;
 
     // 向量模长
     double length() const {
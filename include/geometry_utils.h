@@ -2,6 +2,9 @@
 #define GEOMETRY_UTILS2D_H
 
 #include <vector>
+#include <span>
+#include <cmath>
+#include <algorithm>
 #include <stdint.h>
 
 #include "geometry.h"
@@ -21,6 +24,8 @@ public:
    */
   GeometryUtils2D(double tol = 1e-6): tol_(tol) {}
 
+  double tolerance() const { return tol_; }
+
   /**
    * @brief Determines if two points are equal within a tolerance, if the
    * distance between the points is less than the tolerance.
@@ -84,10 +89,10 @@ public:
 
   /**
    * @brief Determines if a point is on a polygon
-   * @param polygon The vertices of the polygon
+   * @param polygon The vertices of the polygon, a std::vector or an array on the stack
    * @param p The point to check
    */
-  bool point_in_polygon(const std::vector<Point2d*>& polygon, const Point2d& p) const
+  bool point_in_polygon(std::span<Point2d * const> polygon, const Point2d& p) const
   {
     int n = polygon.size();
     int count = 0;
@@ -117,7 +122,7 @@ public:
    *         3 if the point is outside the polygon
    */
   uint8_t relative_position_of_point_and_polygon(
-      const std::vector<Point2d*>& polygon, 
+      std::span<Point2d * const> polygon, 
       const Point2d& p,
       uint32_t & index) const
   {
@@ -150,6 +155,70 @@ public:
   }
 
 
+  /**
+   * @brief 一批点与同一个多边形的相对位置, 结果与对每个点调用
+   *   relative_position_of_point_and_polygon 相同
+   * @param vx, vy : 多边形的 n 个顶点的坐标
+   * @param px, py : m 个点的坐标
+   * @param flag, index : 第 q 个点的返回值和 index
+   * @note 多边形的边在外层循环, 内层循环对点向量化, 每次处理 64 个点, 不分配内存
+   */
+  void relative_position_of_points_and_polygon(const double * vx, const double * vy, int n,
+      const double * px, const double * py, int m, uint8_t * flag, uint32_t * index) const
+  {
+    constexpr int B = 64;
+    int32_t vi[B], ei[B], count[B];
+    for(int q0 = 0; q0 < m; q0 += B)
+    {
+      const int nb = std::min(B, m-q0);
+      const double * x = px + q0;
+      const double * y = py + q0;
+      for(int q = 0; q < nb; q++)
+      {
+        vi[q] = n; ei[q] = n; count[q] = 0;
+      }
+      for(int i = 0; i < n; i++)
+      {
+        const int j = i+1 == n ? 0 : i+1;
+        const double x0 = vx[i], y0 = vy[i], x1 = vx[j], y1 = vy[j];
+        const double ux = x1-x0, uy = y1-y0, c2 = ux*ux+uy*uy;
+#pragma omp simd
+        for(int q = 0; q < nb; q++)
+        {
+          /** 与顶点的距离, 与边的距离, 见 points_equal 和 dist_point_to_segment */
+          double wx = x[q]-x0, wy = y[q]-y0;
+          double c1 = wx*ux+wy*uy;
+          double b = c1/c2;
+          double bx = x[q]-(x0+ux*b), by = y[q]-(y0+uy*b);
+          double rx = x[q]-x1, ry = y[q]-y1;
+          double dv = std::sqrt(wx*wx+wy*wy);
+          double de = c1 <= 0 ? dv : (c2 <= c1 ? std::sqrt(rx*rx+ry*ry) : std::sqrt(bx*bx+by*by));
+          vi[q] = (vi[q] == n && dv < tol_) ? i : vi[q];
+          ei[q] = (ei[q] == n && de < tol_) ? i : ei[q];
+
+          /** 射线法, 见 point_in_polygon */
+          double ft = (x0-x[q])/(x0-x1);
+          count[q] += ((x[q] > x0) != (x[q] > x1)) && y[q] < y0-ft*(y0-y1);
+        }
+      }
+      for(int q = 0; q < nb; q++)
+      {
+        if(vi[q] < n)
+        {
+          flag[q0+q] = 0; index[q0+q] = vi[q];
+        }
+        else if(ei[q] < n)
+        {
+          flag[q0+q] = 1; index[q0+q] = ei[q];
+        }
+        else
+        {
+          flag[q0+q] = count[q] % 2 == 1 ? 2 : 3; index[q0+q] = 0;
+        }
+      }
+    }
+  }
+
   /**
    * @brief Computes the intersection point of two line segments
    * @param p0 The first point of the first line segment
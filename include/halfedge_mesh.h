@@ -8,9 +8,11 @@
 
 #include <functional>
 #include <memory>
+#include <memory_resource>
 
 #include "geometry_utils.h"
 #include "data_container.h"
+#include "tools.h"
 
 namespace HEM
 {
@@ -30,29 +32,38 @@ public:
   using Vector = typename Traits::Vector;
 
   constexpr static const int Dim    = Traits::Dim;
+  constexpr static const uint32_t ChunkSize = Traits::ChunkSize;
 
   using Self = HalfEdgeMeshBase<Traits>;
+  using Storage = typename Traits::Storage;
 
-  using NodeDataContainer = EntityDataContainer<Node, 1024u>;
-  using EdgeDataContainer = EntityDataContainer<Edge, 1024u>;
-  using CellDataContainer = EntityDataContainer<Cell, 1024u>;
-  using HalfEdgeDataContainer = EntityDataContainer<HalfEdge, 1024u>;
+  using NodeDataContainer = EntityDataContainer<Node, ChunkSize>;
+  using EdgeDataContainer = EntityDataContainer<Edge, ChunkSize>;
+  using CellDataContainer = EntityDataContainer<Cell, ChunkSize>;
+  using HalfEdgeDataContainer = EntityDataContainer<HalfEdge, ChunkSize>;
 
   template<typename T>
   using Array = typename NodeDataContainer::Base::template DataArray<T>;
 
 public:
+  /**
+   * @param resource : 实体和数据数组的内存资源, 为空时使用 std::pmr::get_default_resource(),
+   *                   例如 MeshArena, 网格必须在 resource 之前析构
+   */
   HalfEdgeMeshBase(uint32_t NN = 0, uint32_t NE = 0, uint32_t NC = 0, uint32_t NH = 0,
-      double eps = 1e-6): geometry_utils_(eps)
+      double eps = 1e-6, std::pmr::memory_resource * resource = nullptr): 
+    geometry_utils_(eps), 
+    resource_(resource ? resource : std::pmr::get_default_resource())
   {
-    node_data_ptr_ = std::make_shared<NodeDataContainer>(NN);
-    edge_data_ptr_ = std::make_shared<EdgeDataContainer>(NE);
-    cell_data_ptr_ = std::make_shared<CellDataContainer>(NC);
-    halfedge_data_ptr_ = std::make_shared<HalfEdgeDataContainer>(NH);
+    node_data_ptr_ = make_container<NodeDataContainer>(NN);
+    edge_data_ptr_ = make_container<EdgeDataContainer>(NE);
+    cell_data_ptr_ = make_container<CellDataContainer>(NC);
+    halfedge_data_ptr_ = make_container<HalfEdgeDataContainer>(NH);
+    bind_storage();
   }
 
-  /** 复制构造函数 */
-  HalfEdgeMeshBase(const Self & mesh);
+  /** 复制构造函数, 新网格的内存从 resource 分配 */
+  HalfEdgeMeshBase(const Self & mesh, std::pmr::memory_resource * resource = nullptr);
 
   /** 以单元为中心的网格 */
   HalfEdgeMeshBase(double * node, uint32_t * cell, uint32_t NN, uint32_t NC, uint32_t NV):
@@ -61,9 +72,21 @@ public:
     reinit(node, cell, NN, NC, NV);
   }
 
-  /** 以单元为中心的网格重新初始化 */
+  /** 以单元为中心的网格重新初始化, 每个单元都有 NV 个顶点 */
   void reinit(double * node, uint32_t * cell, uint32_t NN, uint32_t NC, uint32_t NV);
 
+  /**
+   * @brief 以单元为中心的网格重新初始化, 单元的顶点个数可以不同
+   * @param offsets : 长度为 NC+1, 第 i 个单元的顶点是 cell[offsets[i]], ..., cell[offsets[i+1]-1]
+   * @note 1. 第 i 个单元的半边的存储位置是 offsets[i], ..., offsets[i+1]-1, 
+   *          第 j 条半边指向 cell[j]。
+   *       2. 半边按顶点对 (min, max) 做并行基数排序, 相邻且相同的两条互为对边, 
+   *          边按顶点对的顺序编号。非流形的边只配对排序后的前两条半边。
+   *       3. 重新创建所有实体数组, 网格上原有的数据都会被删除。
+   */
+  void reinit(const double * node, const uint32_t * cell, const uint32_t * offsets, 
+      uint32_t NN, uint32_t NC);
+
   /** 实体接口 */
   std::shared_ptr<Array<Node>> get_node() { return node_data_ptr_->get_entity(); }
 
@@ -109,6 +132,52 @@ public:
     return cell_data_ptr_->template add_data<Data>(dname); 
   }
 
+  /** 数据句柄接口, 得到句柄后访问数据不需要按名字查找 */
+  template<typename Data>
+  DataHandle<Data> add_node_data_handle(std::string dname) 
+  { 
+    return node_data_ptr_->template add_handle<Data>(dname); 
+  }
+
+  template<typename Data>
+  DataHandle<Data> add_edge_data_handle(std::string dname) 
+  { 
+    return edge_data_ptr_->template add_handle<Data>(dname); 
+  }
+
+  template<typename Data>
+  DataHandle<Data> add_cell_data_handle(std::string dname) 
+  { 
+    return cell_data_ptr_->template add_handle<Data>(dname); 
+  }
+
+  template<typename Data>
+  DataHandle<Data> get_node_data_handle(std::string dname) 
+  { 
+    return node_data_ptr_->template get_handle<Data>(dname); 
+  }
+
+  template<typename Data>
+  DataHandle<Data> get_edge_data_handle(std::string dname) 
+  { 
+    return edge_data_ptr_->template get_handle<Data>(dname); 
+  }
+
+  template<typename Data>
+  DataHandle<Data> get_cell_data_handle(std::string dname) 
+  { 
+    return cell_data_ptr_->template get_handle<Data>(dname); 
+  }
+
+  template<typename Data>
+  Array<Data> & node_data(DataHandle<Data> handle) { return (*node_data_ptr_)[handle]; }
+
+  template<typename Data>
+  Array<Data> & edge_data(DataHandle<Data> handle) { return (*edge_data_ptr_)[handle]; }
+
+  template<typename Data>
+  Array<Data> & cell_data(DataHandle<Data> handle) { return (*cell_data_ptr_)[handle]; }
+
   template<typename Entity>
   std::shared_ptr<Array<Entity>> get_entity() 
   { 
@@ -122,6 +191,19 @@ public:
       return halfedge_data_ptr_->get_entity();
   }
 
+  template<typename Entity>
+  std::shared_ptr<const Array<Entity>> get_entity() const
+  { 
+    if constexpr (std::is_same_v<Entity, Cell>)
+      return cell_data_ptr_->get_entity();
+    else if constexpr (std::is_same_v<Entity, Edge>)
+      return edge_data_ptr_->get_entity();
+    else if constexpr (std::is_same_v<Entity, Node>)
+      return node_data_ptr_->get_entity();
+    else if constexpr (std::is_same_v<Entity, HalfEdge>)
+      return halfedge_data_ptr_->get_entity();
+  }
+
   /** 删除实体 */
   void delete_node(Node & n) { node_data_ptr_->delete_index(n.index());}
 
@@ -149,13 +231,46 @@ public:
 
   std::shared_ptr<Array<uint32_t>> get_halfedge_indices() { return halfedge_data_ptr_->get_entity_indices(); }
 
-  /** @brief 实体迭代函数 */
-  template<typename Entity>
-  void for_each_entity(const std::function<bool(Entity & )> & );
+  /** 
+   * @brief 实体迭代函数, f 返回 false 时停止
+   * @return 是否遍历了所有实体
+   */
+  template<typename Entity, typename Fun>
+  bool for_each_entity(const Fun & f);
 
-  /** @brief 并行的实体迭代函数 */
-  template<typename Entity>
-  void parallel_for_each_entity(const std::function<bool(Entity & )> & );
+  template<typename Entity, typename Fun>
+  bool for_each_entity(const Fun & f) const;
+
+  template<typename Fun>
+  bool for_each_node(const Fun & f) { return for_each_entity<Node>(f); }
+
+  template<typename Fun>
+  bool for_each_edge(const Fun & f) { return for_each_entity<Edge>(f); }
+
+  template<typename Fun>
+  bool for_each_cell(const Fun & f) { return for_each_entity<Cell>(f); }
+
+  template<typename Fun>
+  bool for_each_halfedge(const Fun & f) { return for_each_entity<HalfEdge>(f); }
+
+  template<typename Fun>
+  bool for_each_node(const Fun & f) const { return for_each_entity<Node>(f); }
+
+  template<typename Fun>
+  bool for_each_edge(const Fun & f) const { return for_each_entity<Edge>(f); }
+
+  template<typename Fun>
+  bool for_each_cell(const Fun & f) const { return for_each_entity<Cell>(f); }
+
+  template<typename Fun>
+  bool for_each_halfedge(const Fun & f) const { return for_each_entity<HalfEdge>(f); }
+
+  /** 
+   * @brief 并行的实体迭代函数, 按块划分任务
+   * @note f 的返回值被忽略, 不同的线程会同时调用 f
+   */
+  template<typename Entity, typename Fun>
+  void parallel_for_each_entity(const Fun & f);
 
   /** 实体个数 */
   uint32_t number_of_nodes() { return node_data_ptr_->number_of_data(); }
@@ -193,51 +308,93 @@ public:
     return box;
   }
 
+  /**
+   * @brief 从单元 c 出发沿线段 [q, p] 行走, q 是 c 的重心: 每次穿过一条 p 在其外侧
+   *   且与线段相交的边, 直到 p 不在当前单元任何一条边的外侧
+   * @return 最后到达的单元, 走出网格, 找不到与线段相交的边或超过 max_steps 步时返回空
+   * @note 1. 单元的顶点按逆时针排列, 凸单元时返回的单元包含 p, 
+   *          其它情况需要调用者再检查, 例如 is_strictly_inside。
+   *       2. 只经过与线段 [q, p] 相交的单元, 所以并发切割时不会走进其它线程的区域。
+   */
+  Cell * walk_to_point(const Point & p, Cell * c, uint32_t max_steps = 256) const;
+
+  /**
+   * @brief p 在单元 c 每条边的左侧, 且与边所在直线的距离都大于 d, 
+   *   这时 p 一定在 c 的内部, 与 c 的边界的距离大于 d
+   */
+  bool is_strictly_inside(const Point & p, const Cell * c, double d) const;
+
   /** 加密半边 */
-  void splite_halfedge(HalfEdge * h)
+  HalfEdge * splite_halfedge(HalfEdge * h)
   {
-    splite_halfedge(h, (h->node()->coordinate() + 
+    return splite_halfedge(h, (h->node()->coordinate() + 
           h->previous()->node()->coordinate())*0.5);
   }
 
-  /** 加密半边 */
-  void splite_halfedge(HalfEdge * h, const Point & p)
+  /** 
+   * @brief 加密半边 
+   * @return 新的半边, 从 h 的起点指向新顶点 p, 即 h->previous()。
+   *   h 和它的对边所在的单元多了一个顶点, 但形状不变。
+   *   并发模式下没有位置时返回空指针, 网格不变
+   */
+  HalfEdge * splite_halfedge(HalfEdge * h, const Point & p)
   {
-    Node & n = add_node();
-    Edge & e = add_edge();
-    HalfEdge & h0 = add_halfedge();
+    Node * n = node_data_ptr_->try_add_entity();
+    Edge * e = edge_data_ptr_->try_add_entity();
+    HalfEdge * h0 = halfedge_data_ptr_->try_add_entity();
+    HalfEdge * h1 = h->is_boundary() ? h0 : halfedge_data_ptr_->try_add_entity();
+    if(!n || !e || !h0 || !h1)
+    {
+      if(n) delete_node(*n);
+      if(e) delete_edge(*e);
+      if(h0) delete_halfedge(*h0);
+      if(h1 && h1 != h0) delete_halfedge(*h1);
+      return nullptr;
+    }
 
-    e.set_halfedge(&h0);
-    n.reset(p, n.index(), &h0);
+    e->set_halfedge(h0);
+    n->reset(p, n->index(), h0);
 
-    h0.reset(h, h->previous(), &h0, h->cell(), &e, &n, h0.index());
+    h0->reset(h, h->previous(), h0, h->cell(), e, n, h0->index());
 
-    h->previous()->set_next(&h0);
-    h->set_previous(&h0);
+    h->previous()->set_next(h0);
+    h->set_previous(h0);
     h->edge()->set_halfedge(h);
     if(!h->is_boundary())
     {
-      HalfEdge & h1 = add_halfedge();
       HalfEdge * o = h->opposite();
 
-      h->set_opposite(&h1);
-      h0.set_opposite(o);
-      h1.reset(o, o->previous(), h, o->cell(), o->edge(), &n, h1.index());
+      h->set_opposite(h1);
+      h0->set_opposite(o);
+      h1->reset(o, o->previous(), h, o->cell(), o->edge(), n, h1->index());
 
-      o->previous()->set_next(&h1);
-      o->set_previous(&h1);
-      o->set_opposite(&h0);
-      o->set_edge(&e);
+      o->previous()->set_next(h1);
+      o->set_previous(h1);
+      o->set_opposite(h0);
+      o->set_edge(e);
     }
+    return h0;
   }
 
-  /** 连接 h0 和 h1 的顶点分割单元 c */
-  void splite_cell(Cell * c0, HalfEdge * h0, HalfEdge * h1)
+  /** 
+   * @brief 连接 h0 和 h1 的顶点分割单元 c 
+   * @return 新的单元, 含有原来 h0->next() 到 h1 的半边, c0 保留原来 h1->next() 到 h0 的半边。
+   *   并发模式下没有位置时返回空指针, 网格不变
+   */
+  Cell * splite_cell(Cell * c0, HalfEdge * h0, HalfEdge * h1)
   {
-    HalfEdge * nh0 = &add_halfedge();
-    HalfEdge * nh1 = &add_halfedge();
-    Edge * e = &add_edge();
-    Cell * c1 = &add_cell();
+    HalfEdge * nh0 = halfedge_data_ptr_->try_add_entity();
+    HalfEdge * nh1 = halfedge_data_ptr_->try_add_entity();
+    Edge * e = edge_data_ptr_->try_add_entity();
+    Cell * c1 = cell_data_ptr_->try_add_entity();
+    if(!nh0 || !nh1 || !e || !c1)
+    {
+      if(nh0) delete_halfedge(*nh0);
+      if(nh1) delete_halfedge(*nh1);
+      if(e) delete_edge(*e);
+      if(c1) delete_cell(*c1);
+      return nullptr;
+    }
 
     c0->set_halfedge(nh0);
     c1->set_halfedge(nh1);
@@ -252,6 +409,61 @@ public:
     h1->set_next(nh1);
     for(HalfEdge * h = nh1->next(); h != nh1; h = h->next())
       h->set_cell(c1); 
+    return c1;
+  }
+
+  /**
+   * @brief splite_halfedge 的逆操作, 删除 h0 指向的顶点, 把 h0 合并到它后面的半边
+   * @param h0 : splite_halfedge 返回的半边, 之后对它两侧单元的修改都已经撤销
+   */
+  void merge_halfedge(HalfEdge * h0)
+  {
+    HalfEdge * h = h0->next();
+    h0->previous()->set_next(h);
+    h->set_previous(h0->previous());
+    if(h->cell()->halfedge() == h0)
+      h->cell()->set_halfedge(h);
+    if(!h0->is_boundary())
+    {
+      HalfEdge * o = h0->opposite();
+      HalfEdge * h1 = h->opposite();
+      h1->previous()->set_next(o);
+      o->set_previous(h1->previous());
+      if(o->cell()->halfedge() == h1)
+        o->cell()->set_halfedge(o);
+      h->set_opposite(o);
+      o->set_opposite(h);
+      o->set_edge(h->edge());
+      delete_halfedge(*h1);
+    }
+    delete_node(*h0->node());
+    delete_edge(*h0->edge());
+    delete_halfedge(*h0);
+  }
+
+  /**
+   * @brief splite_cell 的逆操作, 删除新的边, 把新的单元合并回原来的单元
+   * @param nh1 : splite_cell 返回时新单元的半边 c1->halfedge(),
+   *   之后对两个单元的修改都已经撤销
+   */
+  void merge_cell(HalfEdge * nh1)
+  {
+    HalfEdge * nh0 = nh1->opposite();
+    HalfEdge * h0 = nh0->previous(), * h1 = nh1->previous();
+    Cell * c0 = nh0->cell(), * c1 = nh1->cell();
+
+    h0->set_next(nh1->next());
+    nh1->next()->set_previous(h0);
+    h1->set_next(nh0->next());
+    nh0->next()->set_previous(h1);
+    for(HalfEdge * h = h0->next(); h != h1->next(); h = h->next())
+      h->set_cell(c0);
+    c0->set_halfedge(h0);
+
+    delete_edge(*nh0->edge());
+    delete_halfedge(*nh0);
+    delete_halfedge(*nh1);
+    delete_cell(*c1);
   }
 
   /** @brief 清空网格, 但实际上没有释放内存 */
@@ -261,6 +473,7 @@ public:
     edge_data_ptr_->clear();
     cell_data_ptr_->clear();
     halfedge_data_ptr_->clear();
+    bind_storage();
   }
 
   /** 
@@ -276,27 +489,138 @@ public:
 
   void swap(HalfEdgeMeshBase & other)
   {
-    std::swap(node_data_ptr_, other.node_data_);
-    std::swap(edge_data_ptr_, other.edge_data_);
-    std::swap(cell_data_ptr_, other.cell_data_);
-    std::swap(halfedge_data_ptr_, other.halfedge_data_);
+    std::swap(node_data_ptr_, other.node_data_ptr_);
+    std::swap(edge_data_ptr_, other.edge_data_ptr_);
+    std::swap(cell_data_ptr_, other.cell_data_ptr_);
+    std::swap(halfedge_data_ptr_, other.halfedge_data_ptr_);
+    std::swap(storage_context_, other.storage_context_);
+    std::swap(resource_, other.resource_);
+  }
+
+  /** @brief 网格的内存资源 */
+  std::pmr::memory_resource * get_memory_resource() const { return resource_; }
+
+  /** 
+   * @brief 将实体数组写入连接关系存储的上下文
+   * @note 编号存储模式下, 实体数组被重新创建后 (复制, clear, 反序列化) 
+   *       都需要调用这个函数, 指针存储模式下什么也不做
+   */
+  void bind_storage()
+  {
+    if constexpr (Storage::is_relocatable)
+    {
+      if(!storage_context_)
+        storage_context_ = std::make_shared<typename Storage::Context>();
+      auto & ctx = *storage_context_;
+      ctx.node = get_node().get();
+      ctx.edge = get_edge().get();
+      ctx.cell = get_cell().get();
+      ctx.halfedge = get_halfedge().get();
+      get_node()->set_context(&ctx);
+      get_edge()->set_context(&ctx);
+      get_cell()->set_context(&ctx);
+      get_halfedge()->set_context(&ctx);
+    }
   }
 
+  /**
+   * @brief 更新实体编号和边界点的半边
+   * @note 只处理上次 update 之后添加或删除的实体, 所以工作量与修改量成正比。
+   *   直接修改已有实体的连接关系后, 需要先调用 set_dirty() 
+   */
   void update()
   {
+    uint32_t hbegin = halfedge_data_ptr_->dirty_begin();
+
     node_data_ptr_->update();
     edge_data_ptr_->update();
     cell_data_ptr_->update();
     halfedge_data_ptr_->update();
 
     /** 边界点的半边一定要是边界 */
-    auto f = [](HalfEdge & h)->bool
+    auto & halfedge = *get_halfedge();
+    halfedge_data_ptr_->for_each_index(hbegin, [&halfedge](uint32_t i)
     {
+      HalfEdge & h = halfedge[i];
       if(h.is_boundary())
         h.node()->set_halfedge(&h);
-      return true;
-    };
-    for_each_entity<HalfEdge>(f);
+    });
+  }
+
+  /**
+   * @brief 整理存储: 把存活的实体和数据移动到每个数组的前面, 重写连接关系并释放多余的块
+   * @note 1. 实体按原来的存储顺序排列, 所以实体的新编号就是原来的紧凑编号。
+   *       2. 所有实体的指针和引用都会失效。
+   *       3. 整理之后 is_compact() 为真, 存储位置就是 get_xxx_indices() 给出的编号。
+   * @return 单元的顺序, 新的第 k 个单元是原来存储位置为 corder[k] 的单元
+   */
+  std::vector<uint32_t> compact();
+
+  /**
+   * @brief 按单元重心的 Morton 码重排单元, 并整理存储
+   * @note 1. 半边按单元的顺序排列, 同一个单元的半边从 halfedge() 开始依次 next(),
+   *          顶点和边按它们在半边中第一次出现的顺序排列。
+   *       2. 所有数据都随实体一起重排, 所有实体的指针和引用都会失效。
+   * @return 见 compact
+   */
+  std::vector<uint32_t> reorder();
+
+  /**
+   * @brief 按给定的顺序重排实体, 见 compact
+   * @param norder, eorder, corder, horder : 新的第 k 个实体是原来存储位置为 xorder[k] 的实体,
+   *   必须包含所有存活的实体
+   */
+  void permute(const std::vector<uint32_t> & norder, const std::vector<uint32_t> & eorder, 
+      const std::vector<uint32_t> & corder, const std::vector<uint32_t> & horder);
+
+  /** @brief 预留实体的存储空间, 参数是各种实体的总数 */
+  void reserve(uint32_t NN, uint32_t NE, uint32_t NC, uint32_t NH)
+  {
+    node_data_ptr_->reserve(NN);
+    edge_data_ptr_->reserve(NE);
+    cell_data_ptr_->reserve(NC);
+    halfedge_data_ptr_->reserve(NH);
+  }
+
+  /**
+   * @brief 打开或关闭并发模式, 并发模式下多个线程可以同时添加和删除实体,
+   *   见 DataContainer::set_concurrent
+   * @param NN, NE, NC, NH : 预计添加的顶点, 边, 单元, 半边的个数, 超过时
+   *   is_concurrent_overflowed() 为真, 余量也用完时 splite_halfedge 和 splite_cell
+   *   返回空指针
+   * @note 不同的线程只能修改互不相邻的实体。打开时所有数组一次扩容, 
+   *   并发模式下不分配块。
+   */
+  void set_concurrent(bool flag, uint32_t NN = 0, uint32_t NE = 0, uint32_t NC = 0, 
+      uint32_t NH = 0)
+  {
+    node_data_ptr_->set_concurrent(flag, NN);
+    edge_data_ptr_->set_concurrent(flag, NE);
+    cell_data_ptr_->set_concurrent(flag, NC);
+    halfedge_data_ptr_->set_concurrent(flag, NH);
+  }
+
+  /** @brief 并发模式下添加的实体是否超过了 set_concurrent 时预计的个数 */
+  bool is_concurrent_overflowed() const
+  {
+    return node_data_ptr_->is_overflowed() || edge_data_ptr_->is_overflowed() || 
+      cell_data_ptr_->is_overflowed() || halfedge_data_ptr_->is_overflowed();
+  }
+
+  /** @brief 四个实体数组都没有空位 */
+  bool is_compact() const
+  {
+    return node_data_ptr_->is_compact() && edge_data_ptr_->is_compact() && 
+      cell_data_ptr_->is_compact() && halfedge_data_ptr_->is_compact();
+  }
+
+  /** @brief 将所有实体标记为被修改过, 下次 update 会处理整个网格 */
+  void set_dirty()
+  {
+    node_data_ptr_->set_dirty();
+    edge_data_ptr_->set_dirty();
+    cell_data_ptr_->set_dirty();
+    halfedge_data_ptr_->set_dirty();
   }
 
   Self & operator = (const Self & other);
@@ -311,15 +635,29 @@ public:
     return geometry_utils_; 
   }
 
+private:
+  template<typename Container>
+  std::shared_ptr<Container> make_container(uint32_t size)
+  {
+    return std::allocate_shared<Container>(
+        std::pmr::polymorphic_allocator<Container>(resource_), size, resource_);
+  }
+
 private:
   /** 几何工具 */
   GeometryUtils2D geometry_utils_;
 
+  /** 实体和数据数组的内存资源 */
+  std::pmr::memory_resource * resource_;
+
   /** 实体数据集合 */
   std::shared_ptr<NodeDataContainer> node_data_ptr_; 
   std::shared_ptr<EdgeDataContainer> edge_data_ptr_;
   std::shared_ptr<CellDataContainer> cell_data_ptr_;
   std::shared_ptr<HalfEdgeDataContainer> halfedge_data_ptr_;
+
+  /** 编号存储模式下实体数组块头指向的上下文 */
+  std::shared_ptr<typename Storage::Context> storage_context_;
 };
 
 }
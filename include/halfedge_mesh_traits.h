@@ -6,6 +6,7 @@
  */
 
 #include "entity.h"
+#include "entity_storage.h"
 #include "geometry.h"
 
 namespace HEM
@@ -13,8 +14,10 @@ namespace HEM
 
 /**
  * @brief 半边网格的特性
+ * @param S : 实体之间连接关系的存储方式, PointerStorage 或 IndexStorage
  */
-template<typename N, typename E, typename C, typename H, int D>
+template<typename N, typename E, typename C, typename H, int D, 
+  template<typename> class S = PointerStorage>
 class HalfEdgeMeshTraits
 {
 public:
@@ -24,6 +27,11 @@ public:
   using Cell = C; 
   using HalfEdge = H;
 
+  using Storage = S<HalfEdgeMeshTraits>;
+
+  /** 实体数组每一块的大小 */
+  constexpr static uint32_t ChunkSize = 1024u;
+
   constexpr static const uint8_t Dim = D;
   static_assert(Dim == 2 || Dim == 3, "Dimension must be 2 or 3.");
 
@@ -66,4 +74,42 @@ class DefaultHalfEdge2d : public THalfEdge<DefaultHalfEdgeMesh2dTraits>{};
 template<int D>
 using DefaultHalfEdgeMeshTraits = typename std::conditional<(D == 2), DefaultHalfEdgeMesh2dTraits, DefaultHalfEdgeMesh3dTraits>::type;
 
+
+/** 
+ * @brief 使用编号存储连接关系的默认 3 维网格的特性
+ */
+class DefaultIndexNode3d;
+class DefaultIndexEdge3d;
+class DefaultIndexCell3d;
+class DefaultIndexHalfEdge3d;
+
+using DefaultIndexHalfEdgeMesh3dTraits  = HalfEdgeMeshTraits<DefaultIndexNode3d, 
+      DefaultIndexEdge3d, DefaultIndexCell3d, DefaultIndexHalfEdge3d, 3, IndexStorage>;
+
+class DefaultIndexNode3d : public TNode<DefaultIndexHalfEdgeMesh3dTraits>{};
+class DefaultIndexEdge3d : public TEdge<DefaultIndexHalfEdgeMesh3dTraits>{};
+class DefaultIndexCell3d : public TCell<DefaultIndexHalfEdgeMesh3dTraits>{};
+class DefaultIndexHalfEdge3d : public THalfEdge<DefaultIndexHalfEdgeMesh3dTraits>{};
+
+
+/** 
+ * @brief 使用编号存储连接关系的默认 2 维网格的特性
+ */
+class DefaultIndexNode2d;
+class DefaultIndexEdge2d;
+class DefaultIndexCell2d;
+class DefaultIndexHalfEdge2d;
+
+using DefaultIndexHalfEdgeMesh2dTraits  = HalfEdgeMeshTraits<DefaultIndexNode2d, 
+      DefaultIndexEdge2d, DefaultIndexCell2d, DefaultIndexHalfEdge2d, 2, IndexStorage>;
+
+class DefaultIndexNode2d : public TNode<DefaultIndexHalfEdgeMesh2dTraits>{};
+class DefaultIndexEdge2d : public TEdge<DefaultIndexHalfEdgeMesh2dTraits>{};
+class DefaultIndexCell2d : public TCell<DefaultIndexHalfEdgeMesh2dTraits>{};
+class DefaultIndexHalfEdge2d : public THalfEdge<DefaultIndexHalfEdgeMesh2dTraits>{};
+
+template<int D>
+using DefaultIndexHalfEdgeMeshTraits = typename std::conditional<(D == 2), 
+      DefaultIndexHalfEdgeMesh2dTraits, DefaultIndexHalfEdgeMesh3dTraits>::type;
+
 }
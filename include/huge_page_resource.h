@@ -0,0 +1,135 @@
+#ifndef HUGE_PAGE_RESOURCE_H
+#define HUGE_PAGE_RESOURCE_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <memory_resource>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace HEM
+{
+
+/**
+ * @brief 使用 2MB 大页的内存资源
+ * @note 1. 不小于 threshold 的请求用 mmap 直接分配, 并按 2MB 取整, 依次尝试:
+ *          Explicit    : MAP_HUGETLB, 需要系统预留了大页 (vm.nr_hugepages)
+ *          Transparent : 普通 mmap 后 2MB 对齐, 再 madvise(MADV_HUGEPAGE)
+ *          小于 threshold 的请求和非 Linux 系统交给 upstream。
+ *       2. mmap 得到的页面在第一次访问时才真正分配, 配合 ChunkArray::reserve
+ *          的并行初始化, 页面会落在访问它的线程的 NUMA 节点上。
+ *       3. 每个大请求都是一次系统调用, 一般作为 MeshArena 的 upstream 使用:
+ *            HugePageResource huge;
+ *            MeshArena arena(64u << 20, &huge);
+ *            UniformMeshCut<2> mesh(0, 0, h, h, 4096, 4096, &arena);
+ *       4. 多个线程可以同时分配和释放, 小请求的线程安全由 upstream 决定,
+ *          默认的 upstream 是线程安全的。
+ */
+class HugePageResource : public std::pmr::memory_resource
+{
+public:
+  enum class Policy
+  {
+    Explicit,    // 先尝试 MAP_HUGETLB, 失败后使用透明大页
+    Transparent, // 只使用透明大页
+    None         // 不使用大页, 直接交给 upstream
+  };
+
+  constexpr static size_t HugePageSize = size_t(2) << 20;
+
+public:
+  HugePageResource(Policy policy = Policy::Explicit, size_t threshold = HugePageSize,
+      std::pmr::memory_resource * upstream = std::pmr::get_default_resource()):
+    policy_(policy), threshold_(threshold), upstream_(upstream) {}
+
+  Policy policy() const { return policy_; }
+
+  /** MAP_HUGETLB 成功的次数 */
+  size_t number_of_explicit_mappings() const { return explicit_count_.load(std::memory_order_relaxed); }
+
+  /** 使用透明大页的次数 */
+  size_t number_of_transparent_mappings() const { return transparent_count_.load(std::memory_order_relaxed); }
+
+private:
+  bool use_mmap(size_t bytes, size_t alignment) const
+  {
+#if defined(__linux__)
+    return policy_ != Policy::None && bytes >= threshold_ && alignment <= HugePageSize;
+#else
+    return false;
+#endif
+  }
+
+  static size_t round_up(size_t bytes)
+  {
+    return (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+  }
+
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    if(!use_mmap(bytes, alignment))
+      return upstream_->allocate(bytes, alignment);
+
+#if defined(__linux__)
+    size_t size = round_up(bytes);
+#if defined(MAP_HUGETLB)
+    if(policy_ == Policy::Explicit)
+    {
+      void * p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if(p != MAP_FAILED)
+      {
+        explicit_count_.fetch_add(1, std::memory_order_relaxed);
+        return p;
+      }
+    }
+#endif
+    /** 多申请 2MB 用来对齐, 然后把头尾多余的部分还回去 */
+    char * p = static_cast<char *>(mmap(nullptr, size + HugePageSize,
+          PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if(p == MAP_FAILED)
+      throw std::bad_alloc();
+    char * aligned = reinterpret_cast<char *>(round_up(reinterpret_cast<uintptr_t>(p)));
+    if(aligned != p)
+      munmap(p, aligned - p);
+    if(aligned + size != p + size + HugePageSize)
+      munmap(aligned + size, p + HugePageSize - aligned);
+#if defined(MADV_HUGEPAGE)
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    transparent_count_.fetch_add(1, std::memory_order_relaxed);
+    return aligned;
+#else
+    return nullptr;
+#endif
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t alignment) override
+  {
+    if(!use_mmap(bytes, alignment))
+      return upstream_->deallocate(p, bytes, alignment);
+#if defined(__linux__)
+    munmap(p, round_up(bytes));
+#endif
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  Policy policy_;
+  size_t threshold_;
+  std::pmr::memory_resource * upstream_;
+  std::atomic<size_t> explicit_count_{0};
+  std::atomic<size_t> transparent_count_{0};
+};
+
+}
+
+#endif /* HUGE_PAGE_RESOURCE_H */
@@ -1,17 +1,25 @@
-#include<map>
+#include<atomic>
 
 namespace HEM{
 
 /** 复制构造函数 */
 template<typename Traits>
-HalfEdgeMeshBase<Traits>::HalfEdgeMeshBase(
-    const HalfEdgeMeshBase & mesh): HalfEdgeMeshBase() 
+HalfEdgeMeshBase<Traits>::HalfEdgeMeshBase(const HalfEdgeMeshBase & mesh, 
+    std::pmr::memory_resource * resource): HalfEdgeMeshBase(0, 0, 0, 0, 1e-6, resource) 
 {
   //clear();
   *node_data_ptr_     = *mesh.node_data_ptr_;
   *edge_data_ptr_     = *mesh.edge_data_ptr_;
   *cell_data_ptr_     = *mesh.cell_data_ptr_;
   *halfedge_data_ptr_ = *mesh.halfedge_data_ptr_;
+  bind_storage();
+
+  /** 编号存储的连接关系与地址无关, 不需要重新设置 */
+  if constexpr (Storage::is_relocatable)
+  {
+    update();
+    return;
+  }
 
   auto & node_ = *get_node(); 
   auto & edge_ = *get_edge(); 
@@ -40,82 +48,275 @@ HalfEdgeMeshBase<Traits>::HalfEdgeMeshBase(
   update();
 }
 
+template<typename Traits>
+std::vector<uint32_t> HalfEdgeMeshBase<Traits>::compact()
+{
+  /** 按存储顺序列出存活的实体 */
+  auto live = [](auto & container)
+  {
+    std::vector<uint32_t> order;
+    order.reserve(container.number_of_data());
+    container.for_each_index(0, [&order](uint32_t i) { order.push_back(i); });
+    return order;
+  };
+  std::vector<uint32_t> corder = live(*cell_data_ptr_);
+  permute(live(*node_data_ptr_), live(*edge_data_ptr_), corder, live(*halfedge_data_ptr_));
+  return corder;
+}
+
+template<typename Traits>
+std::vector<uint32_t> HalfEdgeMeshBase<Traits>::reorder()
+{
+  auto & cell = *get_cell(); 
+  auto & halfedge = *get_halfedge();
+
+  /** 单元的重心和它们的包围盒 */
+  std::vector<uint32_t> live;
+  std::vector<Point> bc;
+  live.reserve(number_of_cells());
+  bc.reserve(number_of_cells());
+  double xmin = 1e100, ymin = 1e100, xmax = -1e100, ymax = -1e100;
+  cell_data_ptr_->for_each_index(0, [&](uint32_t i) 
+  { 
+    Point p = cell[i].barycenter();
+    xmin = std::min(xmin, p.x); xmax = std::max(xmax, p.x);
+    ymin = std::min(ymin, p.y); ymax = std::max(ymax, p.y);
+    live.push_back(i);
+    bc.push_back(p);
+  });
+
+  /** 高 32 位是 Morton 码, 低 32 位是原来的顺序, 排序的结果是确定的 */
+  uint32_t NC = live.size();
+  double sx = xmax > xmin ? 65535.0/(xmax-xmin) : 0.0;
+  double sy = ymax > ymin ? 65535.0/(ymax-ymin) : 0.0;
+  std::vector<uint64_t> key(NC);
+  for(uint32_t k = 0; k < NC; k++)
+  {
+    uint16_t x = (bc[k].x-xmin)*sx, y = (bc[k].y-ymin)*sy;
+    key[k] = (uint64_t(morton_code(x, y)) << 32) | k;
+  }
+  std::sort(key.begin(), key.end());
+
+  std::vector<uint32_t> corder(NC);
+  for(uint32_t k = 0; k < NC; k++)
+    corder[k] = live[uint32_t(key[k])];
+
+  /** 按第一次出现的顺序排列, 没有出现的实体放在最后 */
+  auto first_seen = [](auto & container, uint32_t N, const auto & visit)
+  {
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> seen(container.size(), 0);
+    order.reserve(N);
+    auto add = [&](uint32_t i) { if(!seen[i]) { seen[i] = 1; order.push_back(i); } };
+    visit(add);
+    container.for_each_index(0, add);
+    return order;
+  };
+
+  std::vector<uint32_t> horder = first_seen(*halfedge_data_ptr_, number_of_halfedges(), 
+      [&](auto & add)
+  {
+    for(uint32_t c : corder)
+    {
+      HalfEdge * h0 = cell[c].halfedge();
+      HalfEdge * h = h0;
+      do { add(h->index()); h = h->next(); } while(h != h0);
+    }
+  });
+  std::vector<uint32_t> norder = first_seen(*node_data_ptr_, number_of_nodes(), [&](auto & add)
+  {
+    for(uint32_t h : horder)
+      add(halfedge[h].node()->index());
+  });
+  std::vector<uint32_t> eorder = first_seen(*edge_data_ptr_, number_of_edges(), [&](auto & add)
+  {
+    for(uint32_t h : horder)
+      add(halfedge[h].edge()->index());
+  });
+
+  permute(norder, eorder, corder, horder);
+  return corder;
+}
+
+template<typename Traits>
+void HalfEdgeMeshBase<Traits>::permute(const std::vector<uint32_t> & norder, 
+    const std::vector<uint32_t> & eorder, const std::vector<uint32_t> & corder, 
+    const std::vector<uint32_t> & horder)
+{
+  auto & node = *get_node(); 
+  auto & edge = *get_edge(); 
+  auto & cell = *get_cell(); 
+  auto & halfedge = *get_halfedge();
+
+  uint32_t NN = norder.size(), NE = eorder.size();
+  uint32_t NC = corder.size(), NH = horder.size();
+  assert(NN == number_of_nodes() && NE == number_of_edges());
+  assert(NC == number_of_cells() && NH == number_of_halfedges());
+
+  /** 原来的存储位置到新的存储位置 */
+  std::vector<uint32_t> nmap(node.size()), emap(edge.size());
+  std::vector<uint32_t> cmap(cell.size()), hmap(halfedge.size());
+  for(uint32_t k = 0; k < NN; k++) nmap[norder[k]] = k;
+  for(uint32_t k = 0; k < NE; k++) emap[eorder[k]] = k;
+  for(uint32_t k = 0; k < NC; k++) cmap[corder[k]] = k;
+  for(uint32_t k = 0; k < NH; k++) hmap[horder[k]] = k;
+
+  /** 新编号下的连接关系, 重排之后用来重写实体, 孤立的顶点没有半边 */
+  std::vector<uint32_t> nh(NN), eh(NE), ch(NC), hlink(NH*6);
+  for(uint32_t k = 0; k < NN; k++)
+  {
+    HalfEdge * h = node[norder[k]].halfedge();
+    nh[k] = h ? hmap[h->index()] : uint32_t(-1);
+  }
+  for(uint32_t k = 0; k < NE; k++)
+    eh[k] = hmap[edge[eorder[k]].halfedge()->index()];
+  for(uint32_t k = 0; k < NC; k++)
+    ch[k] = hmap[cell[corder[k]].halfedge()->index()];
+  for(uint32_t k = 0; k < NH; k++)
+  {
+    HalfEdge & h = halfedge[horder[k]];
+    uint32_t * l = hlink.data() + 6*k;
+    l[0] = hmap[h.next()->index()];
+    l[1] = hmap[h.previous()->index()];
+    l[2] = hmap[h.opposite()->index()];
+    l[3] = cmap[h.cell()->index()];
+    l[4] = emap[h.edge()->index()];
+    l[5] = nmap[h.node()->index()];
+  }
+
+  node_data_ptr_->permute(norder.data(), NN);
+  edge_data_ptr_->permute(eorder.data(), NE);
+  cell_data_ptr_->permute(corder.data(), NC);
+  halfedge_data_ptr_->permute(horder.data(), NH);
+  bind_storage();
+
+  for(uint32_t k = 0; k < NN; k++)
+    node[k].set_halfedge(nh[k] == uint32_t(-1) ? nullptr : &halfedge[nh[k]]);
+  for(uint32_t k = 0; k < NE; k++)
+    edge[k].set_halfedge(&halfedge[eh[k]]);
+  for(uint32_t k = 0; k < NC; k++)
+    cell[k].set_halfedge(&halfedge[ch[k]]);
+  for(uint32_t k = 0; k < NH; k++)
+  {
+    uint32_t * l = hlink.data() + 6*k;
+    halfedge[k].reset(&halfedge[l[0]], &halfedge[l[1]], &halfedge[l[2]], 
+        &cell[l[3]], &edge[l[4]], &node[l[5]], k);
+  }
+}
+
 /** 
  * @brief 以单元为中心的网格数据为参数的构造函数
- * @note 关键在于生成半边的顶点
  */
 template<typename Traits>
 void HalfEdgeMeshBase<Traits>::reinit(double * node, uint32_t * cell, 
     uint32_t NN, uint32_t NC, uint32_t NV)
 {
-  clear();
-  auto & node_ = *(get_node());
-  for(uint32_t i = 0; i < NN; i++)
-  {
-    Node * n = &add_node();
-    node_[i].set_coordinate(Point(node[2*i], node[2*i+1]));
-  }
+  std::vector<uint32_t> offsets(NC+1);
+  for(uint32_t i = 0; i <= NC; i++)
+    offsets[i] = i*NV;
+  reinit(node, cell, offsets.data(), NN, NC);
+}
 
-  std::vector<std::map<uint32_t, HalfEdge*> > n2n(NN);
-  std::vector<HalfEdge*> c2h(NV);
-  std::vector<uint32_t> previdx(NV);
-  std::vector<uint32_t> nextidx(NV);
-  for(uint32_t i = 0; i < NV; i++)
+/** 
+ * @brief 以单元为中心的网格数据为参数的构造函数
+ * @note 关键在于生成半边的对边: 第 h 条半边从 cell[prev(h)] 指向 cell[h], 
+ *       它的键值由这两个顶点的 (min, max) 组成, 排序之后对边相邻
+ */
+template<typename Traits>
+void HalfEdgeMeshBase<Traits>::reinit(const double * node, const uint32_t * cell, 
+    const uint32_t * offsets, uint32_t NN, uint32_t NC)
+{
+  const uint32_t NH = offsets[NC];
+  auto prev_of = [offsets](uint32_t i, uint32_t h) { return h == offsets[i] ? offsets[i+1]-1 : h-1; };
+  auto next_of = [offsets](uint32_t i, uint32_t h) { return h+1 == offsets[i+1] ? offsets[i] : h+1; };
+
+  /** 半边的键值, 排序后 hidx[k] 是第 k 小的半边 */
+  std::vector<uint64_t> key(NH);
+  std::vector<uint32_t> hidx(NH);
+#pragma omp parallel for schedule(static)
+  for(int64_t i = 0; i < int64_t(NC); i++)
   {
-    previdx[i] = (NV-1+i)%NV;
-    nextidx[i] = (NV+1+i)%NV;
+    for(uint32_t h = offsets[i]; h < offsets[i+1]; h++)
+    {
+      uint32_t v0 = cell[prev_of(i, h)], v1 = cell[h];
+      key[h] = uint64_t(std::min(v0, v1))*NN + std::max(v0, v1);
+      hidx[h] = h;
+    }
   }
+  radix_sort(key, hidx, std::bit_width(uint64_t(NN)*NN));
+
+  /** 
+   * 排序后的第 k 条半边开始一条新的边, 当它与前一条的键值不同, 
+   * 或者前两条已经相同 (非流形边, 前两条已经配对)
+   */
+  auto is_first = [&key](uint32_t k) 
+  { 
+    return k == 0 || key[k] != key[k-1] || (k > 1 && key[k-1] == key[k-2]); 
+  };
+  std::vector<uint32_t> eidx(NH);
+#pragma omp parallel for schedule(static)
+  for(int64_t k = 0; k < int64_t(NH); k++)
+    eidx[k] = is_first(k);
+  const uint32_t NE = exclusive_scan(eidx);
+
+  node_data_ptr_ = make_container<NodeDataContainer>(NN);
+  edge_data_ptr_ = make_container<EdgeDataContainer>(NE);
+  cell_data_ptr_ = make_container<CellDataContainer>(NC);
+  halfedge_data_ptr_ = make_container<HalfEdgeDataContainer>(NH);
+  bind_storage();
+
+  auto & node_ = *get_node(); 
+  auto & edge_ = *get_edge(); 
+  auto & cell_ = *get_cell(); 
+  auto & halfedge_ = *get_halfedge();
+
   /** 生成 halfedge_to_cell, halfedge_to_node, next_halfedge **/
-  for(uint32_t i = 0; i < NC; i++)
+#pragma omp parallel for schedule(static)
+  for(int64_t i = 0; i < int64_t(NC); i++)
   {
-    Cell & c = add_cell();
-    for(uint32_t j = 0; j < NV; j++)
-      c2h[j] = &add_halfedge();
-    for(uint32_t j = 0; j < NV; j++)
+    for(uint32_t h = offsets[i]; h < offsets[i+1]; h++)
     {
-      c2h[j]->reset(c2h[nextidx[j]], 
-                    c2h[previdx[j]], 
-                    c2h[j], 
-                    &c, 
-                    nullptr, 
-                    &node_[cell[i*NV+j]], 
-                    c2h[j]->index());
-      n2n[cell[i*NV+previdx[j]]].emplace(std::pair<uint32_t, HalfEdge * >(cell[i*NV+j], c2h[j]));
-      node_[cell[i*NV+j]].set_halfedge(c2h[j]);
+      halfedge_[h].reset(&halfedge_[next_of(i, h)], &halfedge_[prev_of(i, h)], 
+          &halfedge_[h], &cell_[i], nullptr, &node_[cell[h]], h);
     }
-    c.reset(i, c2h[0]);
+    cell_[i].reset(i, &halfedge_[offsets[i]]);
   }
 
-  /** 生成 edge, opposite_halfedge, halfedge_to_edge, node 的半边 */
-  for(uint32_t i = 0; i < NN; i++)
+  /** 生成 edge, opposite_halfedge, halfedge_to_edge, 边的半边从编号小的顶点出发 */
+#pragma omp parallel for schedule(static)
+  for(int64_t k = 0; k < int64_t(NH); k++)
   {
-    for(auto & it : n2n[i])
+    if(!is_first(k))
+      continue;
+    Edge & e = edge_[eidx[k]];
+    HalfEdge * h0 = &halfedge_[hidx[k]];
+    h0->set_edge(&e);
+    if(k+1 < NH && !is_first(k+1))
     {
-      if(it.second->edge() == nullptr)
-      {
-        const auto & oppoit = n2n[it.first].find(i);
-        if(oppoit != n2n[it.first].end())
-        {
-          it.second->set_opposite(oppoit->second);
-          oppoit->second->set_opposite(it.second);
-        }
-        Edge & e = add_edge();
-        e.reset(number_of_edges()-1, it.second);
-        it.second->set_edge(&e);
-        it.second->opposite()->set_edge(&e);
-      }
+      HalfEdge * h1 = &halfedge_[hidx[k+1]];
+      h0->set_opposite(h1);
+      h1->set_opposite(h0);
+      h1->set_edge(&e);
+      if(cell[hidx[k]] < cell[hidx[k+1]])
+        h0 = h1;
     }
+    e.reset(eidx[k], h0);
   }
-  for(auto & n : node_)
+
+  /** 顶点的半边是指向它的编号最大的半边, 边界点的半边在 update 中改为边界半边 */
+  std::vector<uint32_t> nh(NN, 0);
+#pragma omp parallel for schedule(static)
+  for(int64_t h = 0; h < int64_t(NH); h++)
   {
-    HalfEdge * h = n.halfedge(); 
-    if(!h->is_boundary())
-    {
-      h = h->opposite()->previous();
-      while(!h->is_boundary() && h != n.halfedge())
-        h = h->opposite()->previous();
-    }
-    n.set_halfedge(h);
+    std::atomic_ref<uint32_t> r(nh[cell[h]]);
+    uint32_t v = r.load(std::memory_order_relaxed);
+    while(v < h+1 && !r.compare_exchange_weak(v, uint32_t(h+1), std::memory_order_relaxed));
+  }
+#pragma omp parallel for schedule(static)
+  for(int64_t i = 0; i < int64_t(NN); i++)
+  {
+    node_[i].reset(Point(node[2*i], node[2*i+1]), i, 
+        nh[i] ? &halfedge_[nh[i]-1] : nullptr);
   }
   update();
 }
@@ -132,32 +333,97 @@ HalfEdgeMeshBase<Traits> & HalfEdgeMeshBase<Traits>::operator = (const Self & ot
 }
 
 /**
- * @brief 节点迭代函数
+ * @brief 实体迭代函数, f 可以返回 bool 或 void
  */
 template<typename Traits>
-template<typename Entity>
-void HalfEdgeMeshBase<Traits>::for_each_entity(
-    const std::function<bool(Entity & )> & f)
+template<typename Entity, typename Fun>
+bool HalfEdgeMeshBase<Traits>::for_each_entity(const Fun & f)
 {
-  auto & entitys = *(get_entity<Entity>());
-  for(auto & e : entitys)
-  {
-    f(e);
-  }
+  return get_entity<Entity>()->for_each(f);
+}
+
+template<typename Traits>
+template<typename Entity, typename Fun>
+bool HalfEdgeMeshBase<Traits>::for_each_entity(const Fun & f) const
+{
+  return get_entity<Entity>()->for_each(f);
 }
 
 /**
- * @brief 节点迭代函数
+ * @brief 并行的实体迭代函数
+ * @note 每个块是一个任务, 块内跳过被释放的位置。删除了很多实体的网格中各个块
+ *   的工作量不同, 空闲的线程会取走还没有开始的块, 所以负载是均衡的。
  */
 template<typename Traits>
-template<typename Entity>
-void HalfEdgeMeshBase<Traits>::parallel_for_each_entity(
-    const std::function<bool(Entity & )> & f)
+template<typename Entity, typename Fun>
+void HalfEdgeMeshBase<Traits>::parallel_for_each_entity(const Fun & f)
 {
   auto & entitys = *get_entity<Entity>();
-  #pragma omp parallel for
-  for(auto & e : entitys)
-    f(e);
+  int64_t NChunk = entitys.number_of_chunks();
+  #pragma omp parallel
+  #pragma omp single
+  #pragma omp taskloop grainsize(1)
+  for(int64_t k = 0; k < NChunk; k++)
+    entitys.for_each_in_chunk(k, f);
+}
+
+
+template<typename Traits>
+typename HalfEdgeMeshBase<Traits>::Cell * 
+HalfEdgeMeshBase<Traits>::walk_to_point(const Point & p, Cell * c, uint32_t max_steps) const
+{
+  const Point q = c->barycenter();
+  const Vector d = p-q;
+  HalfEdge * from = nullptr; /**< 进入当前单元时穿过的半边 */
+  for(uint32_t step = 0; step < max_steps; step++)
+  {
+    HalfEdge * h0 = from ? from->next() : c->halfedge();
+    HalfEdge * h = h0;
+    HalfEdge * out = nullptr;
+    bool outside = false;
+    do
+    {
+      const Point & a = h->previous()->node()->coordinate();
+      const Point & b = h->node()->coordinate();
+      if(h != from && (b-a).cross(p-a) < 0)
+      {
+        /** p 在这条边的外侧, 且线段 [q, p] 穿过这条边 */
+        outside = true;
+        double sa = d.cross(a-q), sb = d.cross(b-q);
+        if((sa <= 0 && sb >= 0) || (sa >= 0 && sb <= 0))
+        {
+          out = h;
+          break;
+        }
+      }
+      h = h->next();
+    } while(h != h0);
+
+    if(!outside)
+      return c;
+    if(!out || out->is_boundary())
+      return nullptr;
+    from = out->opposite();
+    c = from->cell();
+  }
+  return nullptr;
+}
+
+template<typename Traits>
+bool HalfEdgeMeshBase<Traits>::is_strictly_inside(const Point & p, const Cell * c, double d) const
+{
+  const HalfEdge * h0 = c->halfedge();
+  const HalfEdge * h = h0;
+  do
+  {
+    const Point & a = h->previous()->node()->coordinate();
+    const Point & b = h->node()->coordinate();
+    Vector v = b-a;
+    if(v.cross(p-a) <= d*v.length())
+      return false;
+    h = h->next();
+  } while(h != h0);
+  return true;
 }
 
 }
@@ -0,0 +1,390 @@
+namespace HEM{
+
+namespace soa_detail
+{
+/** 
+ * 全掩码的 intrinsics, 显式给出源操作数, 避免 GCC 对不带掩码的
+ * gather, min, max 等给出 maybe-uninitialized 警告 
+ */
+#if defined(__AVX512F__)
+inline __m256i gather_epi32(const int * base, __m256i idx)
+{
+  return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base, idx, _mm256_set1_epi32(-1), 4);
+}
+
+inline __m512d gather_pd(const double * base, __m256i idx)
+{
+  return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, idx, base, 8);
+}
+
+inline __m512d min_pd(__m512d a, __m512d b) { return _mm512_mask_min_pd(a, 0xFF, a, b); }
+
+inline __m512d max_pd(__m512d a, __m512d b) { return _mm512_mask_max_pd(a, 0xFF, a, b); }
+
+inline __m512d cvtepi32_pd(__m256i a) 
+{ 
+  return _mm512_mask_cvtepi32_pd(_mm512_setzero_pd(), 0xFF, a); 
+}
+#elif defined(__AVX2__)
+inline __m128i gather_epi32(const int * base, __m128i idx)
+{
+  return _mm_mask_i32gather_epi32(_mm_setzero_si128(), base, idx, _mm_set1_epi32(-1), 4);
+}
+
+inline __m256d gather_pd(const double * base, __m128i idx)
+{
+  return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, idx, 
+      _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+}
+#endif
+}
+
+/**
+ * @brief 由网格生成快照
+ */
+template<typename Mesh>
+void SoAMesh<Mesh>::build(Mesh & mesh)
+{
+  mesh.update();
+
+  auto & nindex = *(mesh.get_node_indices());
+  auto & eindex = *(mesh.get_edge_indices());
+  auto & cindex = *(mesh.get_cell_indices());
+  auto & hindex = *(mesh.get_halfedge_indices());
+
+  uint32_t NN = mesh.number_of_nodes();
+  uint32_t NC = mesh.number_of_cells();
+  uint32_t NH = mesh.number_of_halfedges();
+
+  x_.resize(NN);
+  y_.resize(NN);
+  for(auto & n : *mesh.get_node())
+  {
+    uint32_t i = nindex[n.index()];
+    x_[i] = n.coordinate().x;
+    y_[i] = n.coordinate().y;
+  }
+
+  next_.resize(NH); prev_.resize(NH); oppo_.resize(NH);
+  node_.resize(NH); cell_.resize(NH); edge_.resize(NH);
+  for(auto & h : *mesh.get_halfedge())
+  {
+    uint32_t i = hindex[h.index()];
+    next_[i] = hindex[h.next()->index()];
+    prev_[i] = hindex[h.previous()->index()];
+    oppo_[i] = hindex[h.opposite()->index()];
+    node_[i] = nindex[h.node()->index()];
+    cell_[i] = cindex[h.cell()->index()];
+    edge_[i] = eindex[h.edge()->index()];
+  }
+
+  /** 生成 CSR 结构: 先统计每个单元的半边个数, 再填充 */
+  cell_offset_.assign(NC+1, 0);
+  for(auto & c : *mesh.get_cell())
+  {
+    uint32_t n = 1;
+    for(HalfEdge * h = c.halfedge()->next(); h != c.halfedge(); h = h->next())
+      n++;
+    cell_offset_[cindex[c.index()]+1] = n;
+  }
+  for(uint32_t i = 0; i < NC; i++)
+    cell_offset_[i+1] += cell_offset_[i];
+
+  cell_halfedge_.resize(cell_offset_[NC]);
+  cell_node_.resize(cell_offset_[NC]);
+  for(auto & c : *mesh.get_cell())
+  {
+    uint32_t k = cell_offset_[cindex[c.index()]];
+    HalfEdge * h = c.halfedge();
+    do
+    {
+      cell_halfedge_[k] = hindex[h->index()];
+      cell_node_[k++] = nindex[h->previous()->node()->index()];
+      h = h->next();
+    }
+    while(h != c.halfedge());
+  }
+}
+
+template<typename Mesh>
+template<typename Kernel>
+void SoAMesh<Mesh>::for_each_block(const Kernel & kernel) const
+{
+  int64_t NC = number_of_cells();
+  #pragma omp parallel for schedule(static)
+  for(int64_t begin = 0; begin < NC; begin += BlockSize)
+    kernel(begin, std::min<int64_t>(begin+BlockSize, NC));
+}
+
+template<typename Mesh>
+void SoAMesh<Mesh>::cell_area(double * area) const
+{
+  for_each_block([&](uint32_t begin, uint32_t end)
+      { cell_area_kernel(area, begin, end); });
+}
+
+template<typename Mesh>
+void SoAMesh<Mesh>::cell_barycenter(double * bx, double * by) const
+{
+  for_each_block([&](uint32_t begin, uint32_t end)
+      { cell_barycenter_kernel(bx, by, begin, end); });
+}
+
+template<typename Mesh>
+void SoAMesh<Mesh>::cell_box(double * xmin, double * ymin,
+    double * xmax, double * ymax) const
+{
+  for_each_block([&](uint32_t begin, uint32_t end)
+      { cell_box_kernel(xmin, ymin, xmax, ymax, begin, end); });
+}
+
+/**
+ * @brief 单元面积, 与 TCell::area() 一样以第 0 个顶点为中心做扇形剖分
+ * @note SIMD 版本每个通道计算一个单元, 通道 j 的第 k 个顶点不存在时
+ *       读取第 0 个顶点, 此时叉积为 0, 不需要额外的掩码
+ */
+template<typename Mesh>
+void SoAMesh<Mesh>::cell_area_kernel(double * area, uint32_t begin, uint32_t end) const
+{
+  const uint32_t * off = cell_offset_.data();
+  const int * cn = reinterpret_cast<const int *>(cell_node_.data());
+  const double * x = x_.data();
+  const double * y = y_.data();
+
+  uint32_t i = begin;
+#if defined(__AVX512F__)
+  for(; i+8 <= end; i += 8)
+  {
+    __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(off+i));
+    __m256i n = _mm256_sub_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(off+i+1)), o);
+    uint32_t nmax = 0;
+    for(uint32_t j = 0; j < 8; j++)
+      nmax = std::max(nmax, off[i+j+1]-off[i+j]);
+
+    __m256i v0 = soa_detail::gather_epi32(cn, o);
+    __m512d x0 = soa_detail::gather_pd(x, v0);
+    __m512d y0 = soa_detail::gather_pd(y, v0);
+    __m256i v1 = soa_detail::gather_epi32(cn, _mm256_add_epi32(o, _mm256_set1_epi32(1)));
+    __m512d dx0 = _mm512_sub_pd(soa_detail::gather_pd(x, v1), x0);
+    __m512d dy0 = _mm512_sub_pd(soa_detail::gather_pd(y, v1), y0);
+    __m512d a = _mm512_setzero_pd();
+    for(uint32_t k = 2; k < nmax; k++)
+    {
+      __m256i mask = _mm256_cmpgt_epi32(n, _mm256_set1_epi32(k));
+      __m256i vk = _mm256_mask_i32gather_epi32(v0, cn,
+          _mm256_add_epi32(o, _mm256_set1_epi32(k)), mask, 4);
+      __m512d dx1 = _mm512_sub_pd(soa_detail::gather_pd(x, vk), x0);
+      __m512d dy1 = _mm512_sub_pd(soa_detail::gather_pd(y, vk), y0);
+      a = _mm512_add_pd(a, _mm512_sub_pd(_mm512_mul_pd(dx0, dy1), _mm512_mul_pd(dy0, dx1)));
+      dx0 = dx1; dy0 = dy1;
+    }
+    _mm512_storeu_pd(area+i, _mm512_mul_pd(a, _mm512_set1_pd(0.5)));
+  }
+#elif defined(__AVX2__)
+  for(; i+4 <= end; i += 4)
+  {
+    __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i *>(off+i));
+    __m128i n = _mm_sub_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(off+i+1)), o);
+    uint32_t nmax = 0;
+    for(uint32_t j = 0; j < 4; j++)
+      nmax = std::max(nmax, off[i+j+1]-off[i+j]);
+
+    __m128i v0 = soa_detail::gather_epi32(cn, o);
+    __m256d x0 = soa_detail::gather_pd(x, v0);
+    __m256d y0 = soa_detail::gather_pd(y, v0);
+    __m128i v1 = soa_detail::gather_epi32(cn, _mm_add_epi32(o, _mm_set1_epi32(1)));
+    __m256d dx0 = _mm256_sub_pd(soa_detail::gather_pd(x, v1), x0);
+    __m256d dy0 = _mm256_sub_pd(soa_detail::gather_pd(y, v1), y0);
+    __m256d a = _mm256_setzero_pd();
+    for(uint32_t k = 2; k < nmax; k++)
+    {
+      __m128i mask = _mm_cmpgt_epi32(n, _mm_set1_epi32(k));
+      __m128i vk = _mm_mask_i32gather_epi32(v0, cn,
+          _mm_add_epi32(o, _mm_set1_epi32(k)), mask, 4);
+      __m256d dx1 = _mm256_sub_pd(soa_detail::gather_pd(x, vk), x0);
+      __m256d dy1 = _mm256_sub_pd(soa_detail::gather_pd(y, vk), y0);
+      a = _mm256_add_pd(a, _mm256_sub_pd(_mm256_mul_pd(dx0, dy1), _mm256_mul_pd(dy0, dx1)));
+      dx0 = dx1; dy0 = dy1;
+    }
+    _mm256_storeu_pd(area+i, _mm256_mul_pd(a, _mm256_set1_pd(0.5)));
+  }
+#endif
+  for(; i < end; i++)
+  {
+    const int * v = cn + off[i];
+    uint32_t n = off[i+1]-off[i];
+    double dx0 = x[v[1]]-x[v[0]], dy0 = y[v[1]]-y[v[0]];
+    double a = 0.0;
+    for(uint32_t k = 2; k < n; k++)
+    {
+      double dx1 = x[v[k]]-x[v[0]], dy1 = y[v[k]]-y[v[0]];
+      a += dx0*dy1 - dy0*dx1;
+      dx0 = dx1; dy0 = dy1;
+    }
+    area[i] = a*0.5;
+  }
+}
+
+/**
+ * @brief 单元重心, 即所有顶点的平均值
+ */
+template<typename Mesh>
+void SoAMesh<Mesh>::cell_barycenter_kernel(double * bx, double * by,
+    uint32_t begin, uint32_t end) const
+{
+  const uint32_t * off = cell_offset_.data();
+  const int * cn = reinterpret_cast<const int *>(cell_node_.data());
+  const double * x = x_.data();
+  const double * y = y_.data();
+
+  uint32_t i = begin;
+#if defined(__AVX512F__)
+  for(; i+8 <= end; i += 8)
+  {
+    __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(off+i));
+    __m256i n = _mm256_sub_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(off+i+1)), o);
+    uint32_t nmax = 0;
+    for(uint32_t j = 0; j < 8; j++)
+      nmax = std::max(nmax, off[i+j+1]-off[i+j]);
+
+    __m512d sx = _mm512_setzero_pd();
+    __m512d sy = _mm512_setzero_pd();
+    for(uint32_t k = 0; k < nmax; k++)
+    {
+      __m256i mask = _mm256_cmpgt_epi32(n, _mm256_set1_epi32(k));
+      __mmask8 m = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+      __m256i vk = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), cn,
+          _mm256_add_epi32(o, _mm256_set1_epi32(k)), mask, 4);
+      sx = _mm512_mask_add_pd(sx, m, sx, _mm512_mask_i32gather_pd(sx, m, vk, x, 8));
+      sy = _mm512_mask_add_pd(sy, m, sy, _mm512_mask_i32gather_pd(sy, m, vk, y, 8));
+    }
+    __m512d nd = soa_detail::cvtepi32_pd(n);
+    _mm512_storeu_pd(bx+i, _mm512_div_pd(sx, nd));
+    _mm512_storeu_pd(by+i, _mm512_div_pd(sy, nd));
+  }
+#elif defined(__AVX2__)
+  for(; i+4 <= end; i += 4)
+  {
+    __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i *>(off+i));
+    __m128i n = _mm_sub_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(off+i+1)), o);
+    uint32_t nmax = 0;
+    for(uint32_t j = 0; j < 4; j++)
+      nmax = std::max(nmax, off[i+j+1]-off[i+j]);
+
+    __m256d sx = _mm256_setzero_pd();
+    __m256d sy = _mm256_setzero_pd();
+    for(uint32_t k = 0; k < nmax; k++)
+    {
+      __m128i mask = _mm_cmpgt_epi32(n, _mm_set1_epi32(k));
+      __m256d maskd = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(mask));
+      __m128i vk = _mm_mask_i32gather_epi32(_mm_setzero_si128(), cn,
+          _mm_add_epi32(o, _mm_set1_epi32(k)), mask, 4);
+      sx = _mm256_add_pd(sx, _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, vk, maskd, 8));
+      sy = _mm256_add_pd(sy, _mm256_mask_i32gather_pd(_mm256_setzero_pd(), y, vk, maskd, 8));
+    }
+    __m256d nd = _mm256_cvtepi32_pd(n);
+    _mm256_storeu_pd(bx+i, _mm256_div_pd(sx, nd));
+    _mm256_storeu_pd(by+i, _mm256_div_pd(sy, nd));
+  }
+#endif
+  for(; i < end; i++)
+  {
+    const int * v = cn + off[i];
+    uint32_t n = off[i+1]-off[i];
+    double sx = 0.0, sy = 0.0;
+    for(uint32_t k = 0; k < n; k++)
+    {
+      sx += x[v[k]];
+      sy += y[v[k]];
+    }
+    bx[i] = sx/n;
+    by[i] = sy/n;
+  }
+}
+
+/**
+ * @brief 单元包围盒, 不存在的顶点读取第 0 个顶点, 不影响最大最小值
+ */
+template<typename Mesh>
+void SoAMesh<Mesh>::cell_box_kernel(double * xmin, double * ymin,
+    double * xmax, double * ymax, uint32_t begin, uint32_t end) const
+{
+  const uint32_t * off = cell_offset_.data();
+  const int * cn = reinterpret_cast<const int *>(cell_node_.data());
+  const double * x = x_.data();
+  const double * y = y_.data();
+
+  uint32_t i = begin;
+#if defined(__AVX512F__)
+  for(; i+8 <= end; i += 8)
+  {
+    __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(off+i));
+    __m256i n = _mm256_sub_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(off+i+1)), o);
+    uint32_t nmax = 0;
+    for(uint32_t j = 0; j < 8; j++)
+      nmax = std::max(nmax, off[i+j+1]-off[i+j]);
+
+    __m256i v0 = soa_detail::gather_epi32(cn, o);
+    __m512d x0 = soa_detail::gather_pd(x, v0), x1 = x0;
+    __m512d y0 = soa_detail::gather_pd(y, v0), y1 = y0;
+    for(uint32_t k = 1; k < nmax; k++)
+    {
+      __m256i mask = _mm256_cmpgt_epi32(n, _mm256_set1_epi32(k));
+      __m256i vk = _mm256_mask_i32gather_epi32(v0, cn,
+          _mm256_add_epi32(o, _mm256_set1_epi32(k)), mask, 4);
+      __m512d xk = soa_detail::gather_pd(x, vk);
+      __m512d yk = soa_detail::gather_pd(y, vk);
+      x0 = soa_detail::min_pd(x0, xk); x1 = soa_detail::max_pd(x1, xk);
+      y0 = soa_detail::min_pd(y0, yk); y1 = soa_detail::max_pd(y1, yk);
+    }
+    _mm512_storeu_pd(xmin+i, x0); _mm512_storeu_pd(ymin+i, y0);
+    _mm512_storeu_pd(xmax+i, x1); _mm512_storeu_pd(ymax+i, y1);
+  }
+#elif defined(__AVX2__)
+  for(; i+4 <= end; i += 4)
+  {
+    __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i *>(off+i));
+    __m128i n = _mm_sub_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(off+i+1)), o);
+    uint32_t nmax = 0;
+    for(uint32_t j = 0; j < 4; j++)
+      nmax = std::max(nmax, off[i+j+1]-off[i+j]);
+
+    __m128i v0 = soa_detail::gather_epi32(cn, o);
+    __m256d x0 = soa_detail::gather_pd(x, v0), x1 = x0;
+    __m256d y0 = soa_detail::gather_pd(y, v0), y1 = y0;
+    for(uint32_t k = 1; k < nmax; k++)
+    {
+      __m128i mask = _mm_cmpgt_epi32(n, _mm_set1_epi32(k));
+      __m128i vk = _mm_mask_i32gather_epi32(v0, cn,
+          _mm_add_epi32(o, _mm_set1_epi32(k)), mask, 4);
+      __m256d xk = soa_detail::gather_pd(x, vk);
+      __m256d yk = soa_detail::gather_pd(y, vk);
+      x0 = _mm256_min_pd(x0, xk); x1 = _mm256_max_pd(x1, xk);
+      y0 = _mm256_min_pd(y0, yk); y1 = _mm256_max_pd(y1, yk);
+    }
+    _mm256_storeu_pd(xmin+i, x0); _mm256_storeu_pd(ymin+i, y0);
+    _mm256_storeu_pd(xmax+i, x1); _mm256_storeu_pd(ymax+i, y1);
+  }
+#endif
+  for(; i < end; i++)
+  {
+    const int * v = cn + off[i];
+    uint32_t n = off[i+1]-off[i];
+    double x0 = x[v[0]], x1 = x0, y0 = y[v[0]], y1 = y0;
+    for(uint32_t k = 1; k < n; k++)
+    {
+      x0 = std::min(x0, x[v[k]]); x1 = std::max(x1, x[v[k]]);
+      y0 = std::min(y0, y[v[k]]); y1 = std::max(y1, y[v[k]]);
+    }
+    xmin[i] = x0; ymin[i] = y0;
+    xmax[i] = x1; ymax[i] = y1;
+  }
+}
+
+}
@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 
+#include "tools.h"
+
 /**
  * @brief 表示一个二维界面, 这个界面由一些点组成，这些点可能在边上，
  * 也可能在节点上， 经过判断，会对点进行很小的移动，使得点在边上或者节点上。
@@ -36,7 +38,7 @@ public: /** 类型定义 */
   {
     Point point;
     bool is_fixed_point;
-    std::vector<Cell * > cells;
+    HEM::SmallVector<Cell *, 8> cells; /**< 一般不超过 8 个, 不需要分配内存 */
     HalfEdge * h;             
     uint8_t type;             
   };
@@ -59,11 +61,14 @@ public: /** 方法 */
                bool _is_loop=true): mesh_(mesh), is_loop_(_is_loop)
   {
     uint32_t N = points.size();
+    points_.reserve(N);
     for(uint32_t i = 0; i < N; i++)
     {
+      /** 相邻的界面点一般在相邻的单元中, 从上一个点的单元开始找 */
       InterfacePoint ip;
       ip.is_fixed_point = is_fixed_points[i];
-      point_to_interface_point(points[i], ip);
+      Cell * hint = points_.empty() || points_.back().cells.empty() ? nullptr : points_.back().cells[0];
+      point_to_interface_point(points[i], ip, hint);
       points_.push_back(ip);
     }
   }
@@ -82,8 +87,10 @@ public: /** 方法 */
    * @brief 获取一个点所在的单元，
    * 如果点在边上，返回两个单元，如果点在节点上，返回相邻的单元, 
    * 同时更新点的坐标。
+   * @param hint : 查找的起点, 见 Mesh::find_point
    */
-  void point_to_interface_point(Point point, InterfacePoint & inerface_point);
+  void point_to_interface_point(Point point, InterfacePoint & inerface_point, 
+      Cell * hint = nullptr);
 
   /**
    * @brief 判断界面是否是闭的
@@ -101,21 +108,21 @@ public: /** 方法 */
  * 同时更新点的坐标。
  */
 template<typename Mesh>
-void InterfaceCut<Mesh>::point_to_interface_point(Point point, InterfacePoint & ip)
+void InterfaceCut<Mesh>::point_to_interface_point(Point point, InterfacePoint & ip, Cell * hint)
 {
   auto & cells = ip.cells;
   auto & geometry_utils = mesh_->geometry_utils();
   Cell * c = nullptr;
   uint32_t index = 0;
-  uint8_t flag = mesh_->find_point(point, c, index);
+  uint8_t flag = mesh_->find_point(point, c, index, hint);
   if(flag == 0)/** 在第 index 个节点上 */
   {
     Node * node = c->adj_node(index);
     HalfEdge * h = c->halfedge()->previous()->next(index);
 
-    cells.resize(32);
-    uint32_t N = node->adj_cell(cells.data());
-    cells.resize(N);
+    Cell * node2cell[32];
+    uint32_t N = node->adj_cell(node2cell);
+    cells.assign(node2cell, node2cell+N);
 
     point   = node->coordinate(); /**< 更新点的坐标 */
     ip.h = h; 
@@ -2,297 +2,169 @@
 #define _MARK_ARRAY_
 
 #include <cassert>
+#include <stdint.h>
 #include <vector>
-#include <stdexcept>
-#include <memory>
+#include <algorithm>
+#include <bit>
+#include <atomic>
+#include <memory_resource>
 
-/**
- * @brief ChunkArray 基类
- */
-class ArrayBase 
+namespace HEM
 {
-public:
-  ArrayBase(std::string name): name_(name) {}
-
-  std::string get_name()
-  {
-    return name_;
-  }
-
-  const std::string get_name() const
-  {
-    return name_;
-  }
-
-  void set_name(std::string name)
-  {
-    name_ = name;
-  }
-
-  virtual void resize(size_t size) = 0;
-
-  virtual void clear() = 0;
-
-  virtual void release() = 0;
-
-  virtual std::shared_ptr<ArrayBase> copy_self() = 0;
-
-private:
-  std::string name_;
-};
 
 /**
- * @brief bool 类型的 chunk array, 使用 uint32_t 表示 32 位的 bool 值. 
+ * @brief bool 类型的 chunk array, 使用 uint64_t 表示 64 位的 bool 值.
+ * @note 新分配的位都是 false, 块从 resource_ 分配
  */
-template <size_t ChunkSize = 1024u>
-class ChunkArrayBool : public ArrayBase 
+template <uint32_t CHUNK_SIZE = 1024u>
+class ChunkArrayBool
 {
 public:
-  // 构造函数
-  ChunkArrayBool(std::string name) : ArrayBase(name), size_(0), chunks_(0) {}
+  const constexpr static uint32_t ChunkSize = CHUNK_SIZE;
+  const constexpr static uint32_t WordSize = 64u;
+  const constexpr static uint32_t WordsPerChunk = ChunkSize/WordSize;
+  static_assert(ChunkSize % WordSize == 0, "ChunkSize must be a multiple of 64.");
 
+public:
   // 构造函数
-  ChunkArrayBool(std::string name, int size) : ArrayBase(name), size_(0), chunks_(0) 
+  ChunkArrayBool(size_t size = 0, std::pmr::memory_resource * resource = nullptr) : 
+    size_(0), chunks_(0), resource_(get_resource(resource))
   {
     resize(size);
   }
 
-  // 析构函数，释放分配的内存
-  ~ChunkArrayBool() 
+  // 复制构造函数
+  ChunkArrayBool(const ChunkArrayBool & other, std::pmr::memory_resource * resource = nullptr) : 
+    size_(0), chunks_(0), resource_(get_resource(resource))
   {
-    for (uint32_t* chunk : chunks_)
-      delete[] chunk;
+    this->copy(other);
   }
 
-  void release() override
+  // 析构函数，释放分配的内存
+  ~ChunkArrayBool()
   {
-    for (uint32_t* chunk : chunks_)
-      delete[] chunk;
+    for (uint64_t* chunk : chunks_)
+      deallocate_chunk(chunk);
   }
 
   void set_true()
   {
     for(auto & chunk : chunks_)
-      std::fill(chunk, chunk+(ChunkSize/32), 4294967295);
+      std::fill(chunk, chunk+WordsPerChunk, ~uint64_t(0));
   }
 
   void set_false()
   {
     for(auto & chunk : chunks_)
-      std::fill(chunk, chunk+(ChunkSize/32), 0);
+      std::fill(chunk, chunk+WordsPerChunk, uint64_t(0));
   }
 
   // 设置指定位置的 bool 值
-  void set_true(size_t index) 
+  void set_true(size_t index)
   {
     assert(index < size_ && "Index out of range");
-    size_t chunkIndex = index / ChunkSize;  // 计算是第几个 chunk
-    size_t offset = index % ChunkSize;  // 计算在这个 chunk 中的偏移位置
-    size_t intIndex = offset / 32;
-    offset %= 32;
-    chunks_[chunkIndex][intIndex] |= (1u << offset);  // 设置为 1
+    word(index/WordSize) |= (uint64_t(1) << (index % WordSize));
   }
 
   // 设置指定位置的 bool 值
-  void set_false(size_t index) 
+  void set_false(size_t index)
   {
     assert(index < size_ && "Index out of range");
-    size_t chunkIndex = index / ChunkSize;  // 计算是第几个 chunk
-    size_t offset = index % ChunkSize;  // 计算在这个 chunk 中的偏移位置
-    size_t intIndex = offset / 32;
-    offset %= 32;
-    chunks_[chunkIndex][intIndex] &= ~(1u << offset);  // 设置为 0
+    word(index/WordSize) &= ~(uint64_t(1) << (index % WordSize));
   }
 
-  // 获取指定位置的 bool 值
-  bool get(size_t index) const 
+  /** 
+   * @brief 原子地设置指定位置的值, 多个线程可以同时设置同一个字中的不同位
+   */
+  void atomic_set_true(size_t index)
   {
     assert(index < size_ && "Index out of range");
-    size_t chunkIndex = index / ChunkSize;  // 计算是第几个 chunk
-    size_t offset = index % ChunkSize;  // 计算在这个 chunk 中的偏移位置
-    size_t intIndex = offset / 32;
-    offset %= 32;
-    return (chunks_[chunkIndex][intIndex] & (1u << offset)) != 0;  // 检查指定位置是否为 1
-  }
-
-  void push_back() { push_back_true(); }
-
-  void push_back_true()
-  {
-    if (size_ == capacity())
-      chunks_.emplace_back(new  uint32_t[ChunkSize/32]);
-    set_true(size_);
-    size_++;
-  }
-
-  void push_back_false()
-  {
-    if (size_ == capacity())
-      chunks_.emplace_back(new  uint32_t[ChunkSize/32]);
-    set_false(size_);
-    size_++;
+    std::atomic_ref<uint64_t>(word(index/WordSize)).fetch_or(uint64_t(1) << (index % WordSize));
   }
 
-  // 交换两个 ChunkArray 的内容
-  void swap(ChunkArrayBool& other) 
+  void atomic_set_false(size_t index)
   {
-    std::swap(chunks_, other.chunks_);
-    std::swap(size_, other.size_);
+    assert(index < size_ && "Index out of range");
+    std::atomic_ref<uint64_t>(word(index/WordSize)).fetch_and(~(uint64_t(1) << (index % WordSize)));
   }
 
-  // 获取当前元素个数
-  size_t size() const { return size_;}
-
-  // 获取当前分配的内存容量
-  size_t capacity() const { return chunks_.size() * ChunkSize;}
-
-  void clear() override { size_ = 0;}
-
-  // 复制另一个 ChunkArrayBool 的内容
-  void copy(const ChunkArrayBool& other) 
+  // 获取指定位置的 bool 值
+  bool get(size_t index) const
   {
-    if(this != &other)
-    {
-      this->set_name(other->get_name());
-      resize(other.size_);
-      uint32_t N_chunk = other.chunks_.size();
-      for (size_t i = 0; i < N_chunk; ++i) 
-        std::copy(other.chunks_[i], other.chunks_[i]+ChunkSize/32, chunks_[i]);
-    }
+    assert(index < size_ && "Index out of range");
+    return (word(index/WordSize) >> (index % WordSize)) & 1u;
   }
 
   // 获取元素
-  bool operator[](uint32_t index) const { return get(index); }
-
-  /** @brief operator =  */
-  ChunkArrayBool & operator = (const ChunkArrayBool & other)
-  {
-    this->copy(other);
-    return *this;
-  }
-
-  // 预留空间，使得至少可以容纳指定数量的元素
-  void reserve(size_t newCapacity) 
-  {
-    if (newCapacity > capacity()) 
-    {
-      size_t requiredChunks = (newCapacity + ChunkSize - 1) / ChunkSize;
-      chunks_.resize(requiredChunks, nullptr);
-      for (size_t i = capacity()/ChunkSize; i < requiredChunks; ++i) 
-        chunks_[i] = new uint32_t[ChunkSize/32]();
-    }
-  }
+  bool operator[](size_t index) const { return get(index); }
 
-  void resize(size_t newSize) override
-  {
-    reserve(newSize);  // 如果新大小大于当前大小，调用 reserve 函数
-    size_ = newSize;
-  }
-
-private:
-    size_t size_;  // 元素个数
-    std::vector<uint32_t*> chunks_;  // 存储块的指针
-};
+  /** 第 w 个 64 位的字 */
+  uint64_t & word(size_t w) { return chunks_[w/WordsPerChunk][w%WordsPerChunk]; }
 
+  const uint64_t & word(size_t w) const { return chunks_[w/WordsPerChunk][w%WordsPerChunk]; }
 
-/**
- * @brief 分块存储的数组
- * @param T         : 必须要有复制构造函数和复制 operator =
- * @param ChunkSize : 每个块的元素个数
- * @param size_     : 当前数组的长度
- * @param chunks_   : 每个块的指针
- */
-template <typename T, size_t ChunkSize = 1024u>
-class ChunkArray : public ArrayBase 
-{
-public:
   /**
-   * @brief 构造函数
+   * @brief 从 index 开始 (包括 index) 第一个为 false 的位置,
+   *        没有的话返回 size()
+   * @note 按 64 位的字跳过连续的 true, 复杂度与跳过的字数成正比
    */
-  ChunkArray(std::string name, ChunkArrayBool<1024u> & mark): 
-    ArrayBase(name), size_(0), chunks_(0), mark_(mark)
-  { 
-    chunks_.reserve(1024); 
+  size_t find_next_false(size_t index) const
+  {
+    if(index >= size_)
+      return size_;
+    size_t w = index/WordSize;
+    uint64_t bits = ~word(w) & (~uint64_t(0) << (index % WordSize));
+    size_t NW = (size_+WordSize-1)/WordSize;
+    while(bits == 0 && ++w < NW)
+      bits = ~word(w);
+    if(bits == 0)
+      return size_;
+    return std::min(size_, w*WordSize + std::countr_zero(bits));
   }
 
   /**
-   * @brief 构造函数带 resize
+   * @brief index 之前 (不包括 index) 最后一个为 false 的位置,
+   *        没有的话返回 -1
    */
-  ChunkArray(std::string name, ChunkArrayBool<1024u> & mark, int size): 
-    ArrayBase(name), size_(0), chunks_(0), mark_(mark)
-  {
-    resize(size);
-  }
-
-  // 析构函数，释放分配的内存
-  ~ChunkArray() 
-  {
-    for (T* chunk : chunks_) 
-      delete[] chunk;
-  }
-
-  T& operator[](size_t index)
+  size_t find_prev_false(size_t index) const
   {
-    assert(index < size_ && "Index out of range");
-    size_t chunkIndex = index / ChunkSize;
-    size_t offset = index % ChunkSize;
-    return chunks_[chunkIndex][offset];
+    index = std::min(index, size_);
+    if(index == 0)
+      return size_t(-1);
+    size_t w = (index-1)/WordSize;
+    size_t r = (index-1)%WordSize;
+    uint64_t bits = ~word(w) & (~uint64_t(0) >> (WordSize-1-r));
+    while(bits == 0 && w-- > 0)
+      bits = ~word(w);
+    if(bits == 0)
+      return size_t(-1);
+    return w*WordSize + WordSize-1 - std::countl_zero(bits);
   }
 
-  // 获取元素
-  const T& operator[](size_t index) const
-  {
-    assert(index < size_ && "Index out of range");
-    size_t chunkIndex = index / ChunkSize;
-    size_t offset = index % ChunkSize;
-    return chunks_[chunkIndex][offset];
-  }
-
-  T & back()
-  {
-    size_t chunkIndex = size_ / ChunkSize;
-    size_t offset = size_ % ChunkSize;
-    return chunks_[chunkIndex][offset];
-  }
+  void push_back() { push_back_true(); }
 
-  const T & back() const
+  void push_back_true()
   {
-    size_t chunkIndex = size_ / ChunkSize;
-    size_t offset = size_ % ChunkSize;
-    return chunks_[chunkIndex][offset];
+    if (size_ == capacity())
+      chunks_.emplace_back(allocate_chunk());
+    size_++;
+    set_true(size_-1);
   }
 
-  T & get(size_t index) { return this->operator [](index);}
-
-  const T & get(size_t index) const { return this->operator [](index);}
-
-  // 添加元素
-  void push_back(const T& value) 
+  void push_back_false()
   {
-    if (size_ == chunks_.size() * ChunkSize) 
-      chunks_.push_back(new T[ChunkSize]);
-
-    size_t chunkIndex = size_ / ChunkSize;
-    size_t offset = size_ % ChunkSize;
-
-    chunks_[chunkIndex][offset] = value;
+    if (size_ == capacity())
+      chunks_.emplace_back(allocate_chunk());
     size_++;
+    set_false(size_-1);
   }
 
-  /**
-   * @brief emplace_back 类似于 std::vector
-   */
-  template <typename... Args>
-  void emplace_back(Args&&... args)
+  // 交换两个 ChunkArrayBool 的内容
+  void swap(ChunkArrayBool& other)
   {
-    if (size_ == capacity())
-      chunks_.push_back(new T[ChunkSize]);
-
-    size_t chunkIndex = size_ / ChunkSize;
-    size_t offset = size_ % ChunkSize;
-
-    chunks_[chunkIndex][offset] = T(std::forward<Args>(args)...);
-    size_++;
+    std::swap(chunks_, other.chunks_);
+    std::swap(size_, other.size_);
+    std::swap(resource_, other.resource_);
   }
 
   // 获取当前元素个数
@@ -301,109 +173,84 @@ public:
   // 获取当前分配的内存容量
   size_t capacity() const { return chunks_.size() * ChunkSize;}
 
-  // 交换两个 ChunkedVector 的内容
-  void swap(ChunkArray& other) 
+  void clear() { size_ = 0;}
+
+  /** @brief 释放 size() 之后不再需要的块 */
+  void shrink_to_fit()
   {
-    std::swap(chunks_, other.chunks_);
-    std::swap(size_, other.size_);
+    size_t requiredChunks = (size_ + ChunkSize - 1) / ChunkSize;
+    for (size_t i = requiredChunks; i < chunks_.size(); ++i)
+      deallocate_chunk(chunks_[i]);
+    chunks_.resize(requiredChunks);
   }
 
-  void clear() override { size_ = 0;}
-
-  // 复制另一个 ChunkArray 的内容
-  void copy(const ChunkArray& other) 
+  // 复制另一个 ChunkArrayBool 的内容
+  void copy(const ChunkArrayBool& other)
   {
     if(this != &other)
     {
-      this->set_name(other->get_name());
       resize(other.size_);
-      size_t N_chunk = other.chunks_.size();
-      for (size_t i = 0; i < N_chunk; ++i) 
-        std::copy(other.chunks_[i], other.chunks_[i]+ChunkSize, chunks_[i]);
+      /** other 预留的块可能比这里多, 只复制用到的块 */
+      size_t N_chunk = (other.size_ + ChunkSize - 1) / ChunkSize;
+      for (size_t i = 0; i < N_chunk; ++i)
+        std::copy(other.chunks_[i], other.chunks_[i]+WordsPerChunk, chunks_[i]);
     }
   }
 
   /** @brief operator =  */
-  ChunkArray & operator = (const ChunkArray & other)
+  ChunkArrayBool & operator = (const ChunkArrayBool & other)
   {
     this->copy(other);
     return *this;
   }
 
-  /** @breif 预留空间，使得至少可以容纳指定数量的元素 */
-  void reserve(size_t newCapacity) 
+  // 预留空间，使得至少可以容纳指定数量的元素
+  void reserve(size_t newCapacity)
   {
-    if (newCapacity > capacity()) 
+    size_t cap = capacity();
+    if (newCapacity > cap)
     {
       size_t requiredChunks = (newCapacity + ChunkSize - 1) / ChunkSize;
       chunks_.resize(requiredChunks, nullptr);
-      for (size_t i = capacity()/ChunkSize; i < requiredChunks; ++i) 
-        chunks_[i] = new T[ChunkSize]();
+      for (size_t i = cap/ChunkSize; i < requiredChunks; ++i)
+        chunks_[i] = allocate_chunk();
     }
   }
 
-  void resize(size_t newSize) override 
+  void resize(size_t newSize)
   {
-    if (newSize <= capacity()) 
-    {
-      size_ = newSize;  // 如果新大小小于等于当前大小，直接更新 size_
-    } 
-    else 
-    {
-      reserve(newSize);  // 如果新大小大于当前大小，调用 reserve 函数
-      size_ = newSize;
-    }
+    reserve(newSize);  // 如果新大小大于当前大小，调用 reserve 函数
+    size_ = newSize;
   }
 
-  void set_value(const T & value)
+  std::pmr::memory_resource * memory_resource() const { return resource_; }
+
+private:
+  static std::pmr::memory_resource * get_resource(std::pmr::memory_resource * resource)
   {
-    for(auto chunk : chunks_)
-      std::fill(chunk, chunk+ChunkSize, value);
+    return resource ? resource : std::pmr::get_default_resource();
   }
 
-  std::shared_ptr<ArrayBase> copy_self() override
+  /** @brief 从 resource_ 分配一个全为 false 的块 */
+  uint64_t * allocate_chunk()
   {
-    std::shared_ptr<ChunkArray<T> > cp = std::make_shared<ChunkArray<T> >(this->name_, mark_, size());
-    cp->copy(*this);
-    return cp;
+    uint64_t * chunk = static_cast<uint64_t *>(
+        resource_->allocate(WordsPerChunk*sizeof(uint64_t), alignof(uint64_t)));
+    std::fill(chunk, chunk+WordsPerChunk, uint64_t(0));
+    return chunk;
   }
 
-public:
-  // 迭代子
-  class Iterator {
-  public:
-    Iterator(ChunkArray& array, size_t index)
-        : array_(array), index_(index) {}
-
-    bool operator!=(const Iterator& other) const { return index_ != other.index_; }
-
-    Iterator & operator++() 
-    {
-      index_++;
-      while(index_ < array_.size_ && array_.mark_[index_])
-      {
-        index_++;
-      }
-      return *this;
-    }
-
-    T & operator*() { return array_[index_];}
-
-  private:
-    ChunkArray& array_;
-    size_t index_;
-  };
-
-  // 迭代子的起始位置
-  Iterator begin() { return Iterator(*this, 0); }
-
-  // 迭代子的结束位置
-  Iterator end() { return Iterator(*this, size_);}
+  void deallocate_chunk(uint64_t * chunk)
+  {
+    resource_->deallocate(chunk, WordsPerChunk*sizeof(uint64_t), alignof(uint64_t));
+  }
 
 private:
-    size_t size_;  // 元素个数
-    std::vector<T*> chunks_;  // 存储块的指针
-    ChunkArrayBool<1024u> & mark_;
+  size_t size_;  // 元素个数
+  std::vector<uint64_t*> chunks_;  // 存储块的指针
+  std::pmr::memory_resource * resource_;  // 分配块的内存资源
 };
 
-#endif /* _MARK_ARRAY_ */ 
+}
+
+#endif /* _MARK_ARRAY_ */
@@ -0,0 +1,142 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <optional>
+#include <memory_resource>
+
+namespace HEM
+{
+
+/**
+ * @brief 网格的内存区域, 一个网格的所有实体和数据的块都从这里分配
+ * @note 1. 内部是一个 std::pmr::monotonic_buffer_resource, 分配只是移动指针,
+ *          deallocate 什么也不做。
+ *       2. 构造时向 upstream 申请一块初始内存交给 monotonic_buffer_resource, 
+ *          用完之后它再向 upstream 申请更多的块。release() 把这些块归还给 upstream, 
+ *          初始内存保留下来; 如果这一轮申请过更多的块, 就把初始内存扩大到
+ *          能放下这一轮所有的分配。
+ *       3. 用法: 构造网格时传入 &arena, 网格析构之后调用 arena.release(),
+ *          就可以用同一个 arena 构造下一个网格。网格不比上一个大时, 
+ *          不会再向 upstream 申请内存。
+ *       4. 不是线程安全的, 每个线程应该使用自己的 MeshArena。
+ */
+class MeshArena : public std::pmr::memory_resource
+{
+public:
+  /**
+   * @param initial_size : 初始内存的字节数, 构造时向 upstream 申请
+   * @param upstream : 上游的内存资源
+   */
+  MeshArena(size_t initial_size = 1u << 20,
+      std::pmr::memory_resource * upstream = std::pmr::get_default_resource()):
+    counter_(upstream)
+  {
+    _reset_initial(initial_size);
+  }
+
+  MeshArena(const MeshArena &) = delete;
+
+  MeshArena & operator = (const MeshArena &) = delete;
+
+  ~MeshArena()
+  {
+    buffer_.reset();
+    counter_.deallocate(initial_, initial_size_, alignof(std::max_align_t));
+  }
+
+  /**
+   * @brief 释放所有分配的内存, 从这里分配内存的网格必须已经析构
+   * @note 之后再从初始内存开始分配, 见类的说明
+   */
+  void release()
+  {
+    buffer_->release();
+    size_t grown = counter_.bytes - bytes0_;
+    if(grown > 0)
+    {
+      counter_.deallocate(initial_, initial_size_, alignof(std::max_align_t));
+      _reset_initial(initial_size_ + grown);
+    }
+    bytes_allocated_ = 0;
+  }
+
+  /** 初始内存的字节数 */
+  size_t initial_size() const { return initial_size_; }
+
+  /** 从 arena 分配出去的字节数 */
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+  /** 向 upstream 申请内存的次数 */
+  size_t number_of_upstream_allocations() const { return counter_.count; }
+
+private:
+  /** 申请 size 字节的初始内存, 并在它上面重新建立 monotonic_buffer_resource */
+  void _reset_initial(size_t size)
+  {
+    buffer_.reset();
+    initial_size_ = size;
+    initial_ = counter_.allocate(size, alignof(std::max_align_t));
+    buffer_.emplace(initial_, size, &counter_);
+    bytes0_ = counter_.bytes;
+  }
+
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    bytes_allocated_ += bytes;
+    return buffer_->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t alignment) override
+  {
+    buffer_->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  /** 统计向 upstream 申请内存次数的资源 */
+  class CountingResource : public std::pmr::memory_resource
+  {
+  public:
+    CountingResource(std::pmr::memory_resource * upstream): upstream(upstream) {}
+
+    std::pmr::memory_resource * upstream;
+    size_t count = 0;
+    size_t bytes = 0; /**< 向 upstream 申请的总字节数 */
+
+  private:
+    void * do_allocate(size_t bytes, size_t alignment) override
+    {
+      count++;
+      this->bytes += bytes;
+      return upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void * p, size_t bytes, size_t alignment) override
+    {
+      upstream->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+    {
+      return this == &other;
+    }
+  };
+
+private:
+  CountingResource counter_;
+  void * initial_ = nullptr;
+  size_t initial_size_ = 0;
+  size_t bytes0_ = 0; /**< 申请初始内存之后 counter_.bytes 的值 */
+  std::optional<std::pmr::monotonic_buffer_resource> buffer_;
+  size_t bytes_allocated_ = 0;
+};
+
+}
+
+#endif /* MESH_ARENA_H */
@@ -0,0 +1,175 @@
+#ifndef MESH_EXPORT_H
+#define MESH_EXPORT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace HEM
+{
+
+/** ArrayView 中元素的类型 */
+enum ArrayType : int32_t
+{
+  HEM_FLOAT64 = 0,
+  HEM_INT32   = 1
+};
+
+/**
+ * @brief C 接口返回的数组描述, 第 i 行第 j 个分量在 data + i*stride 之后第 j 个元素
+ * @note 内存属于 MeshExport, 在 MeshExport 析构或重新 build 之前有效,
+ *       Python 端可以直接用 numpy 包装而不复制
+ */
+struct ArrayView
+{
+  void * data;     // 首地址, 没有这个数组时为空
+  int64_t count;   // 行数
+  int64_t stride;  // 相邻两行之间的字节数
+  int32_t width;   // 每行的分量个数
+  int32_t dtype;   // ArrayType
+};
+
+/**
+ * @brief 网格的紧凑导出, 按紧凑编号存储顶点坐标和半边拓扑
+ * @note 1. node() 是 (NN, 2) 的 double 数组
+ *       2. halfedge() 是 (NH, 6) 的 int32 数组, 每行依次是:
+ *          指向的顶点, 所属单元, 下一条半边, 上一条半边, 对边, 所在边
+ *       3. 可以附加以单元或其它实体为行的 int32 数组, 例如 inner_cell
+ */
+template<typename Mesh>
+class MeshExport
+{
+public:
+  using Node = typename Mesh::Node;
+  using Cell = typename Mesh::Cell;
+  using HalfEdge = typename Mesh::HalfEdge;
+
+public:
+  MeshExport() = default;
+
+  MeshExport(Mesh & mesh) { build(mesh); }
+
+  /** @brief 由网格生成导出数组, 会调用 mesh.update() 更新紧凑编号 */
+  void build(Mesh & mesh)
+  {
+    mesh.update();
+    NN_ = mesh.number_of_nodes();
+    NC_ = mesh.number_of_cells();
+    NH_ = mesh.number_of_halfedges();
+    node_.resize(NN_*2);
+    halfedge_.resize(NH_*6);
+    fill_node(mesh, node_.data());
+    fill_halfedge(mesh, halfedge_.data());
+    extra_.clear();
+  }
+
+  uint32_t number_of_nodes() const { return NN_; }
+
+  uint32_t number_of_cells() const { return NC_; }
+
+  uint32_t number_of_halfedges() const { return NH_; }
+
+  ArrayView node() { return {node_.data(), NN_, 2*sizeof(double), 2, HEM_FLOAT64}; }
+
+  ArrayView halfedge() { return {halfedge_.data(), NH_, 6*sizeof(int32_t), 6, HEM_INT32}; }
+
+  /** @brief 添加一个名为 name 的 int32 数组, 有 n 行 */
+  std::vector<int32_t> & add_array(const std::string & name, uint32_t n)
+  {
+    auto & a = extra_[name];
+    a.assign(n, 0);
+    return a;
+  }
+
+  /**
+   * @brief 按名字获取数组, name 为 "node", "halfedge" 或 add_array 添加的名字
+   * @note 没有这个数组时返回的 data 为空, count 为 0
+   */
+  ArrayView view(const std::string & name)
+  {
+    if(name == "node")
+      return node();
+    if(name == "halfedge")
+      return halfedge();
+    auto it = extra_.find(name);
+    if(it == extra_.end())
+      return {nullptr, 0, sizeof(int32_t), 1, HEM_INT32};
+    return {it->second.data(), int64_t(it->second.size()), sizeof(int32_t), 1, HEM_INT32};
+  }
+
+  /** 
+   * @brief 把顶点坐标按紧凑编号写入 out, mesh 的编号需要是最新的 
+   * @note mesh.is_compact() 时存储位置就是紧凑编号, 不需要查编号数组, 下同
+   */
+  static void fill_node(Mesh & mesh, double * out)
+  {
+    if(mesh.is_compact())
+      return fill_node(mesh, out, [](uint32_t i) { return i; });
+    auto & nindex = *(mesh.get_node_indices());
+    fill_node(mesh, out, [&nindex](uint32_t i) { return nindex[i]; });
+  }
+
+  /** @brief 把半边拓扑按紧凑编号写入 out, mesh 的编号需要是最新的 */
+  static void fill_halfedge(Mesh & mesh, int32_t * out)
+  {
+    if(mesh.is_compact())
+    {
+      auto id = [](uint32_t i) { return i; };
+      return fill_halfedge(mesh, out, id, id, id, id);
+    }
+    auto & hindex = *(mesh.get_halfedge_indices());
+    auto & nindex = *(mesh.get_node_indices());
+    auto & eindex = *(mesh.get_edge_indices());
+    auto & cindex = *(mesh.get_cell_indices());
+    fill_halfedge(mesh, out, [&nindex](uint32_t i) { return nindex[i]; }, 
+        [&eindex](uint32_t i) { return eindex[i]; }, [&cindex](uint32_t i) { return cindex[i]; }, 
+        [&hindex](uint32_t i) { return hindex[i]; });
+  }
+
+private:
+  /** 
+   * @brief xidx 把实体的存储位置映射为紧凑编号
+   */
+  template<typename NIdx>
+  static void fill_node(Mesh & mesh, double * out, const NIdx & nidx)
+  {
+    mesh.for_each_node([&](Node & n)
+    {
+      uint32_t idx = nidx(n.index());
+      out[idx*2] = n.coordinate().x;
+      out[idx*2+1] = n.coordinate().y;
+    });
+  }
+
+  template<typename NIdx, typename EIdx, typename CIdx, typename HIdx>
+  static void fill_halfedge(Mesh & mesh, int32_t * out, const NIdx & nidx, 
+      const EIdx & eidx, const CIdx & cidx, const HIdx & hidx)
+  {
+    mesh.for_each_halfedge([&](HalfEdge & h)
+    {
+      int32_t * o = out + 6*hidx(h.index());
+      o[0] = nidx(h.node()->index());
+      o[1] = cidx(h.cell()->index());
+      o[2] = hidx(h.next()->index());
+      o[3] = hidx(h.previous()->index());
+      o[4] = hidx(h.opposite()->index());
+      o[5] = eidx(h.edge()->index());
+    });
+  }
+
+private:
+  int64_t NN_ = 0;
+  int64_t NC_ = 0;
+  int64_t NH_ = 0;
+
+  std::vector<double> node_;
+  std::vector<int32_t> halfedge_;
+
+  /** 附加的数组 */
+  std::unordered_map<std::string, std::vector<int32_t>> extra_;
+};
+
+}
+
+#endif /* MESH_EXPORT_H */
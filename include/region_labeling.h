@@ -0,0 +1,251 @@
+#ifndef REGION_LABELING_H
+#define REGION_LABELING_H
+
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "tools.h"
+
+namespace HEM
+{
+
+/**
+ * @brief 可以并发合并的并查集
+ * @note 1. 总是把编号大的根连到编号小的根上, 所以 parent[i] <= i,
+ *          集合的根是其中最小的编号。
+ *       2. find 和 unite 可以被多个线程同时调用,
+ *          合并结束之后 find 的结果才是最终的。
+ */
+class UnionFind
+{
+public:
+  UnionFind(uint32_t n = 0) { reset(n); }
+
+  /** @brief n 个元素, 每个元素自成一个集合 */
+  void reset(uint32_t n)
+  {
+    parent_.resize(n);
+#pragma omp parallel for schedule(static)
+    for(int64_t i = 0; i < int64_t(n); i++)
+      parent_[i] = i;
+  }
+
+  uint32_t size() const { return parent_.size(); }
+
+  /** @brief i 所在集合的根, 顺便把路径减半 */
+  uint32_t find(uint32_t i)
+  {
+    while(true)
+    {
+      uint32_t p = load(i);
+      if(p == i)
+        return i;
+      uint32_t g = load(p);
+      if(g == p)
+        return p;
+      std::atomic_ref<uint32_t>(parent_[i]).compare_exchange_weak(p, g, std::memory_order_relaxed);
+      i = g;
+    }
+  }
+
+  /** @brief 合并 a 和 b 所在的集合 */
+  void unite(uint32_t a, uint32_t b)
+  {
+    while(true)
+    {
+      a = find(a);
+      b = find(b);
+      if(a == b)
+        return;
+      if(a < b)
+        std::swap(a, b);
+      uint32_t expected = a;
+      if(std::atomic_ref<uint32_t>(parent_[a]).compare_exchange_strong(expected, b,
+            std::memory_order_relaxed))
+        return;
+    }
+  }
+
+private:
+  uint32_t load(uint32_t i)
+  {
+    return std::atomic_ref<uint32_t>(parent_[i]).load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<uint32_t> parent_;
+};
+
+/**
+ * @brief label_inner_cells 的缓冲区, 重复使用时不分配内存
+ */
+struct FrontierBuffer
+{
+  /** 每个线程找到的下一层单元, 对齐到缓存行避免伪共享 */
+  struct alignas(64) Local
+  {
+    std::vector<uint32_t> cells;
+    size_t offset = 0;
+  };
+
+  std::vector<Local> local;
+
+  /** 当前一层的单元 */
+  std::vector<uint32_t> frontier;
+};
+
+/**
+ * @brief 从界面内侧的单元出发, 标记所有界面内部的单元
+ * @param mark : 以单元存储位置为下标, 切割时界面内侧的单元为 1, 外侧的单元为 2,
+ *   其它为 0。结束后在界面内部的单元为 1, 其它为 0。
+ * @param seeds : 切割时标记过的单元的存储位置, 可以重复
+ * @note 1. 不是 2 的相邻单元属于同一个连通分支, 含有 1 的连通分支都在界面内部。
+ *       2. 从 seeds 出发逐层地并行扩展: 每个线程把新到达的单元放到自己的下一层,
+ *          单元由 mark 从 0 到 1 的 CAS 认领, 所以每个单元只被一个线程加入。
+ *          合并各线程的下一层之后进入下一轮, 直到没有新的单元。
+ *       3. 只访问界面两侧和内部的单元, 工作量与内部单元的个数成正比,
+ *          buffer 的容量够用时不分配内存。seeds 很少时不开启并行区域。
+ */
+template<typename Mesh, typename Marks>
+void label_inner_cells(Mesh & mesh, Marks & mark, const std::vector<uint32_t> & seeds,
+    FrontierBuffer & buffer)
+{
+  constexpr size_t ParallelSeeds = 1024;
+
+  auto & cells = *mesh.get_cell();
+  auto & local = buffer.local;
+  auto & frontier = buffer.frontier;
+  local.resize(number_of_threads());
+  frontier.clear();
+
+#pragma omp parallel if(seeds.size() >= ParallelSeeds)
+  {
+    auto & next = local[thread_id()].cells;
+    const uint32_t * cur = seeds.data();
+    size_t N = seeds.size();
+    while(N > 0)
+    {
+      next.clear();
+#pragma omp for schedule(dynamic, 256)
+      for(size_t k = 0; k < N; k++)
+      {
+        uint32_t i = cur[k];
+        if(mark[i] != 1)
+          continue;
+        auto * h0 = cells[i].halfedge();
+        auto * h = h0;
+        do
+        {
+          uint32_t j = h->opposite()->cell()->index();
+          std::atomic_ref<uint8_t> m(mark[j]);
+          uint8_t expected = 0;
+          if(m.load(std::memory_order_relaxed) == 0 && 
+              m.compare_exchange_strong(expected, 1, std::memory_order_relaxed))
+            next.push_back(j);
+          h = h->next();
+        } while(h != h0);
+      }
+
+      /** 把各线程的下一层依次放到 frontier 中 */
+#pragma omp single
+      {
+        size_t n = 0;
+        for(uint32_t t = 0; t < number_of_team_threads(); t++)
+        {
+          local[t].offset = n;
+          n += local[t].cells.size();
+        }
+        frontier.resize(n);
+      }
+      std::copy(next.begin(), next.end(), frontier.begin() + local[thread_id()].offset);
+#pragma omp barrier
+      cur = frontier.data();
+      N = frontier.size();
+    }
+  }
+
+  /** 到达的单元都已经是 1, 只需要把外侧的单元改回 0 */
+  for(uint32_t i : seeds)
+  {
+    if(mark[i] == 2)
+      mark[i] = 0;
+  }
+}
+
+/**
+ * @brief 按界面两侧的单元标记, 并行地标记所有界面内部的单元, 并给出每个单元所在的区域
+ * @param mark : 同 label_inner_cells
+ * @param region : 第 i 个位置是存储位置为 i 的单元所在区域的编号, 没有单元的位置为 -1
+ * @return 区域的个数
+ * @note 1. 区域以界面为边界: 只有标记为 1 和 2 的相邻单元属于不同区域, 所以
+ *          嵌套的界面之间的每一层都有不同的编号, 按区域中第一个单元的存储位置编号。
+ *       2. 连通分支由并查集在所有边上并行地合并, 工作量与单元个数成正比,
+ *          只需要内部单元时用 label_inner_cells。
+ */
+template<typename Mesh, typename Marks>
+uint32_t label_regions(Mesh & mesh, Marks & mark, std::vector<uint32_t> & region)
+{
+  using Edge = typename Mesh::Edge;
+  using Cell = typename Mesh::Cell;
+
+  const uint32_t N = mesh.get_cell()->size();
+
+  /** 对每条内部边的两个单元调用 f(a, b) */
+  auto for_each_adjacent = [&mesh](const auto & f)
+  {
+    mesh.template parallel_for_each_entity<Edge>([&f](Edge & e)
+    {
+      auto * h = e.halfedge();
+      auto * o = h->opposite();
+      if(o != h)
+        f(h->cell()->index(), o->cell()->index());
+    });
+  };
+
+  UnionFind uf(N);
+  for_each_adjacent([&uf, &mark](uint32_t a, uint32_t b)
+  {
+    if(mark[a] == 0 || mark[b] == 0 || mark[a] == mark[b])
+      uf.unite(a, b);
+  });
+
+  std::vector<uint32_t> id(N, 0);
+  mesh.template parallel_for_each_entity<Cell>([&uf, &id](Cell & c)
+  {
+    id[c.index()] = uf.find(c.index()) == c.index();
+  });
+  uint32_t NR = exclusive_scan(id);
+
+  region.assign(N, uint32_t(-1));
+  mesh.template parallel_for_each_entity<Cell>([&uf, &id, &region](Cell & c)
+  {
+    region[c.index()] = id[uf.find(c.index())];
+  });
+
+  /** 不是 2 的相邻单元的连通分支, 含有 1 的分支在界面内部 */
+  uf.reset(N);
+  for_each_adjacent([&uf, &mark](uint32_t a, uint32_t b)
+  {
+    if(mark[a] != 2 && mark[b] != 2)
+      uf.unite(a, b);
+  });
+
+  std::vector<uint8_t> inner(N, 0);
+  mesh.template parallel_for_each_entity<Cell>([&uf, &mark, &inner](Cell & c)
+  {
+    if(mark[c.index()] == 1)
+      std::atomic_ref<uint8_t>(inner[uf.find(c.index())]).store(1, std::memory_order_relaxed);
+  });
+  mesh.template parallel_for_each_entity<Cell>([&uf, &mark, &inner](Cell & c)
+  {
+    uint32_t i = c.index();
+    mark[i] = mark[i] != 2 && inner[uf.find(i)];
+  });
+  return NR;
+}
+
+}
+
+#endif /* REGION_LABELING_H */
@@ -0,0 +1,131 @@
+#ifndef SOA_MESH_H
+#define SOA_MESH_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace HEM
+{
+
+/**
+ * @brief 半边网格的结构数组 (SoA) 快照, 用于批量计算单元的几何量
+ * @note 1. 所有编号都是紧凑编号, 即 get_xxx_indices() 给出的编号。
+ *       2. 单元的半边按 CSR 格式存储: cell_offset_[i] 到 cell_offset_[i+1]
+ *          是第 i 个单元从 halfedge() 开始依次 next() 得到的半边,
+ *          cell_node_ 是这些半边的起点, 所以 cell_node_[cell_offset_[i]]
+ *          就是 TCell::area() 中的 p0。
+ *       3. 快照不会随着网格改变, 网格改变后需要重新 build。
+ */
+template<typename Mesh>
+class SoAMesh
+{
+public:
+  using Node = typename Mesh::Node;
+  using Edge = typename Mesh::Edge;
+  using Cell = typename Mesh::Cell;
+  using HalfEdge = typename Mesh::HalfEdge;
+
+  static_assert(Mesh::Dim == 2, "SoAMesh only supports 2D mesh.");
+
+  /** 并行计算时每个任务处理的单元个数 */
+  constexpr static uint32_t BlockSize = 1024u;
+
+public:
+  SoAMesh() = default;
+
+  SoAMesh(Mesh & mesh) { build(mesh); }
+
+  /** @brief 由网格生成快照, 会调用 mesh.update() 更新紧凑编号 */
+  void build(Mesh & mesh);
+
+  uint32_t number_of_nodes() const { return x_.size(); }
+
+  uint32_t number_of_cells() const { return cell_offset_.size()-1; }
+
+  uint32_t number_of_halfedges() const { return next_.size(); }
+
+  /** 半边的连接关系 */
+  const std::vector<uint32_t> & next() const { return next_; }
+
+  const std::vector<uint32_t> & previous() const { return prev_; }
+
+  const std::vector<uint32_t> & opposite() const { return oppo_; }
+
+  const std::vector<uint32_t> & node() const { return node_; }
+
+  const std::vector<uint32_t> & cell() const { return cell_; }
+
+  const std::vector<uint32_t> & edge() const { return edge_; }
+
+  /** 顶点坐标 */
+  const std::vector<double> & x() const { return x_; }
+
+  const std::vector<double> & y() const { return y_; }
+
+  /** 单元到半边的 CSR 结构 */
+  const std::vector<uint32_t> & cell_offset() const { return cell_offset_; }
+
+  const std::vector<uint32_t> & cell_halfedge() const { return cell_halfedge_; }
+
+  const std::vector<uint32_t> & cell_node() const { return cell_node_; }
+
+  /**
+   * @brief 计算所有单元的面积
+   * @param area : 长度为 number_of_cells()
+   */
+  void cell_area(double * area) const;
+
+  /**
+   * @brief 计算所有单元的重心
+   * @param bx, by : 长度为 number_of_cells()
+   */
+  void cell_barycenter(double * bx, double * by) const;
+
+  /**
+   * @brief 计算所有单元的包围盒
+   * @param xmin, ymin, xmax, ymax : 长度为 number_of_cells()
+   */
+  void cell_box(double * xmin, double * ymin, double * xmax, double * ymax) const;
+
+private:
+  /** 将单元分块并行计算 */
+  template<typename Kernel>
+  void for_each_block(const Kernel & kernel) const;
+
+  /** 计算 [begin, end) 中的单元, 先用 SIMD 成组计算, 剩余的单元用标量计算 */
+  void cell_area_kernel(double * area, uint32_t begin, uint32_t end) const;
+
+  void cell_barycenter_kernel(double * bx, double * by, uint32_t begin, uint32_t end) const;
+
+  void cell_box_kernel(double * xmin, double * ymin, double * xmax, double * ymax,
+      uint32_t begin, uint32_t end) const;
+
+private:
+  /** 半边的下一条半边, 上一条半边, 对边, 指向的顶点, 所属单元, 所在边 */
+  std::vector<uint32_t> next_;
+  std::vector<uint32_t> prev_;
+  std::vector<uint32_t> oppo_;
+  std::vector<uint32_t> node_;
+  std::vector<uint32_t> cell_;
+  std::vector<uint32_t> edge_;
+
+  /** 顶点坐标 */
+  std::vector<double> x_;
+  std::vector<double> y_;
+
+  /** 单元到半边 */
+  std::vector<uint32_t> cell_offset_ = {0};
+  std::vector<uint32_t> cell_halfedge_;
+  std::vector<uint32_t> cell_node_;
+};
+
+}
+
+#include "imp/soa_mesh.inl"
+
+#endif /* SOA_MESH_H */
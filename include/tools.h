@@ -5,9 +5,279 @@
 #include <vector>
 #include <span>
 #include <iostream>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <stdint.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace HEM
 {
 
+/**
+ * @brief 二维 Morton 码, 即把 x 和 y 的二进制位交错排列, x 在低位
+ */
+inline uint32_t morton_code(uint16_t x, uint16_t y)
+{
+  auto spread = [](uint32_t v)
+  {
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+  };
+  return spread(x) | (spread(y) << 1);
+}
+
+/**
+ * @brief 把 [0, N) 平均分给 nt 个线程, 第 t 个线程的范围
+ */
+inline void thread_range(size_t N, int t, int nt, size_t & begin, size_t & end)
+{
+  begin = N*t/nt;
+  end = N*(t+1)/nt;
+}
+
+/**
+ * @brief OpenMP 的最大线程数, 没有用 OpenMP 编译时为 1
+ */
+inline uint32_t number_of_threads()
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+/**
+ * @brief 当前并行区域中的线程数, 不在并行区域中或没有用 OpenMP 编译时为 1
+ */
+inline uint32_t number_of_team_threads()
+{
+#ifdef _OPENMP
+  return omp_get_num_threads();
+#else
+  return 1;
+#endif
+}
+
+/**
+ * @brief 当前的 OpenMP 线程编号, 没有用 OpenMP 编译时为 0
+ */
+inline uint32_t thread_id()
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief 并行的 LSD 基数排序, 按 key 的低 bits 位把 (key[i], val[i]) 稳定地从小到大排列
+ * @note 每趟处理 8 位: 每个线程统计自己那一段的直方图, 
+ *       按 (数字, 线程) 的顺序做前缀和之后, 各自把自己那一段分散写入
+ */
+inline void radix_sort(std::vector<uint64_t> & key, std::vector<uint32_t> & val, int bits)
+{
+  const size_t N = key.size();
+  std::vector<uint64_t> key1(N);
+  std::vector<uint32_t> val1(N);
+  std::vector<size_t> count(256*number_of_threads());
+  for(int shift = 0; shift < bits; shift += 8)
+  {
+    const uint64_t * k0 = key.data();
+    const uint32_t * v0 = val.data();
+    uint64_t * k1 = key1.data();
+    uint32_t * v1 = val1.data();
+#pragma omp parallel
+    {
+      int t = thread_id(), nt = number_of_team_threads();
+      size_t b, e;
+      thread_range(N, t, nt, b, e);
+      /** 直方图放在局部数组中, 避免与 key 的别名 */
+      size_t c[256] = {0};
+      for(size_t i = b; i < e; i++)
+        c[(k0[i] >> shift) & 255]++;
+      std::copy(c, c+256, count.data() + 256*t);
+#pragma omp barrier
+#pragma omp single
+      {
+        size_t sum = 0;
+        for(int d = 0; d < 256; d++)
+        {
+          for(int s = 0; s < nt; s++)
+          {
+            size_t n = count[256*s+d];
+            count[256*s+d] = sum;
+            sum += n;
+          }
+        }
+      }
+      std::copy(count.data() + 256*t, count.data() + 256*(t+1), c);
+      for(size_t i = b; i < e; i++)
+      {
+        size_t p = c[(k0[i] >> shift) & 255]++;
+        k1[p] = k0[i];
+        v1[p] = v0[i];
+      }
+    }
+    key.swap(key1);
+    val.swap(val1);
+  }
+}
+
+/**
+ * @brief 并行的不包含自身的前缀和, a[i] 变为 a[0] + ... + a[i-1], 返回总和
+ */
+inline uint32_t exclusive_scan(std::vector<uint32_t> & a)
+{
+  const size_t N = a.size();
+  std::vector<uint32_t> part(number_of_threads()+1, 0);
+  uint32_t total = 0;
+#pragma omp parallel
+  {
+    int t = thread_id(), nt = number_of_team_threads();
+    size_t b, e;
+    thread_range(N, t, nt, b, e);
+    uint32_t sum = 0;
+    for(size_t i = b; i < e; i++)
+      sum += a[i];
+    part[t+1] = sum;
+#pragma omp barrier
+#pragma omp single
+    {
+      for(int s = 0; s < nt; s++)
+        part[s+1] += part[s];
+      total = part[nt];
+    }
+    sum = part[t];
+    for(size_t i = b; i < e; i++)
+    {
+      uint32_t n = a[i];
+      a[i] = sum;
+      sum += n;
+    }
+  }
+  return total;
+}
+
+/**
+ * @brief 前 N 个元素存放在对象内部的数组, 超过 N 个时才在堆上分配
+ * @note 1. 切割时每个点周围的单元, 固定点等列表一般只有几个元素,
+ *          用它作局部变量或成员时稳定状态下不分配内存。
+ *       2. 只用于可以按字节复制的类型, 例如指针和坐标。
+ */
+template<typename T, uint32_t N>
+class SmallVector
+{
+  static_assert(std::is_trivially_copyable_v<T>, "SmallVector only holds trivially copyable types.");
+
+public:
+  SmallVector() = default;
+
+  SmallVector(std::initializer_list<T> list)
+  {
+    assign(list.begin(), list.end());
+  }
+
+  SmallVector(const SmallVector & other) { assign(other.begin(), other.end()); }
+
+  SmallVector & operator = (const SmallVector & other)
+  {
+    if(this != &other)
+      assign(other.begin(), other.end());
+    return *this;
+  }
+
+  ~SmallVector()
+  {
+    if(data_ != local_)
+      delete [] data_;
+  }
+
+  T * data() { return data_; }
+  const T * data() const { return data_; }
+
+  T * begin() { return data_; }
+  T * end() { return data_ + size_; }
+  const T * begin() const { return data_; }
+  const T * end() const { return data_ + size_; }
+
+  T & operator[](uint32_t i) { return data_[i]; }
+  const T & operator[](uint32_t i) const { return data_[i]; }
+
+  T & front() { return data_[0]; }
+  T & back() { return data_[size_-1]; }
+  const T & front() const { return data_[0]; }
+  const T & back() const { return data_[size_-1]; }
+
+  uint32_t size() const { return size_; }
+  uint32_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+
+  /** @brief 清空但保留已经分配的空间 */
+  void clear() { size_ = 0; }
+
+  void push_back(const T & v)
+  {
+    if(size_ == capacity_)
+    {
+      T copy = v; /**< v 可能在数组中 */
+      reserve(2*capacity_);
+      data_[size_++] = copy;
+    }
+    else
+      data_[size_++] = v;
+  }
+
+  /** @brief 在 pos 之前插入 v, 返回指向新元素的指针 */
+  T * insert(T * pos, const T & v)
+  {
+    uint32_t i = pos - data_;
+    push_back(v);
+    std::rotate(data_ + i, data_ + size_ - 1, data_ + size_);
+    return data_ + i;
+  }
+
+  void resize(uint32_t n)
+  {
+    reserve(n);
+    size_ = n;
+  }
+
+  void reserve(uint32_t n)
+  {
+    if(n <= capacity_)
+      return;
+    T * d = new T[n];
+    std::memcpy(d, data_, size_*sizeof(T));
+    if(data_ != local_)
+      delete [] data_;
+    data_ = d;
+    capacity_ = n;
+  }
+
+  template<typename It>
+  void assign(It first, It last)
+  {
+    resize(std::distance(first, last));
+    std::copy(first, last, data_);
+  }
+
+private:
+  T local_[N];
+  T * data_ = local_;
+  uint32_t size_ = 0;
+  uint32_t capacity_ = N;
+};
+
 }
 #endif // TOOLS_H
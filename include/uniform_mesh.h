@@ -7,12 +7,16 @@
 namespace HEM
 {
 
-template<int D>
-class UniformMesh : public HalfEdgeMeshBase<DefaultHalfEdgeMeshTraits<D>>
+/**
+ * @brief 均匀网格
+ * @param MeshTraits : 网格特性, 默认使用指针存储连接关系
+ */
+template<int D, typename MeshTraits = DefaultHalfEdgeMeshTraits<D>>
+class UniformMesh : public HalfEdgeMeshBase<MeshTraits>
 {
 public:
   using Self = UniformMesh; 
-  using Traits = DefaultHalfEdgeMeshTraits<D>;
+  using Traits = MeshTraits;
   using Base = HalfEdgeMeshBase<Traits>;
 
   using Node = typename Base::Node;
@@ -43,13 +47,15 @@ public:
 public:
   /**
    * @brief 构造函数 
+   * @param resource : 网格的内存资源, 见 HalfEdgeMeshBase
    */
   UniformMesh(double orign_x, 
               double orign_y, 
               double hx, 
               double hy, 
               uint32_t nx, 
-              uint32_t ny);
+              uint32_t ny, 
+              std::pmr::memory_resource * resource = nullptr);
 
   uint32_t find_point(const Point & p) const
   {
@@ -71,19 +77,25 @@ public:
     return param_.nx*param_.ny;
   }
 
+  /** 
+   * @brief 网格的参数, 第 (i, j) 个块的编号为 i*ny + j, 见 find_point
+   */
+  const Parameter & parameter() const { return param_; }
+
 private:
   Parameter param_;
 };
 
-template<int D>
-UniformMesh<D>::UniformMesh(double orign_x, 
+template<int D, typename MeshTraits>
+UniformMesh<D, MeshTraits>::UniformMesh(double orign_x, 
                          double orign_y, 
                          double hx, 
                          double hy, 
                          uint32_t nx, 
-                         uint32_t ny):
-  Base((nx+1)*(ny+1), 2*nx*ny + nx + ny, nx*ny, 4*nx*ny, 1e-5 
-      ), param_(orign_x, orign_y, hx, hy, nx, ny)
+                         uint32_t ny, 
+                         std::pmr::memory_resource * resource):
+  Base((nx+1)*(ny+1), 2*nx*ny + nx + ny, nx*ny, 4*nx*ny, 1e-5, 
+      resource), param_(orign_x, orign_y, hx, hy, nx, ny)
 {
   auto & node = *(this->get_node()); 
   auto & edge = *(this->get_edge());
@@ -194,6 +206,59 @@ UniformMesh<D>::UniformMesh(double orign_x,
 
 using UniformMesh2D = UniformMesh<2>;
 
+/**
+ * @brief 在背景块中保存子单元指针的网格的公共部分, 整理或重排存储之后重写这些指针
+ * @param Derived : 派生的网格类型, 提供 for_each_subcell(f), 对保存的每个单元指针
+ *                  的引用调用 f
+ * @param Mesh : 网格类型
+ */
+template<typename Derived, typename Mesh>
+class SubCellMesh : public Mesh
+{
+public:
+  using Cell = typename Mesh::Cell;
+
+  using Mesh::Mesh;
+
+  /**
+   * @brief 整理存储, 见 HalfEdgeMeshBase::compact, 同时重写子单元的指针
+   */
+  std::vector<uint32_t> compact() { return relink_subcell([this]() { return Mesh::compact(); }); }
+
+  /**
+   * @brief 按空间顺序重排, 见 HalfEdgeMeshBase::reorder, 同时重写子单元的指针
+   */
+  std::vector<uint32_t> reorder() { return relink_subcell([this]() { return Mesh::reorder(); }); }
+
+  /**
+   * @brief 调用重排单元的函数 permute, 然后按它返回的单元顺序重写子单元的指针, 
+   *   空指针保持为空
+   */
+  template<typename Permute>
+  std::vector<uint32_t> relink_subcell(const Permute & permute)
+  {
+    Derived & self = static_cast<Derived &>(*this);
+    std::vector<uint32_t> sub;
+    self.for_each_subcell([&sub](Cell * & c) { sub.push_back(c ? c->index() : uint32_t(-1)); });
+
+    std::vector<uint32_t> corder = permute();
+
+    /** 原来的存储位置到新的存储位置 */
+    std::vector<uint32_t> cmap(corder.empty() ? 0 : *std::max_element(corder.begin(), corder.end())+1);
+    for(uint32_t k = 0; k < corder.size(); k++)
+      cmap[corder[k]] = k;
+
+    auto & cell = *Mesh::get_cell();
+    uint32_t k = 0;
+    self.for_each_subcell([&](Cell * & c)
+    {
+      uint32_t i = sub[k++];
+      c = i == uint32_t(-1) ? nullptr : &cell[cmap[i]];
+    });
+    return corder;
+  }
+};
+
 
 }
 #endif /* _UNIFORM_MESH_ */ 
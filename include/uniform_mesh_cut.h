@@ -3,17 +3,19 @@
 
 #include "uniform_mesh.h"
 #include "geometry_utils.h"
+#include "tools.h"
 #include <vector>
+#include <algorithm>
 
 namespace HEM 
 {
 
-template<int D>
-class UniformMeshCut : public UniformMesh<D>
+template<int D, typename MeshTraits = DefaultHalfEdgeMeshTraits<D>>
+class UniformMeshCut : public SubCellMesh<UniformMeshCut<D, MeshTraits>, UniformMesh<D, MeshTraits> >
 {
 public:
-  using Base = UniformMesh<D>;
-  using Self = UniformMeshCut<D>;
+  using Base = SubCellMesh<UniformMeshCut<D, MeshTraits>, UniformMesh<D, MeshTraits> >;
+  using Self = UniformMeshCut<D, MeshTraits>;
 
   using Cell = typename Base::Cell;
   using Edge = typename Base::Edge;
@@ -23,7 +25,11 @@ public:
   using Point  = typename Base::Point;
   using Vector = typename Base::Vector;
 
-  using SubCellArray = std::vector<std::vector<Cell *> >;
+  /** 
+   * 每个背景块中的单元, 一个块一般只被分成几个单元, 放在对象内部, 
+   * 所以建立时和切割时都不为每个块分配内存
+   */
+  using SubCellArray = std::vector<SmallVector<Cell *, 4> >;
         
 public:
   /**
@@ -37,7 +43,8 @@ public:
   } 
 
   /**
-   * @brief 更新 subcell_
+   * @brief 由所有单元重新建立 subcell_, 只在构造和单元被删除之后需要,
+   *   切割时由 splite_cell 增量更新
    */
   void update_subcell()
   {
@@ -54,6 +61,20 @@ public:
     }
   }
 
+  /**
+   * @brief 分割单元, 见 HalfEdgeMeshBase::splite_cell, 同时把新单元加入 subcell_
+   * @note 新单元与 c0 在同一个块中, 只需要更新这一个块, 按存储位置插入,
+   *   所以 subcell_ 与 update_subcell 重新建立的相同
+   */
+  Cell * splite_cell(Cell * c0, HalfEdge * h0, HalfEdge * h1)
+  {
+    Cell * c1 = Base::splite_cell(c0, h0, h1);
+    auto & cs = subcell_[Base::find_point(c1->barycenter())];
+    cs.insert(std::upper_bound(cs.begin(), cs.end(), c1, [](const Cell * a, const Cell * b)
+          { return a->index() < b->index(); }), c1);
+    return c1;
+  }
+
   /**
    * @brief 查找点所在的单元
    * @param p 点
@@ -63,20 +84,24 @@ public:
    * @retval 0 点在顶点上
    * @retval 1 点在单元边上
    * @retval 2 点在单元内部
-   * @retval 3 点在网格外面
+   * @retval 3 点在网格外面, 这时 out 为空
    */
   uint32_t find_point(const Point & p, Cell* & out, uint32_t & index) const 
   {
-    uint32_t idx = Base::find_point(p);
-    const auto & cellc = subcell_[idx];
+    out = nullptr;
+    const auto & param = Base::parameter();
+    double x = std::floor((p.x-param.orignx)/param.hx);
+    double y = std::floor((p.y-param.origny)/param.hy);
+    if(!(x >= 0 && x < param.nx && y >= 0 && y < param.ny))
+      return 3;
+    const auto & cellc = subcell_[uint32_t(x)*param.ny + uint32_t(y)];
     auto & geo_ = Base::geometry_utils();
 
+    Point * points[32];
     for(auto & c : cellc)
     {
-      std::vector<Point *> points(32, nullptr);
-      int N = c->vertices(points.data());
-      points.resize(N);
-      uint32_t flag = geo_.relative_position_of_point_and_polygon(points, p, index);
+      uint32_t N = c->vertices(points);
+      uint32_t flag = geo_.relative_position_of_point_and_polygon({points, N}, p, index);
       if(flag!=3)
       {
         out = c;
@@ -95,13 +120,92 @@ public:
       return find_point(p, out, dummy_index);
   }
 
+  /** @brief 查找点所在的单元, 点在网格外面时返回空指针 */
   Cell * find_point(const Point & p) const
   {
-    Cell * out;
+    Cell * out = nullptr;
     find_point(p, out);
     return out;
   }
 
+  /**
+   * @brief 从 hint 出发查找点所在的单元, 结果与 find_point(p, out, index) 相同
+   * @note 先用 walk_to_point 从 hint 走到 p 附近, 当 p 在到达的单元内部且与
+   *   它的边界的距离大于容差时, 这个单元就是结果; 否则 (包括 hint 为空)
+   *   退回到块中查找。连续的查询在空间上相近时, 每次只需要走几个单元。
+   */
+  uint32_t find_point(const Point & p, Cell* & out, uint32_t & index, Cell * hint) const
+  {
+    if(hint)
+    {
+      Cell * c = Base::walk_to_point(p, hint);
+      if(c && Base::is_strictly_inside(p, c, 2*Base::geometry_utils().tolerance()))
+      {
+        out = c;
+        index = 0;
+        return 2;
+      }
+    }
+    return find_point(p, out, index);
+  }
+
+  /**
+   * @brief 记住上一次结果的查找器, 每次从上一次找到的单元出发, 
+   *   见 find_point(p, out, index, hint)
+   * @note 每个线程使用自己的查找器, 单元被删除或重排之后需要 reset
+   */
+  class Locator
+  {
+  public:
+    Locator(const Self & mesh, Cell * hint = nullptr): mesh_(&mesh), last_(hint) {}
+
+    uint32_t find_point(const Point & p, Cell* & out, uint32_t & index)
+    {
+      uint32_t flag = mesh_->find_point(p, out, index, last_);
+      if(flag != 3)
+        last_ = out;
+      return flag;
+    }
+
+    Cell * find_point(const Point & p)
+    {
+      Cell * out = nullptr;
+      uint32_t index;
+      find_point(p, out, index);
+      return out;
+    }
+
+    void reset(Cell * hint = nullptr) { last_ = hint; }
+
+  private:
+    const Self * mesh_;
+    Cell * last_;
+  };
+
+  /**
+   * @brief 批量查找点所在的单元, 结果与对每个点调用 find_point 相同
+   * @param points : N 个点
+   * @param cells : 输出, 第 i 个点所在的单元, 点在网格外面时为空
+   * @param flags : 输出, 第 i 个点相对于单元的位置, 见 find_point, 为空时不输出
+   * @note 1. 查询按所在的块排序, 同一个块中的查询一起处理: 每个候选单元的顶点
+   *          只读取一次, 然后用向量化的核函数判断所有还没有找到单元的点, 见
+   *          GeometryUtils2D::relative_position_of_points_and_polygon。
+   *       2. 排序后的查询按段由多个线程并行处理, 每个线程的缓冲区在段之间重复使用。
+   */
+  void locate(const Point * points, uint32_t N, Cell ** cells, uint8_t * flags = nullptr) const;
+
+private:
+  friend Base;
+
+  /** @brief 对 subcell_ 中的每个单元指针调用 f, 见 SubCellMesh */
+  template<typename F>
+  void for_each_subcell(const F & f)
+  {
+    for(auto & cs : subcell_)
+      for(auto & c : cs)
+        f(c);
+  }
+
 private:
   /** 
    * @brief 背景网格中单元的子单元
@@ -109,6 +213,90 @@ private:
   SubCellArray subcell_;
 };
 
+template<int D, typename MeshTraits>
+void UniformMeshCut<D, MeshTraits>::locate(const Point * points, uint32_t N, 
+    Cell ** cells, uint8_t * flags) const
+{
+  const auto & param = Base::parameter();
+  const uint32_t NB = subcell_.size();
+
+  /** 点所在的块, 网格外面的点为 NB */
+  std::vector<uint64_t> block(N);
+  std::vector<uint32_t> order(N);
+#pragma omp parallel for schedule(static)
+  for(int64_t i = 0; i < int64_t(N); i++)
+  {
+    double x = std::floor((points[i].x-param.orignx)/param.hx);
+    double y = std::floor((points[i].y-param.origny)/param.hy);
+    bool in = x >= 0 && x < param.nx && y >= 0 && y < param.ny;
+    block[i] = in ? uint32_t(x)*param.ny + uint32_t(y) : NB;
+    order[i] = i;
+  }
+  radix_sort(block, order, std::bit_width(uint64_t(NB)));
+
+  const auto & geo = Base::geometry_utils();
+  const int64_t S = 1024;
+#pragma omp parallel
+  {
+    /** 同一个块中还没有找到单元的查询, 以及候选单元的顶点 */
+    std::vector<double> px(S), py(S), vx, vy;
+    std::vector<uint32_t> pos(S), index(S);
+    std::vector<uint8_t> fl(S);
+
+#pragma omp for schedule(dynamic)
+    for(int64_t k0 = 0; k0 < int64_t(N); k0 += S)
+    {
+      const uint32_t k1 = std::min<int64_t>(k0+S, N);
+      for(uint32_t b = k0, e; b < k1; b = e)
+      {
+        for(e = b+1; e < k1 && block[e] == block[b]; e++);
+
+        uint32_t m = 0;
+        for(uint32_t k = b; k < e; k++)
+        {
+          uint32_t i = order[k];
+          cells[i] = nullptr;
+          if(flags)
+            flags[i] = 3;
+          px[m] = points[i].x; py[m] = points[i].y; pos[m++] = i;
+        }
+        if(block[b] == NB)
+          continue;
+
+        for(Cell * c : subcell_[block[b]])
+        {
+          Point * vertices[32];
+          int n = c->vertices(vertices);
+          vx.resize(n); vy.resize(n);
+          for(int j = 0; j < n; j++)
+          {
+            vx[j] = vertices[j]->x; vy[j] = vertices[j]->y;
+          }
+          geo.relative_position_of_points_and_polygon(vx.data(), vy.data(), n, 
+              px.data(), py.data(), m, fl.data(), index.data());
+
+          /** 找到单元的查询移出, 其余的留在前面 */
+          uint32_t r = 0;
+          for(uint32_t q = 0; q < m; q++)
+          {
+            if(fl[q] != 3)
+            {
+              cells[pos[q]] = c;
+              if(flags)
+                flags[pos[q]] = fl[q];
+              continue;
+            }
+            px[r] = px[q]; py[r] = py[q]; pos[r++] = pos[q];
+          }
+          m = r;
+          if(m == 0)
+            break;
+        }
+      }
+    }
+  }
+}
+
 } // namespace HEM
 
 
@@ -31,6 +31,62 @@ class OutParameter(ctypes.Structure):
                 ("idx1", ctypes.POINTER(ctypes.c_int)),
                 ("N", ctypes.POINTER(ctypes.c_int))]
 
+class ArrayView(ctypes.Structure):
+    _fields_ = [("data", ctypes.c_void_p),
+                ("count", ctypes.c_int64),
+                ("stride", ctypes.c_int64),
+                ("width", ctypes.c_int32),
+                ("dtype", ctypes.c_int32)]
+
+_dtypes = {0: np.double, 1: np.intc}
+
+class CutStats(ctypes.Structure):
+    """
+    切割的统计, 与 cut_trace.h 中的 CutStats 布局相同
+    time  : Partition, Parallel, Serial, FirstPoint, InnerCells, Total 的耗时 (纳秒)
+    count : Segment, SplitHalfEdge, SplitCell, VertexHit, SmallCell, Collinear, 
+            CellVisit, Intersection 的次数
+    added : 新增的顶点, 边, 单元, 半边的个数
+    """
+    _fields_ = [("time", ctypes.c_uint64*6),
+                ("count", ctypes.c_uint64*8),
+                ("added", ctypes.c_int64*4),
+                ("cuts", ctypes.c_uint64)]
+
+class CutMeshHandle():
+    """
+    C++ 端的网格导出数组, 对象被回收时释放
+    """
+    def __init__(self, lib, handle):
+        self.lib = lib
+        self.handle = handle
+
+    def size(self, k):
+        num = np.zeros(3, dtype=np.intc)
+        self.lib.cut_mesh_size(self.handle, k, num)
+        return num
+
+    def view(self, k, name):
+        """
+        不复制地把第 k 个网格中名为 name 的数组包装成 numpy 数组,
+        数组只在这个对象存活时有效
+        """
+        v = self.lib.cut_mesh_view(self.handle, k, name.encode())
+        dtype = np.dtype(_dtypes[v.dtype])
+        if v.count == 0:
+            return np.empty((0, v.width), dtype=dtype)
+        buf = (ctypes.c_char*(v.count*v.stride)).from_address(v.data)
+        return np.ndarray((v.count, v.width), dtype=dtype, buffer=buf,
+                          strides=(v.stride, dtype.itemsize))
+
+    def stats(self):
+        s = CutStats()
+        self.lib.cut_mesh_stats(self.handle, ctypes.byref(s))
+        return s
+
+    def __del__(self):
+        self.lib.cut_mesh_destroy(self.handle)
+
 
 class CutMeshAlgorithm():
     def __init__(self, box, nx, ny, N = -1):
@@ -60,6 +116,70 @@ class CutMeshAlgorithm():
                                            OutParameter]
         self.lib.get_cut_mesh2.restype = None
 
+        self.lib.cut_mesh_create.argtypes = [MeshParameter, InterfaceParameter]
+        self.lib.cut_mesh_create.restype = ctypes.c_void_p
+        self.lib.cut_mesh2_create.argtypes = [MeshParameter, InterfaceParameter, InterfaceParameter]
+        self.lib.cut_mesh2_create.restype = ctypes.c_void_p
+        self.lib.cut_mesh_size.argtypes = [ctypes.c_void_p, ctypes.c_int, 
+                                           np.ctypeslib.ndpointer(dtype=np.intc)]
+        self.lib.cut_mesh_size.restype = None
+        self.lib.cut_mesh_view.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_char_p]
+        self.lib.cut_mesh_view.restype = ArrayView
+        self.lib.cut_mesh_destroy.argtypes = [ctypes.c_void_p]
+        self.lib.cut_mesh_destroy.restype = None
+        self.lib.cut_mesh_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(CutStats)]
+        self.lib.cut_mesh_stats.restype = None
+        self.lib.get_cut_stats.argtypes = [ctypes.POINTER(CutStats)]
+        self.lib.get_cut_stats.restype = None
+        self.lib.reset_cut_stats.argtypes = []
+        self.lib.reset_cut_stats.restype = None
+
+    def cumulative_stats(self, reset=False):
+        """
+        这个进程中所有切割的累计统计
+        """
+        s = CutStats()
+        self.lib.get_cut_stats(ctypes.byref(s))
+        if reset:
+            self.lib.reset_cut_stats()
+        return s
+
+    def _interface_param(self, point, is_fixed_point, segment):
+        return InterfaceParameter(point=point.ctypes.data_as(ctypes.POINTER(ctypes.c_double)),
+                                  is_fixed_point=is_fixed_point.ctypes.data_as(ctypes.POINTER(ctypes.c_bool)),
+                                  segment=segment.ctypes.data_as(ctypes.POINTER(ctypes.c_int)),
+                                  NP=is_fixed_point.size, NS=segment.size)
+
+    def get_cut_mesh_view(self, point, is_fixed_point, segment):
+        """
+        与 get_cut_mesh 相同, 但不需要预先分配输出数组, 也不复制 C++ 端的数组
+        """
+        a, b, c, d = self.box
+        mesh_param = MeshParameter(a=a, b=c, c=b, d=d, nx=self.nx, ny=self.ny)
+        h = CutMeshHandle(self.lib, self.lib.cut_mesh_create(mesh_param, 
+            self._interface_param(point, is_fixed_point, segment)))
+        mesh = self._to_halfedge_mesh(h.view(0, "node"), h.view(0, "halfedge"))
+        mesh.cut_mesh_handle = h # 顶点坐标仍然指向 C++ 端的数组
+        return mesh
+
+    def get_cut_mesh2_view(self, point0, point1, is_fixed_point, segment):
+        """
+        与 get_cut_mesh2 相同, 但不需要预先分配输出数组, 也不复制 C++ 端的数组
+        """
+        a, b, c, d = self.box
+        mesh_param = MeshParameter(a=a, b=c, c=b, d=d, nx=self.nx, ny=self.ny)
+        h = CutMeshHandle(self.lib, self.lib.cut_mesh2_create(mesh_param, 
+            self._interface_param(point0, is_fixed_point, segment),
+            self._interface_param(point1, is_fixed_point, segment)))
+
+        mesh1 = self._to_halfedge_mesh(h.view(0, "node"), h.view(0, "halfedge"))
+        mesh2 = self._to_halfedge_mesh(h.view(1, "node"), h.view(1, "halfedge"))
+        mesh1.cut_mesh_handle = h
+        mesh2.cut_mesh_handle = h
+        idx0 = h.view(1, "idx0")[:, 0].copy()
+        idx1 = h.view(1, "idx1")[:, 0].copy()
+        return mesh1, mesh2, idx0, idx1
+
 
     def get_cut_mesh(self, point, is_fixed_point, segment):
         a, b, c, d = self.box
@@ -181,6 +301,8 @@ point1 = point0.copy()
 point1[1::2] -= 0.03
 
 mesh1, mesh2, idx0, idx1 = cutalg.get_cut_mesh2(point0, point1, is_fixed_point, segment)
+_, _, vidx0, vidx1 = cutalg.get_cut_mesh2_view(point0, point1, is_fixed_point, segment)
+assert np.all(idx0 == vidx0) and np.all(idx1 == vidx1)
 
 fig  = plt.figure()
 axes = fig.gca()
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <memory>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+#include "uniform_mesh_cut.h"
+#include "cut_mesh_algorithm0.h"
+
+using namespace HEM;
+
+using Mesh = UniformMeshCut<2>;
+using CutMeshAlg = CutMeshAlgorithm<Mesh>;
+using Interface = typename CutMeshAlg::Interface;
+using Point = typename Mesh::Point;
+
+/** 全局 operator new 和 operator new[] 的调用次数 */
+static std::atomic<size_t> number_of_allocations{0};
+
+static void * counted_malloc(size_t n)
+{
+  number_of_allocations.fetch_add(1, std::memory_order_relaxed);
+  if(void * p = std::malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void * operator new(size_t n) { return counted_malloc(n); }
+
+void * operator new[](size_t n) { return counted_malloc(n); }
+
+void operator delete(void * p) noexcept { std::free(p); }
+
+void operator delete(void * p, size_t) noexcept { std::free(p); }
+
+void operator delete[](void * p) noexcept { std::free(p); }
+
+void operator delete[](void * p, size_t) noexcept { std::free(p); }
+
+/**
+ * @brief 中心为 (x, y), 半径为 r, 有 N 个不固定点的圆形界面
+ */
+Interface circle(std::shared_ptr<Mesh> mesh, double x, double y, double r, uint32_t N)
+{
+  std::vector<Point> points;
+  std::vector<bool> is_fixed;
+  for(uint32_t i = 0; i < N; i++)
+  {
+    double t = 2*M_PI*i/N;
+    points.push_back(Point(x+r*std::cos(t), y+r*std::sin(t)));
+    is_fixed.push_back(false);
+  }
+  return Interface(points, is_fixed, mesh, true);
+}
+
+/**
+ * @brief 切割过一个界面之后, 再切割同样大小的界面时不分配内存
+ * @note 网格实体的空间不属于切割的缓冲区, 每次切割之前用 reserve 预留
+ */
+bool test_repeated_cut(uint32_t n, uint32_t N)
+{
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/n, 1.0/n, n, n);
+  CutMeshAlg alg(mesh);
+
+  bool ok = true;
+  double r = 0.1;
+  double centers[3][2] = {{0.3, 0.3}, {0.7, 0.7}, {0.3, 0.7}};
+  for(uint32_t k = 0; k < 3; k++)
+  {
+    Interface iface = circle(mesh, centers[k][0], centers[k][1], r, N);
+    mesh->reserve(mesh->get_node()->size() + 4*N, mesh->get_edge()->size() + 8*N,
+        mesh->get_cell()->size() + 4*N, mesh->get_halfedge()->size() + 16*N);
+
+    size_t a0 = number_of_allocations.load();
+    alg.cut_by_loop_interface(iface);
+    size_t a = number_of_allocations.load() - a0;
+
+    auto & inner = *mesh->get_cell_data<uint8_t>("is_in_the_interface");
+    double area = 0.0;
+    for(auto & c : *mesh->get_cell())
+      area += inner[c.index()] ? c.area() : 0.0;
+
+    std::cout << "cut " << k << " allocations : " << a << ", inner area : " << area << std::endl;
+    /** 第一次切割分配缓冲区 */
+    ok = ok && (k == 0 || a == 0) && std::abs(area - M_PI*r*r) < 1e-3;
+  }
+  return ok;
+}
+
+int main()
+{
+  bool ok = test_repeated_cut(400, 10000);
+  std::cout << "repeated cut without allocation : " << ok << std::endl;
+  return ok ? 0 : 1;
+}
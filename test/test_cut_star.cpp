@@ -0,0 +1,145 @@
+#include <iostream>
+#include <memory>
+#include <cmath>
+
+#include "uniform_mesh_cut.h"
+#include "cut_mesh_algorithm0.h"
+
+using namespace HEM;
+
+using Mesh = UniformMeshCut<2>;
+using CutMeshAlg = CutMeshAlgorithm<Mesh>;
+using Interface = typename CutMeshAlg::Interface;
+using Point = typename Mesh::Point;
+using HalfEdge = typename Mesh::HalfEdge;
+
+/**
+ * @brief 中心在 (0.5, 0.5) 的五角星的 10 个顶点, 逆时针排列
+ * @param snap : 为 true 时偶数顶点移到最近的网格顶点上, 奇数顶点移到最近的竖直网格线上
+ */
+std::vector<Point> star(double R, double r, double phase, double h, bool snap)
+{
+  std::vector<Point> points;
+  for(int i = 0; i < 10; i++)
+  {
+    double t = phase + M_PI*i/5;
+    double rr = i%2 == 0 ? R : r;
+    Point p(0.5+rr*std::cos(t), 0.5+rr*std::sin(t));
+    if(snap)
+    {
+      p.x = std::round(p.x/h)*h;
+      if(i%2 == 0)
+        p.y = std::round(p.y/h)*h;
+    }
+    points.push_back(p);
+  }
+  return points;
+}
+
+/** @brief 多边形的面积 (鞋带公式) */
+double polygon_area(const std::vector<Point> & points)
+{
+  double a = 0.0;
+  for(size_t i = 0; i < points.size(); i++)
+  {
+    const Point & p = points[i];
+    const Point & q = points[(i+1)%points.size()];
+    a += p.x*q.y - p.y*q.x;
+  }
+  return 0.5*a;
+}
+
+/** @brief 半边的连接关系正确, 每个单元的面积为正 */
+bool check_topology(Mesh & mesh)
+{
+  bool ok = true;
+  for(auto & h : *mesh.get_halfedge())
+  {
+    ok = ok && h.next()->previous() == &h && h.previous()->next() == &h;
+    ok = ok && h.opposite()->opposite() == &h && h.next()->cell() == h.cell();
+  }
+  for(auto & c : *mesh.get_cell())
+    ok = ok && c.area() > 0.0;
+  return ok;
+}
+
+/**
+ * @brief 用五角星切割 n x n 的网格, 检查网格的拓扑, 顶点和单元个数, 以及内部单元的面积
+ * @param m : 每条边上的点数, 星的顶点是固定点, 边上的其它点是不固定的共线点
+ * @note 不固定的点与网格的边的距离小于几何容差 (1e-6) 时会被移到边上,
+ *       所以 m > 1 时内部面积只在容差的量级上等于星的面积
+ */
+bool test_star(uint32_t n, double phase, bool snap, uint32_t m)
+{
+  double h = 1.0/n;
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, h, h, n, n);
+  std::vector<Point> corners = star(0.3, 0.13, phase, h, snap);
+
+  std::vector<Point> points;
+  std::vector<bool> is_fixed;
+  for(size_t i = 0; i < corners.size(); i++)
+  {
+    const Point & p = corners[i];
+    const Point & q = corners[(i+1)%corners.size()];
+    for(uint32_t k = 0; k < m; k++)
+    {
+      double s = double(k)/m;
+      points.push_back(Point(p.x+s*(q.x-p.x), p.y+s*(q.y-p.y)));
+      is_fixed.push_back(k == 0);
+    }
+  }
+
+  uint32_t NN0 = mesh->number_of_nodes();
+  uint32_t NC0 = mesh->number_of_cells();
+  Interface interface(points, is_fixed, mesh, true);
+  CutMeshAlg alg(mesh);
+  alg.cut_by_loop_interface(interface);
+
+  uint32_t NN = mesh->number_of_nodes();
+  uint32_t NE = mesh->number_of_edges();
+  uint32_t NC = mesh->number_of_cells();
+
+  /** 星的每个顶点都是网格的顶点 */
+  uint32_t found = 0;
+  for(auto & p : corners)
+  {
+    for(auto & node : *mesh->get_node())
+    {
+      if(std::abs(node.coordinate().x-p.x) < 1e-12 && std::abs(node.coordinate().y-p.y) < 1e-12)
+      {
+        found++;
+        break;
+      }
+    }
+  }
+
+  auto & inner = *mesh->get_cell_data<uint8_t>("is_in_the_interface");
+  double area = 0.0, inner_area = 0.0;
+  for(auto & c : *mesh->get_cell())
+  {
+    area += c.area();
+    inner_area += inner[c.index()] ? c.area() : 0.0;
+  }
+  double exact = polygon_area(corners);
+
+  bool ok = check_topology(*mesh);
+  ok = ok && NN + NC == NE + 1; /**< 单连通区域的 Euler 公式 */
+  ok = ok && NN > NN0 && NC > NC0 && found == corners.size();
+  ok = ok && std::abs(area-1.0) < 1e-10 && std::abs(inner_area-exact) < (m == 1 ? 1e-10 : 1e-6);
+  std::cout << "star n=" << n << " snap=" << snap << " m=" << m
+            << " : NN " << NN << " NC " << NC << ", inner area " << inner_area
+            << " (exact " << exact << ") : " << ok << std::endl;
+  return ok;
+}
+
+int main()
+{
+  bool ok = true;
+  ok = test_star(64, 0.1, false, 1) && ok;
+  ok = test_star(64, 0.1, false, 40) && ok;
+  ok = test_star(64, 0.1, true, 1) && ok;
+  ok = test_star(64, 0.1, true, 40) && ok;
+  ok = test_star(200, M_PI/2, true, 1) && ok;
+  ok = test_star(200, M_PI/2, true, 200) && ok;
+  return ok ? 0 : 1;
+}
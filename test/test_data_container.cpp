@@ -4,6 +4,7 @@
 #include "data_container.h"
 
 using namespace HEM;
+using Point = Point2d;
 
 void test_data_container_free_index()
 {
@@ -79,13 +80,209 @@ void test_data_container_delete_entity()
   std::cout << (int)(a==(uint32_t)-1) << std::endl;
 }
 
+/**
+ * @brief 删除大部分位置后, 迭代只访问没有被释放的位置, 包括第 0 个位置
+ */
+bool test_data_container_skip_deleted()
+{
+  uint32_t N = 100000;
+  DataContainer<1024> ddd(N);
+  auto p = ddd.add_data<uint32_t>("p");
+  uint32_t i = 0;
+  for(auto & pp : (*p))
+    pp = i++;
+
+  for(uint32_t j = 0; j < N; j++)
+  {
+    if(j%1000 != 999)
+      ddd.delete_index(j);
+  }
+
+  uint32_t n = 0;
+  bool ok = true;
+  for(auto & pp : (*p))
+  {
+    ok = ok && pp%1000 == 999;
+    n++;
+  }
+  std::cout << "number of live data : " << n << " " << ddd.number_of_data() << std::endl;
+  bool skipped = ok && n == N/1000;
+  std::cout << "skip deleted : " << (int)skipped << std::endl;
+
+  /** for_each 可以提前停止, 也可以通过常引用遍历 */
+  n = 0;
+  bool all = p->for_each([&n](uint32_t & pp) { n++; return pp < 50000; });
+  const auto & cp = *p;
+  uint32_t m = 0;
+  cp.for_each([&m](const uint32_t & pp) { m += pp%1000 == 999; });
+  ok = !all && n == 51 && m == N/1000;
+  std::cout << "for each : " << (int)ok << std::endl;
+  return skipped && ok;
+}
+
+/**
+ * @brief 句柄在删除其他数据和复制之后仍然有效
+ */
+bool test_data_container_handle()
+{
+  DataContainer<8> ddd(10);
+  auto a = ddd.add_handle<int>("a");
+  auto b = ddd.add_handle<Point>("b");
+  auto c = ddd.add_handle<double>("c");
+  ddd[b].get(3) = Point(1, 2);
+  ddd[c].get(3) = 3.0;
+  ddd.delete_data<int>("a");
+  auto d = ddd.add_handle<int>("d");
+
+  DataContainer<8> fff;
+  fff = ddd;
+  std::cout << "keys : " << a.key() << " " << b.key() << " " << c.key() << " " << d.key() << std::endl;
+  bool ok = fff[b][3].y == 2 && fff[c][3] == 3.0 && 
+      fff.key_of("a") == uint32_t(-1) && fff.get_handle<int>("d").key() == d.key();
+  std::cout << "handle : " << (int)ok << std::endl;
+  return ok;
+}
+
+/**
+ * @brief 增量更新的编号与全部重新编号的结果相同
+ */
+struct TestEntity
+{
+  uint32_t index_ = 0;
+  uint32_t & index() { return index_; }
+  void set_index(uint32_t i) { index_ = i; }
+};
+
+bool test_entity_data_container_update()
+{
+  EntityDataContainer<TestEntity, 8> ddd(100);
+  ddd.update();
+  ddd.delete_index(70);
+  ddd.delete_index(75);
+  ddd.add_entity();
+  for(uint32_t i = 0; i < 20; i++)
+    ddd.add_entity();
+  ddd.delete_index(110);
+  std::cout << "dirty begin : " << ddd.dirty_begin() << std::endl;
+  ddd.update();
+
+  std::vector<uint32_t> incremental;
+  for(auto idx : *ddd.get_entity_indices())
+    incremental.push_back(idx);
+
+  ddd.set_dirty();
+  ddd.update();
+  uint32_t i = 0;
+  bool ok = true;
+  for(auto idx : *ddd.get_entity_indices())
+    ok = ok && idx == incremental[i++] && idx == i-1;
+  ok = ok && i == ddd.number_of_data();
+  std::cout << "incremental update : " << (int)ok << std::endl;
+  return ok;
+}
+
+/**
+ * @brief 多个线程同时添加和删除位置, 每个位置只被分配一次
+ */
+bool test_data_container_concurrent()
+{
+  uint32_t N = 20000;
+  DataContainer<64> ddd(N);
+  auto owner = ddd.add_data<int32_t>("owner");
+  for(uint32_t i = 0; i < N; i += 2)
+    ddd.delete_index(i);
+
+  ddd.set_concurrent(true, 2*N);
+  #pragma omp parallel
+  {
+    int32_t t = thread_id();
+    std::vector<uint32_t> mine;
+    #pragma omp for
+    for(uint32_t i = 0; i < 3*N; i++)
+    {
+      uint32_t idx = ddd.add_index();
+      (*owner)[idx] = t;
+      mine.push_back(idx);
+      /** 删除一部分自己添加的位置, 它们会被本线程重新使用 */
+      if(i%3 == 0)
+      {
+        ddd.delete_index(mine.back());
+        mine.pop_back();
+      }
+    }
+    #pragma omp critical
+    for(uint32_t idx : mine)
+      (*owner)[idx] = (*owner)[idx] == t ? -1 : -2;
+  }
+  ddd.set_concurrent(false);
+
+  /** 原来的 N/2 个位置加上新增的 2N 个位置 */
+  uint32_t n = 0, m = 0;
+  bool ok = ddd.number_of_data() == N/2 + 2*N && !ddd.is_overflowed();
+  ddd.for_each_index(0, [&](uint32_t i) 
+  { 
+    n++; 
+    m += (*owner)[i] == -1; 
+  });
+  ok = ok && n == ddd.number_of_data() && m == 2*N;
+  std::cout << "concurrent : " << (int)ok << std::endl;
+  return ok;
+}
+
+/**
+ * @brief 并发模式下添加的位置超过预计的个数时只设置标记, 不抛出异常;
+ *   余量也用完时 add_index 返回 -1, 已经添加的位置不受影响
+ */
+bool test_data_container_overflow()
+{
+  DataContainer<64> ddd(0);
+  auto value = ddd.add_data<int32_t>("value");
+  ddd.set_concurrent(true, 100);
+  bool before = ddd.is_overflowed();
+  #pragma omp parallel for
+  for(uint32_t i = 0; i < 300; i++)
+    (*value)[ddd.add_index()] = i;
+  bool after = ddd.is_overflowed();
+  ddd.set_concurrent(false);
+  bool ok = !before && after && ddd.number_of_data() == 300;
+
+  ddd.set_concurrent(true, 100);
+  uint32_t added = 0, failed = 0;
+  #pragma omp parallel for reduction(+:added, failed)
+  for(uint32_t i = 0; i < 100000; i++)
+  {
+    uint32_t idx = ddd.add_index();
+    if(idx == uint32_t(-1))
+      failed++;
+    else
+    {
+      (*value)[idx] = -1;
+      added++;
+    }
+  }
+  after = ddd.is_overflowed();
+  ddd.set_concurrent(false);
+
+  uint32_t n = 0;
+  ddd.for_each_index(0, [&](uint32_t i) { n += (*value)[i] == -1; });
+  ok = ok && after && failed > 0 && added == n && ddd.number_of_data() == 300 + n;
+  ok = ok && ddd.size() == value->size() && ddd.size() < 300 + 100000;
+  std::cout << "overflow : " << (int)ok << std::endl;
+  return ok;
+}
+
 int main()
 {
   //test_data_container_free_index();
   //test_data_container_copy();
   //test_data_container_delete_data();
   test_data_container_delete_entity();
-  return 0;
+  bool ok = test_data_container_skip_deleted();
+  ok = test_data_container_handle() && ok;
+  ok = test_entity_data_container_update() && ok;
+  ok = test_data_container_concurrent() && ok;
+  ok = test_data_container_overflow() && ok;
+  return ok ? 0 : 1;
 }
 
 
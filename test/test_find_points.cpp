@@ -0,0 +1,120 @@
+#include <iostream>
+#include <memory>
+#include <cmath>
+#include <chrono>
+
+#include "uniform_mesh.h"
+#include "find_points.h"
+
+using namespace HEM;
+
+using Mesh = UniformMesh<2>;
+using Cell = Mesh::Cell;
+using HalfEdge = Mesh::HalfEdge;
+using Point = Mesh::Point;
+using QuadTree = QuadTreeFindPointAlg<Mesh>;
+using Bucket = UniformMesh2dFindPointAlg<Mesh>;
+
+/**
+ * @brief 在 q 所在的单元中加密一条边, 然后从新的顶点把单元分成两个,
+ *   同时增量更新四叉树
+ */
+void refine_at(Mesh & mesh, QuadTree & tree, const Point & q)
+{
+  Cell * c = tree.find_point(q);
+  HalfEdge * h = c->halfedge();
+  mesh.splite_halfedge(h);
+  HalfEdge * hm = h->previous();
+  HalfEdge * h1 = hm->next()->next();
+  Cell * c1 = mesh.splite_cell(c, hm, h1);
+  tree.update({c, c1});
+}
+
+/**
+ * @brief 逐个检查所有单元得到的结果
+ */
+uint32_t brute_force(Mesh & mesh, const Point & p, Cell* & out)
+{
+  auto & geo = mesh.geometry_utils();
+  for(auto & c : *mesh.get_cell())
+  {
+    std::vector<Point *> points(32, nullptr);
+    int N = c.vertices(points.data());
+    points.resize(N);
+    uint32_t index;
+    uint32_t flag = geo.relative_position_of_point_and_polygon(points, p, index);
+    if(flag != 3)
+    {
+      out = &c;
+      return flag;
+    }
+  }
+  out = nullptr;
+  return 3;
+}
+
+int main()
+{
+  int N = 32;
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  QuadTree tree(mesh);
+  uint32_t depth0 = tree.depth();
+
+  /** 在一个点附近反复加密, 这个点所在的块中有上千个细长的单元 */
+  for(int i = 0; i < 2000; i++)
+  {
+    double t = 0.37*i;
+    refine_at(*mesh, tree, Point(0.3+1e-3*std::cos(t), 0.3+1e-3*std::sin(t)));
+  }
+
+  std::vector<Point> points;
+  for(int i = 0; i < 20000; i++)
+  {
+    double x = (i*0.6180339887)-std::floor(i*0.6180339887);
+    double y = (i*0.7548776662)-std::floor(i*0.7548776662);
+    points.push_back(Point(x*0.999, y*0.999));
+    points.push_back(Point(0.29+0.02*x, 0.29+0.02*y));
+  }
+  for(auto & n : *mesh->get_node())
+  {
+    if(n.coordinate().x < 1.0 && n.coordinate().y < 1.0)
+      points.push_back(n.coordinate());
+  }
+
+  /** 
+   * 增量更新的结果与逐个检查所有单元, 以及重新建立的四叉树一致. 
+   * 细长的单元很多, 一个点可能在容差范围内同时是几个单元的顶点或边上的点, 
+   * 这时不同的查找顺序得到的单元可以不同, 所以只要求点在内部时单元相同
+   */
+  QuadTree rebuilt(mesh);
+  bool ok = true;
+  for(auto & p : points)
+  {
+    Cell * c0 = nullptr, * c1 = nullptr, * c2 = nullptr;
+    uint32_t index;
+    uint32_t f0 = brute_force(*mesh, p, c0);
+    uint32_t f1 = tree.find_point(p, c1, index);
+    uint32_t f2 = rebuilt.find_point(p, c2, index);
+    ok = ok && f0 != 3 && f1 != 3 && f2 != 3;
+    ok = ok && (f0 != 2 || f1 != 2 || c0 == c1) && (f0 != 2 || f2 != 2 || c0 == c2);
+  }
+
+  Bucket bucket(mesh);
+  auto s0 = std::chrono::high_resolution_clock::now();
+  size_t n0 = 0, n1 = 0;
+  for(auto & p : points)
+    n0 += bucket.find_point(p) != nullptr;
+  auto s1 = std::chrono::high_resolution_clock::now();
+  for(auto & p : points)
+    n1 += tree.find_point(p) != nullptr;
+  auto s2 = std::chrono::high_resolution_clock::now();
+  ok = ok && n0 == n1 && n0 == points.size();
+
+  auto ms = [](auto d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count()/1e3; };
+  std::cout << "NC : " << mesh->number_of_cells() << std::endl;
+  std::cout << "depth : " << depth0 << " -> " << tree.depth()
+            << " tree nodes : " << tree.number_of_tree_nodes() << std::endl;
+  std::cout << "time (ms) : " << ms(s1-s0) << " -> " << ms(s2-s1) << std::endl;
+  std::cout << "quadtree find point : " << ok << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,352 @@
+#include <iostream>
+#include <memory>
+#include <atomic>
+#include <numeric>
+
+#include "uniform_mesh_cut.h"
+#include "cut_mesh_algorithm0.h"
+#include "mesh_export.h"
+
+using namespace HEM;
+
+using PointerMesh = UniformMeshCut<2>;
+using IndexMesh = UniformMeshCut<2, DefaultIndexHalfEdgeMeshTraits<2>>;
+
+/**
+ * @brief 检查网格的拓扑关系是否自洽
+ */
+template<typename Mesh>
+bool check_mesh(Mesh & mesh)
+{
+  using HalfEdge = typename Mesh::HalfEdge;
+  bool ok = true;
+  for(auto & n : *mesh.get_node())
+    ok = ok && n.halfedge()->node() == &n;
+  for(auto & e : *mesh.get_edge())
+    ok = ok && e.halfedge()->edge() == &e && e.halfedge()->opposite()->edge() == &e;
+  for(auto & c : *mesh.get_cell())
+  {
+    for(HalfEdge * h = c.halfedge()->next(); h != c.halfedge(); h = h->next())
+      ok = ok && h->cell() == &c;
+  }
+  for(auto & h : *mesh.get_halfedge())
+  {
+    ok = ok && h.next()->previous() == &h && h.previous()->next() == &h;
+    ok = ok && h.opposite()->opposite() == &h;
+  }
+  return ok;
+}
+
+/**
+ * @brief 用同一个界面切割网格
+ */
+template<typename Mesh>
+void cut_mesh(std::shared_ptr<Mesh> mesh)
+{
+  using CutMeshAlg = CutMeshAlgorithm<Mesh>;
+  using Interface = typename CutMeshAlg::Interface;
+  using Point = typename Mesh::Point;
+
+  std::vector<Point> points;
+  std::vector<bool> is_fixed;
+  for(int i = 0; i < 100; i++)
+  {
+    double t = 2*M_PI*i/100;
+    points.push_back(Point(0.5+0.3*std::cos(t), 0.5+0.3*std::sin(t)));
+    is_fixed.push_back(false);
+  }
+  Interface interface(points, is_fixed, mesh, true);
+  CutMeshAlg alg(mesh);
+  alg.cut_by_loop_interface(interface);
+}
+
+/**
+ * @brief 删除一些实体留下空位后整理存储, 检查导出的网格不变
+ */
+template<typename Mesh>
+bool test_compact(Mesh & mesh)
+{
+  /** 添加后删除实体, 使得数组中间有空位 */
+  std::vector<typename Mesh::Node *> nodes;
+  for(int i = 0; i < 3000; i++)
+    nodes.push_back(&mesh.add_node());
+  for(int i = 0; i < 3000; i++)
+    if(i % 7 != 0)
+      mesh.delete_node(*nodes[i]);
+
+  MeshExport<Mesh> before(mesh);
+  bool hole = !mesh.is_compact();
+  size_t cap = mesh.get_node()->capacity();
+
+  mesh.compact();
+  MeshExport<Mesh> after(mesh);
+
+  auto same = [](ArrayView a, ArrayView b) 
+  { 
+    return a.count == b.count && std::equal((char *)a.data, (char *)a.data + a.count*a.stride, (char *)b.data); 
+  };
+  bool ok = hole && mesh.is_compact();
+  ok = ok && same(before.node(), after.node()) && same(before.halfedge(), after.halfedge());
+  ok = ok && mesh.get_node()->capacity() < cap;
+  for(auto & n : *mesh.get_node())
+    ok = ok && (*mesh.get_node_indices())[n.index()] == n.index();
+
+  /** 背景网格中子单元的指针也被重写了 */
+  for(auto & c : *mesh.get_cell())
+    ok = ok && mesh.find_point(c.barycenter()) == &c;
+  ok = ok && mesh.find_point(typename Mesh::Point(-0.5, 0.5)) == nullptr;
+
+  /** 删除孤立的顶点后再检查拓扑 */
+  for(auto & n : *mesh.get_node())
+    if(!n.halfedge())
+      mesh.delete_node(n);
+  return ok && check_mesh(mesh);
+}
+
+/**
+ * @brief 相邻单元在存储中的平均距离
+ */
+template<typename Mesh>
+double adjacent_distance(Mesh & mesh)
+{
+  double d = 0.0;
+  for(auto & h : *mesh.get_halfedge())
+    d += std::abs(double(h.cell()->index()) - double(h.opposite()->cell()->index()));
+  return d/mesh.number_of_halfedges();
+}
+
+/**
+ * @brief 按空间顺序重排, 检查拓扑、面积和点的查找不变
+ */
+template<typename Mesh>
+bool test_reorder(Mesh & mesh)
+{
+  auto area = [&mesh]() 
+  { 
+    double a = 0.0; 
+    for(auto & c : *mesh.get_cell()) 
+      a += c.area(); 
+    return a; 
+  };
+  double a0 = area();
+  double d0 = adjacent_distance(mesh);
+  uint32_t NC = mesh.number_of_cells(), NH = mesh.number_of_halfedges();
+
+  mesh.reorder();
+  std::cout << "adjacent distance : " << d0 << " -> " << adjacent_distance(mesh) << std::endl;
+
+  bool ok = check_mesh(mesh) && mesh.is_compact() && std::abs(area()-a0) < 1e-12;
+  ok = ok && NC == mesh.number_of_cells() && NH == mesh.number_of_halfedges();
+  for(auto & c : *mesh.get_cell())
+    ok = ok && mesh.find_point(c.barycenter()) == &c;
+  ok = ok && mesh.find_point(typename Mesh::Point(0.5, 1.5)) == nullptr;
+  return ok;
+}
+
+/**
+ * @brief 删除一些实体留下空位, 检查并行迭代恰好访问每个实体一次
+ */
+template<typename Mesh>
+bool test_parallel_for_each(Mesh & mesh)
+{
+  using Node = typename Mesh::Node;
+  using Cell = typename Mesh::Cell;
+  std::vector<Node *> nodes;
+  for(int i = 0; i < 5000; i++)
+    nodes.push_back(&mesh.add_node());
+  for(int i = 0; i < 5000; i++)
+    if(i % 3 != 0)
+      mesh.delete_node(*nodes[i]);
+
+  std::vector<std::atomic<int>> count(mesh.get_node()->size());
+  mesh.template parallel_for_each_entity<Node>([&count](Node & n) { count[n.index()]++; });
+  bool ok = true;
+  size_t N = 0;
+  for(auto & n : *mesh.get_node())
+  {
+    ok = ok && count[n.index()] == 1;
+    N++;
+  }
+  for(auto & c : count)
+    N -= c;
+  ok = ok && N == 0;
+
+  /** 并行计算单元面积的和 */
+  std::vector<double> area(mesh.get_cell()->size(), 0.0);
+  mesh.template parallel_for_each_entity<Cell>([&area](Cell & c) { area[c.index()] = c.area(); });
+  double a = 0.0;
+  for(auto & c : *mesh.get_cell())
+    a += c.area();
+  ok = ok && std::abs(std::accumulate(area.begin(), area.end(), 0.0) - a) < 1e-12;
+
+  for(int i = 0; i < 5000; i += 3)
+    mesh.delete_node(*nodes[i]);
+  return ok;
+}
+
+/**
+ * @brief 用切割后的网格 (单元的顶点个数不同) 的单元-顶点数组重新生成网格, 
+ *   检查单元的顶点, 对边和边界与原网格一致
+ */
+template<typename Mesh>
+bool test_reinit(Mesh & mesh)
+{
+  using Base = HalfEdgeMeshBase<typename Mesh::Traits>;
+  using HalfEdge = typename Mesh::HalfEdge;
+  mesh.update();
+  auto & nindex = *mesh.get_node_indices();
+  std::vector<double> node(2*mesh.number_of_nodes());
+  for(auto & n : *mesh.get_node())
+  {
+    node[2*nindex[n.index()]] = n.coordinate().x;
+    node[2*nindex[n.index()]+1] = n.coordinate().y;
+  }
+  std::vector<uint32_t> cell, offsets(1, 0);
+  uint32_t NB = 0;
+  for(auto & c : *mesh.get_cell())
+  {
+    HalfEdge * h = c.halfedge();
+    do
+    {
+      cell.push_back(nindex[h->node()->index()]);
+      NB += h->is_boundary();
+      h = h->next();
+    } while(h != c.halfedge());
+    offsets.push_back(cell.size());
+  }
+
+  Base base;
+  base.reinit(node.data(), cell.data(), offsets.data(), mesh.number_of_nodes(), mesh.number_of_cells());
+  bool ok = check_mesh(base);
+  ok = ok && base.number_of_edges() == mesh.number_of_edges();
+  ok = ok && base.number_of_halfedges() == mesh.number_of_halfedges();
+  auto & halfedge = *base.get_halfedge();
+  for(uint32_t h = 0; h < cell.size(); h++)
+  {
+    ok = ok && halfedge[h].node()->index() == cell[h];
+    if(halfedge[h].is_boundary())
+    {
+      ok = ok && halfedge[h].node()->halfedge()->is_boundary();
+      NB--;
+    }
+  }
+  return ok && NB == 0;
+}
+
+/**
+ * @brief 切割时增量更新的 subcell_ 与重新建立的相同
+ */
+template<typename Mesh>
+bool test_subcell(Mesh & mesh)
+{
+  using Cell = typename Mesh::Cell;
+  std::vector<Cell *> found;
+  for(auto & c : *mesh.get_cell())
+    found.push_back(mesh.find_point(c.barycenter()));
+  mesh.update_subcell();
+  bool ok = true;
+  uint32_t k = 0;
+  for(auto & c : *mesh.get_cell())
+    ok = ok && found[k++] == &c && mesh.find_point(c.barycenter()) == &c;
+  return ok;
+}
+
+/**
+ * @brief 批量查找与逐个查找的结果相同, 包括顶点, 边的中点, 单元内部和网格外面的点
+ */
+template<typename Mesh>
+bool test_locate(Mesh & mesh)
+{
+  using Cell = typename Mesh::Cell;
+  using Point = typename Mesh::Point;
+  /** find_point 不处理网格外面的点, 所以去掉右边和上边边界上的点 */
+  std::vector<Point> points;
+  auto add = [&points](const Point & p) { if(p.x < 1.0-1e-12 && p.y < 1.0-1e-12) points.push_back(p); };
+  for(auto & n : *mesh.get_node())
+    add(n.coordinate());
+  for(auto & e : *mesh.get_edge())
+    add(e.barycenter());
+  for(auto & c : *mesh.get_cell())
+    add(c.barycenter());
+  for(int i = 0; i < 20000; i++)
+    points.push_back(Point((i*0.6180339887)-std::floor(i*0.6180339887), (i*0.7548776662)-std::floor(i*0.7548776662)));
+  points.push_back(Point(-0.5, 0.5));
+  points.push_back(Point(0.5, 1.5));
+
+  uint32_t N = points.size();
+  std::vector<Cell *> cells(N);
+  std::vector<uint8_t> flags(N);
+  mesh.locate(points.data(), N, cells.data(), flags.data());
+
+  bool ok = cells[N-1] == nullptr && flags[N-1] == 3 && cells[N-2] == nullptr;
+  for(uint32_t i = 0; i+2 < N; i++)
+  {
+    Cell * c = nullptr;
+    uint32_t flag = mesh.find_point(points[i], c);
+    ok = ok && flag == flags[i] && (flag == 3 || c == cells[i]);
+  }
+
+  /** 从上一次的单元出发行走, 按顺序和乱序查询的结果都与 find_point 相同 */
+  typename Mesh::Locator loc(mesh);
+  for(uint32_t i = 0; i+2 < N; i++)
+    ok = ok && loc.find_point(points[i]) == cells[i];
+  loc.reset();
+  for(uint32_t i = 0; i+2 < N; i++)
+  {
+    uint32_t k = (i*7919u)%(N-2);
+    ok = ok && loc.find_point(points[k]) == cells[k];
+  }
+  return ok;
+}
+
+int main()
+{
+  std::cout << "sizeof(HalfEdge) : " << sizeof(PointerMesh::HalfEdge)
+            << " -> " << sizeof(IndexMesh::HalfEdge) << std::endl;
+  std::cout << "sizeof(Node) : " << sizeof(PointerMesh::Node)
+            << " -> " << sizeof(IndexMesh::Node) << std::endl;
+
+  auto pmesh = std::make_shared<PointerMesh>(0.0, 0.0, 0.05, 0.05, 20, 20);
+  auto imesh = std::make_shared<IndexMesh>(0.0, 0.0, 0.05, 0.05, 20, 20);
+  cut_mesh(pmesh);
+  cut_mesh(imesh);
+
+  bool ok = true;
+  /** 打印一项检查的结果并累计到 ok */
+  auto check = [&ok](const char * name, bool r) 
+  { 
+    std::cout << name << " : " << r << std::endl; 
+    ok = ok && r;
+  };
+
+  check("check index mesh", check_mesh(*imesh));
+  std::cout << "NC : " << pmesh->number_of_cells() << " " << imesh->number_of_cells() << std::endl;
+  std::cout << "NH : " << pmesh->number_of_halfedges() << " " << imesh->number_of_halfedges() << std::endl;
+  ok = ok && pmesh->number_of_cells() == imesh->number_of_cells();
+  ok = ok && pmesh->number_of_halfedges() == imesh->number_of_halfedges();
+
+  /** 复制网格后不需要修正连接关系 */
+  IndexMesh copy(*imesh);
+  check("check copied mesh", check_mesh(copy));
+
+  auto & h0 = (*pmesh->get_halfedge())[0];
+  auto & h1 = (*imesh->get_halfedge())[0];
+  check("same topology", h0.next()->index() == h1.next()->index() &&
+      h0.opposite()->index() == h1.opposite()->index());
+
+  check("parallel for each pointer mesh", test_parallel_for_each(*pmesh));
+  check("parallel for each index mesh", test_parallel_for_each(*imesh));
+  check("reinit from cells pointer mesh", test_reinit(*pmesh));
+  check("reinit from cells index mesh", test_reinit(*imesh));
+  check("incremental subcell pointer mesh", test_subcell(*pmesh));
+  check("incremental subcell index mesh", test_subcell(*imesh));
+  check("batch locate pointer mesh", test_locate(*pmesh));
+  check("batch locate index mesh", test_locate(*imesh));
+
+  check("reorder pointer mesh", test_reorder(*pmesh));
+  check("reorder index mesh", test_reorder(*imesh));
+
+  check("compact pointer mesh", test_compact(*pmesh));
+  check("compact index mesh", test_compact(*imesh));
+  return ok ? 0 : 1;
+}
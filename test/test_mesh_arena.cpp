@@ -0,0 +1,152 @@
+#include <iostream>
+#include <memory>
+#include <chrono>
+
+#include "uniform_mesh_cut.h"
+#include "cut_mesh_algorithm0.h"
+#include "mesh_arena.h"
+#include "huge_page_resource.h"
+
+using namespace HEM;
+
+using Mesh = UniformMeshCut<2>;
+using CutMeshAlg = CutMeshAlgorithm<Mesh>;
+using Interface = typename CutMeshAlg::Interface;
+using Point = typename Mesh::Point;
+
+/**
+ * @brief 统计分配次数的内存资源
+ */
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+  size_t count = 0;
+
+private:
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    count++;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t alignment) override
+  {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+/**
+ * @brief 在 resource 上生成并切割一个网格, 返回单元个数
+ */
+uint32_t cut_once(std::pmr::memory_resource * resource)
+{
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 0.05, 0.05, 20, 20, resource);
+  std::vector<Point> points;
+  std::vector<bool> is_fixed;
+  for(int i = 0; i < 100; i++)
+  {
+    double t = 2*M_PI*i/100;
+    points.push_back(Point(0.5+0.3*std::cos(t), 0.5+0.3*std::sin(t)));
+    is_fixed.push_back(false);
+  }
+  Interface interface(points, is_fixed, mesh, true);
+  CutMeshAlg alg(mesh);
+  alg.cut_by_loop_interface(interface);
+  return mesh->number_of_cells();
+}
+
+/**
+ * @brief 在大页上生成一个大的背景网格, 并遍历单元
+ */
+void test_huge_page(uint32_t n)
+{
+  HugePageResource huge;
+  MeshArena arena(64u << 20, &huge);
+
+  auto s0 = std::chrono::high_resolution_clock::now();
+  UniformMesh<2> mesh0(0.0, 0.0, 1.0/n, 1.0/n, n, n);
+  auto s1 = std::chrono::high_resolution_clock::now();
+  UniformMesh<2> mesh1(0.0, 0.0, 1.0/n, 1.0/n, n, n, &arena);
+  auto s2 = std::chrono::high_resolution_clock::now();
+
+  double a0 = 0.0, a1 = 0.0;
+  for(auto & c : *mesh0.get_cell())
+    a0 += c.area();
+  auto s3 = std::chrono::high_resolution_clock::now();
+  for(auto & c : *mesh1.get_cell())
+    a1 += c.area();
+  auto s4 = std::chrono::high_resolution_clock::now();
+
+  auto ms = [](auto d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count()/1e3; };
+  std::cout << "huge page mappings : " << huge.number_of_explicit_mappings() << " explicit, "
+            << huge.number_of_transparent_mappings() << " transparent" << std::endl;
+  std::cout << "build (ms) : " << ms(s1-s0) << " -> " << ms(s2-s1) << std::endl;
+  std::cout << "area (ms) : " << ms(s3-s2) << " -> " << ms(s4-s3) 
+            << " sum : " << a0 << " " << a1 << std::endl;
+}
+
+/**
+ * @brief 多个线程同时从一个资源映射大页, 映射的次数不会丢失
+ */
+bool test_concurrent_mappings()
+{
+  HugePageResource huge(HugePageResource::Policy::Transparent);
+  const int N = 64;
+  std::vector<void *> p(N);
+  #pragma omp parallel for
+  for(int i = 0; i < N; i++)
+    p[i] = huge.allocate(HugePageResource::HugePageSize, 64);
+  #pragma omp parallel for
+  for(int i = 0; i < N; i++)
+    huge.deallocate(p[i], HugePageResource::HugePageSize, 64);
+#if defined(__linux__)
+  return huge.number_of_transparent_mappings() == N;
+#else
+  return true;
+#endif
+}
+
+int main()
+{
+  const int N = 200;
+
+  CountingResource counter;
+  auto s0 = std::chrono::high_resolution_clock::now();
+  uint32_t NC0 = 0;
+  for(int i = 0; i < N; i++)
+    NC0 = cut_once(&counter);
+  auto s1 = std::chrono::high_resolution_clock::now();
+
+  CountingResource upstream;
+  MeshArena arena(64u << 10, &upstream);
+  uint32_t NC1 = 0;
+  size_t first = 0; /**< 第一个网格之后向 upstream 申请的次数, 之后初始内存足够大 */
+  for(int i = 0; i < N; i++)
+  {
+    NC1 = cut_once(&arena);
+    arena.release();
+    if(i == 0)
+      first = upstream.count;
+  }
+  auto s2 = std::chrono::high_resolution_clock::now();
+
+  auto d0 = std::chrono::duration_cast<std::chrono::microseconds>(s1-s0);
+  auto d1 = std::chrono::duration_cast<std::chrono::microseconds>(s2-s1);
+  std::cout << "NC : " << NC0 << " " << NC1 << std::endl;
+  std::cout << "allocations per mesh : " << counter.count/N << " -> "
+            << upstream.count/double(N) << std::endl;
+  std::cout << "time : " << d0.count()/1e6 << " -> " << d1.count()/1e6 << std::endl;
+
+  std::cout << "reused initial buffer : " << (upstream.count == first) << std::endl;
+
+  test_huge_page(1024);
+
+  bool concurrent = test_concurrent_mappings();
+  std::cout << "concurrent mappings : " << concurrent << std::endl;
+  return NC0 == NC1 && upstream.count == first && concurrent ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+#include <iostream>
+#include <memory>
+#include <cmath>
+#include <chrono>
+
+#include "uniform_mesh.h"
+#include "cut_mesh_algorithm.h"
+
+using namespace HEM;
+
+using Mesh = CutMesh<UniformMesh<2>>;
+using CutMeshAlg = CutMeshAlgorithm<UniformMesh<2>>;
+using Interface = typename CutMeshAlg::Interface;
+using Point = Mesh::Point;
+using HalfEdge = Mesh::HalfEdge;
+using Trace = RingBufferCutTrace<>;
+
+/**
+ * @brief n*n 个互不相交的小圆, 再加上 extra 个与它们相交的大圆
+ */
+std::vector<Interface> circles(int n, int extra)
+{
+  std::vector<Interface> interfaces;
+  auto add_circle = [&interfaces](double x, double y, double r)
+  {
+    Interface iface;
+    int NP = 40;
+    for(int i = 0; i < NP; i++)
+    {
+      double t = 2*M_PI*i/NP;
+      iface.points.push_back(Point(x+r*std::cos(t), y+r*std::sin(t)));
+      iface.is_fixed_points.push_back(false);
+      iface.segments.push_back(i);
+    }
+    iface.segments.push_back(0);
+    interfaces.push_back(iface);
+  };
+  for(int i = 0; i < n; i++)
+  {
+    for(int j = 0; j < n; j++)
+      add_circle((i+0.5)/n, (j+0.5)/n, 0.3/n);
+  }
+  for(int i = 0; i < extra; i++)
+    add_circle(1.0/n, (i+1.0)/n, 0.6/n);
+  return interfaces;
+}
+
+/**
+ * @brief 检查拓扑关系, 并返回内部单元的总面积
+ */
+double inner_area(Mesh & mesh, bool & ok)
+{
+  auto & in = mesh.is_in_the_interface();
+  double a = 0.0;
+  for(auto & c : *mesh.get_cell())
+  {
+    if(in[c.index()])
+      a += c.area();
+  }
+  for(auto & h : *mesh.get_halfedge())
+  {
+    ok = ok && h.next()->previous() == &h && h.opposite()->opposite() == &h;
+    ok = ok && h.next()->cell() == h.cell();
+  }
+  return a;
+}
+
+/**
+ * @brief 三个同心圆把网格分成四层, 每一层都是一个区域
+ */
+bool nested_regions()
+{
+  int N = 64;
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  std::vector<Interface> interfaces;
+  for(double r : {0.4, 0.25, 0.1})
+  {
+    auto c = circles(1, 0);
+    for(auto & p : c[0].points)
+      p = Point(0.5, 0.5) + (p - Point(0.5, 0.5))*(r/0.3);
+    interfaces.push_back(c[0]);
+  }
+  std::vector<uint32_t> region;
+  CutMeshAlg(mesh).cut_by_interfaces(interfaces, false, &region);
+
+  auto region_of = [&](double x, double y)
+  {
+    Point p(x, y);
+    return region[mesh->find_point(p, false)->index()];
+  };
+  uint32_t r0 = region_of(0.05, 0.05), r1 = region_of(0.5, 0.17);
+  uint32_t r2 = region_of(0.5, 0.32), r3 = region_of(0.5, 0.5);
+  bool ok = r0 != r1 && r0 != r2 && r0 != r3 && r1 != r2 && r1 != r3 && r2 != r3;
+  ok = ok && r0 == region_of(0.95, 0.95) && r3 == region_of(0.52, 0.47);
+  for(auto & c : *mesh->get_cell())
+    ok = ok && region[c.index()] < 4;
+  return ok;
+}
+
+/**
+ * @brief 追踪记录的计数与网格的变化一致: 每次分割单元增加一个单元,
+ *   每次加密半边增加一个顶点; 返回的统计与追踪记录的相同
+ */
+bool traced_cut(int n)
+{
+  int N = 20*n;
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  auto ifs = circles(n, 2);
+  uint32_t NC = mesh->number_of_cells(), NN = mesh->number_of_nodes();
+
+  Trace trace;
+  CutMeshAlgorithm<UniformMesh<2>, Trace> alg(mesh);
+  alg.set_trace(&trace);
+  CutStats stats = alg.cut_by_interfaces(ifs, true);
+
+  uint64_t count[uint32_t(CutCounter::Count)] = {};
+  uint32_t phases = 0, total = 0, warnings = 0;
+  trace.drain([&](const CutEvent & e)
+  {
+    if(e.kind == CutEvent::Counter)
+      count[e.id] += e.value;
+    phases += e.kind == CutEvent::Phase;
+    total += e.kind == CutEvent::Phase && e.id == uint8_t(CutPhase::Total);
+    warnings += e.kind == CutEvent::Warning;
+  });
+
+  bool ok = phases == 5+ifs.size() && total == 1 && warnings == 0 && trace.dropped() == 0;
+  ok = ok && count[uint32_t(CutCounter::Segment)] == ifs.size()*40;
+  ok = ok && count[uint32_t(CutCounter::SplitCell)] == mesh->number_of_cells() - NC;
+  ok = ok && count[uint32_t(CutCounter::SplitHalfEdge)] == mesh->number_of_nodes() - NN;
+  for(uint32_t c = 0; c < uint32_t(CutCounter::Count); c++)
+    ok = ok && count[c] == trace.counter(CutCounter(c)) && count[c] == stats.count[c];
+  ok = ok && stats.added[2] == mesh->number_of_cells() - NC && stats.cuts == 1;
+  ok = ok && stats[CutCounter::Intersection] >= stats[CutCounter::CellVisit];
+  ok = ok && stats.time[uint32_t(CutPhase::Total)] >= stats.time[uint32_t(CutPhase::Parallel)];
+  ok = ok && alg.cumulative_stats().cuts == 1;
+  return ok;
+}
+
+/**
+ * @brief 切割前预留的空间比用到的多, 复制网格时只复制用到的块
+ */
+bool copy_after_reserve()
+{
+  int N = 32;
+  UniformMesh<2> mesh(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  mesh.reserve(mesh.get_node()->size() + 100000, mesh.get_edge()->size() + 100000, 
+      mesh.get_cell()->size() + 100000, mesh.get_halfedge()->size() + 100000);
+  UniformMesh<2> copy(mesh);
+
+  bool ok = copy.number_of_nodes() == mesh.number_of_nodes();
+  ok = ok && copy.number_of_cells() == mesh.number_of_cells();
+  ok = ok && copy.number_of_halfedges() == mesh.number_of_halfedges();
+  for(auto & h : *copy.get_halfedge())
+    ok = ok && h.next()->previous() == &h && h.opposite()->opposite() == &h;
+  return ok;
+}
+
+/**
+ * @brief 并发模式下余量用完时加密半边返回空指针, 网格不变, 
+ *   退出之后实体个数与成功的加密次数一致
+ */
+bool overflowed_split()
+{
+  int N = 8;
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  uint32_t NN = mesh->number_of_nodes(), NH = mesh->number_of_halfedges();
+
+  mesh->set_concurrent(true);
+  HalfEdge * h = nullptr;
+  for(auto & he : *mesh->get_halfedge())
+  {
+    if(!he.is_boundary())
+      h = &he;
+  }
+  uint32_t k = 0;
+  while(k < 1000000)
+  {
+    Point p = (h->node()->coordinate() + h->previous()->node()->coordinate())*0.5;
+    HalfEdge * h0 = mesh->splite_halfedge(h, p);
+    if(!h0)
+      break;
+    h = h0;
+    k++;
+  }
+  bool overflowed = mesh->is_concurrent_overflowed();
+  mesh->set_concurrent(false);
+
+  bool ok = overflowed && k < 1000000;
+  inner_area(*mesh, ok);
+  ok = ok && mesh->number_of_nodes() == NN + k;
+  ok = ok && mesh->number_of_halfedges() == NH + 2*k;
+  return ok;
+}
+
+/**
+ * @brief 不预留空间时, 4 个线程的余量在一个很长的星形界面中间用完, 
+ *   撤销已经做的分割后串行切割, 网格与串行切割的相同
+ */
+bool rolled_back_cut()
+{
+  int N = 640, K = 16;
+  Interface star;
+  for(int i = 0; i < 2*K; i++)
+  {
+    double t = M_PI*i/K, r = i%2 ? 0.1 : 0.45;
+    star.points.push_back(Point(0.501+r*std::cos(t), 0.502+r*std::sin(t)));
+    star.is_fixed_points.push_back(false);
+    star.segments.push_back(i);
+  }
+  star.segments.push_back(0);
+
+  auto mesh0 = std::make_shared<Mesh>(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  auto mesh1 = std::make_shared<Mesh>(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  std::vector<Interface> if0{star}, if1{star};
+  CutMeshAlg(mesh0).cut_by_interfaces(if0, false);
+
+#ifdef _OPENMP
+  int nt0 = omp_get_max_threads();
+  omp_set_num_threads(4);
+#endif
+  Trace trace;
+  CutMeshAlgorithm<UniformMesh<2>, Trace> alg(mesh1);
+  alg.set_trace(&trace);
+  alg.set_reserve_ratio(0.0);
+  CutStats stats = alg.cut_by_interfaces(if1, true);
+#ifdef _OPENMP
+  omp_set_num_threads(nt0);
+#endif
+
+  uint32_t rollbacks = 0;
+  trace.drain([&](const CutEvent & e)
+  {
+    rollbacks += e.kind == CutEvent::Warning && e.id == uint8_t(CutWarning::ConcurrentRollback);
+  });
+
+  bool ok = rollbacks == 1;
+  double a0 = inner_area(*mesh0, ok);
+  double a1 = inner_area(*mesh1, ok);
+  ok = ok && std::abs(a0-a1) < 1e-12;
+  ok = ok && mesh0->number_of_nodes() == mesh1->number_of_nodes();
+  ok = ok && mesh0->number_of_edges() == mesh1->number_of_edges();
+  ok = ok && mesh0->number_of_cells() == mesh1->number_of_cells();
+  ok = ok && mesh0->number_of_halfedges() == mesh1->number_of_halfedges();
+  ok = ok && stats[CutCounter::SplitCell] == mesh1->number_of_cells() - uint32_t(N*N);
+
+  /** 撤销的单元也从子单元的索引中删除了, 索引与重新建立的相同 */
+  ok = ok && mesh1->number_of_subcells() == mesh1->number_of_cells();
+  std::vector<Mesh::Cell *> found;
+  for(auto & c : *mesh1->get_cell())
+  {
+    Point p = c.barycenter();
+    found.push_back(mesh1->find_point(p, false));
+  }
+  mesh1->update_cidx();
+  uint32_t i = 0;
+  for(auto & c : *mesh1->get_cell())
+  {
+    Point p = c.barycenter();
+    ok = ok && mesh1->find_point(p, false) == found[i++];
+  }
+  return ok;
+}
+
+/**
+ * @brief 大圆内部有几十万个单元, 多个线程逐层扩展的结果与单线程的相同,
+ *   都是重心在圆内的单元
+ */
+bool parallel_inner_cells(int N)
+{
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 1.0/N, 1.0/N, N, N);
+  double r = 0.45, h = 1.0/N;
+  Point o(0.5, 0.5);
+
+  /** 圆内侧两层单元为 1, 外侧两层单元为 2 */
+  std::vector<uint8_t> mark0(mesh->get_cell()->size(), 0);
+  std::vector<uint32_t> seeds;
+  for(auto & c : *mesh->get_cell())
+  {
+    double d = (c.barycenter() - o).length();
+    if(d >= r-2*h && d < r+2*h)
+    {
+      mark0[c.index()] = d < r ? 1 : 2;
+      seeds.push_back(c.index());
+    }
+  }
+
+  auto label = [&](int nt)
+  {
+#ifdef _OPENMP
+    int nt0 = omp_get_max_threads();
+    omp_set_num_threads(nt);
+#endif
+    std::vector<uint8_t> mark = mark0;
+    FrontierBuffer buffer;
+    label_inner_cells(*mesh, mark, seeds, buffer);
+#ifdef _OPENMP
+    omp_set_num_threads(nt0);
+#endif
+    return mark;
+  };
+  std::vector<uint8_t> serial = label(1);
+  std::vector<uint8_t> parallel = label(std::max(4, int(number_of_threads())));
+
+  bool ok = serial == parallel;
+  uint32_t NI = 0;
+  for(auto & c : *mesh->get_cell())
+  {
+    bool in = (c.barycenter() - o).length() < r;
+    ok = ok && serial[c.index()] == in;
+    NI += in;
+  }
+  std::cout << "inner cells : " << NI << std::endl;
+  return ok;
+}
+
+int main()
+{
+  int n = 16, N = 20*n;
+  double h = 1.0/N;
+
+  auto mesh0 = std::make_shared<Mesh>(0.0, 0.0, h, h, N, N);
+  auto mesh1 = std::make_shared<Mesh>(0.0, 0.0, h, h, N, N);
+  auto if0 = circles(n, 2);
+  auto if1 = circles(n, 2);
+
+  auto s0 = std::chrono::high_resolution_clock::now();
+  CutMeshAlg(mesh0).cut_by_interfaces(if0, false);
+  auto s1 = std::chrono::high_resolution_clock::now();
+  CutMeshAlg(mesh1).cut_by_interfaces(if1, true);
+  auto s2 = std::chrono::high_resolution_clock::now();
+
+  bool ok = true;
+  double a0 = inner_area(*mesh0, ok);
+  double a1 = inner_area(*mesh1, ok);
+  ok = ok && mesh0->number_of_cells() == mesh1->number_of_cells();
+  ok = ok && mesh0->number_of_halfedges() == mesh1->number_of_halfedges();
+  ok = ok && std::abs(a0-a1) < 1e-12;
+
+  /** 子单元的索引在并发切割之后仍然正确 */
+  for(auto & c : *mesh1->get_cell())
+  {
+    Point p = c.barycenter();
+    ok = ok && mesh1->find_point(p, false) == &c;
+  }
+
+  auto ms = [](auto d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count()/1e3; };
+  std::cout << "NC : " << mesh0->number_of_cells() << " " << mesh1->number_of_cells() << std::endl;
+  std::cout << "inner area : " << a0 << " " << a1 << std::endl;
+  std::cout << "time (ms) : " << ms(s1-s0) << " -> " << ms(s2-s1) << std::endl;
+  std::cout << "parallel cut : " << ok << std::endl;
+
+  bool nested = nested_regions();
+  std::cout << "nested regions : " << nested << std::endl;
+  ok = ok && nested;
+
+  bool copied = copy_after_reserve();
+  std::cout << "copy after reserve : " << copied << std::endl;
+  ok = ok && copied;
+
+  bool overflowed = overflowed_split();
+  std::cout << "overflowed split : " << overflowed << std::endl;
+  ok = ok && overflowed;
+
+  bool rolled = rolled_back_cut();
+  std::cout << "rolled back cut : " << rolled << std::endl;
+  ok = ok && rolled;
+
+  bool inner = parallel_inner_cells(1000);
+  std::cout << "parallel inner cells : " << inner << std::endl;
+  ok = ok && inner;
+
+  bool traced = traced_cut(n);
+  std::cout << "traced cut : " << traced << std::endl;
+  ok = ok && traced;
+  return ok ? 0 : 1;
+}
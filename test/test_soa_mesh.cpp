@@ -0,0 +1,67 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+#include "uniform_mesh_cut.h"
+#include "cut_mesh_algorithm0.h"
+#include "soa_mesh.h"
+
+using namespace std::chrono;
+using namespace HEM;
+
+using Mesh = UniformMeshCut<2>;
+using Point = Mesh::Point;
+using CutMeshAlg = CutMeshAlgorithm<Mesh>;
+using Interface = typename CutMeshAlg::Interface;
+
+int main()
+{
+  auto mesh = std::make_shared<Mesh>(0.0, 0.0, 0.01, 0.01, 100, 100);
+
+  /** 切割之后单元不再都是四边形 */
+  std::vector<Point> points;
+  std::vector<bool> is_fixed;
+  for(int i = 0; i < 200; i++)
+  {
+    double t = 2*M_PI*i/200;
+    points.push_back(Point(0.5+0.3*std::cos(t), 0.5+0.3*std::sin(t)));
+    is_fixed.push_back(false);
+  }
+  Interface interface(points, is_fixed, mesh, true);
+  CutMeshAlg alg(mesh);
+  alg.cut_by_loop_interface(interface);
+
+  SoAMesh<Mesh> soa(*mesh);
+  uint32_t NC = soa.number_of_cells();
+  std::vector<double> area(NC), bx(NC), by(NC);
+  std::vector<double> xmin(NC), ymin(NC), xmax(NC), ymax(NC);
+
+  auto t0 = high_resolution_clock::now();
+  soa.cell_area(area.data());
+  soa.cell_barycenter(bx.data(), by.data());
+  soa.cell_box(xmin.data(), ymin.data(), xmax.data(), ymax.data());
+  auto t1 = high_resolution_clock::now();
+  std::cout << "soa kernels : " << duration_cast<microseconds>(t1-t0).count() << " us" << std::endl;
+
+  auto & cindex = *(mesh->get_cell_indices());
+  double err = 0.0;
+  for(auto & c : *mesh->get_cell())
+  {
+    uint32_t i = cindex[c.index()];
+    Point b = c.barycenter();
+    err = std::max(err, std::abs(area[i]-c.area()));
+    err = std::max(err, std::abs(bx[i]-b.x) + std::abs(by[i]-b.y));
+    for(auto & n : c.adj_nodes())
+    {
+      const Point & p = n.coordinate();
+      if(p.x < xmin[i] || p.x > xmax[i] || p.y < ymin[i] || p.y > ymax[i])
+        err = 1.0;
+    }
+  }
+  std::cout << "number of cells : " << NC << std::endl;
+  std::cout << "max error : " << err << std::endl;
+  bool ok = err < 1e-12;
+  std::cout << "soa mesh : " << ok << std::endl;
+  return ok ? 0 : 1;
+}